@@ -31,13 +31,21 @@
 #include "ns3/ipv4-static-routing-helper.h"
 #include "ns3/packet.h"
 #include "ns3/error-model.h"
+#include "ns3/channel-list.h"
 #include <ns3/rdma.h>
 #include <ns3/rdma-client.h>
 #include <ns3/rdma-client-helper.h>
 #include <ns3/rdma-driver.h>
+#include <ns3/flow-format.h>
+#include <ns3/system-thread.h>
 #include <ns3/switch-node.h>
 #include <ns3/dci-switch-node.h>
 #include <ns3/sim-setting.h>
+#include <ns3/mpi-interface.h>
+#include <ns3/distributed-simulator-impl.h>
+#ifdef NS3_MPI
+#include <mpi.h>
+#endif
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -48,6 +56,9 @@
 #include <vector>     // 作为优先队列的底层容器
 #include <functional> // 用于 std::greater，实现最小优先队列
 #include <limits>     // 用于获取数值类型的最大值
+#include <sys/time.h> // gettimeofday，性能报告使用墙钟
+#include <unistd.h>   // sysconf，读取页大小
+#include <sys/wait.h> // waitpid，扫参模式
 
 // 函数声明：
 std::istream& SkipComments(std::istream& is); // 跳过输入流中的注释行和空行
@@ -55,6 +66,7 @@ std::string GetCurrentTime(); // 获取当前时间并格式化为hh:mm:ss
 void ConfigureFlowTracking(const std::string& trace_flows_file, const std::string& output_dir); // 配置流追踪
 bool DirectoryExists(const std::string& path);
 std::string replace_config_variables(const std::string& input);
+std::string GetCcName(uint32_t mode); // ${CC_NAME}
 void periodic_monitoring(FILE *fout_uplink);
 // void periodic_monitoring(FILE *fout_uplink, FILE *fout_conn);
 
@@ -123,6 +135,28 @@ uint32_t s_cong = 2;    // S_CONG
 uint32_t alpha_cost = 3; // ALPHA
 uint32_t beta_cost = 1;  // BETA
 uint32_t s_total = 2;    // S_TOTAL
+uint32_t cong_sample_interval = 100; // CONG_SAMPLE_INTERVAL (us)，DCI交换机拥塞采样周期
+double perf_report_interval = 0; // PERF_REPORT_INTERVAL (s, 墙钟)，仿真进度/性能报告周期，0表示关闭
+std::string perf_report_format = "csv"; // PERF_REPORT_FORMAT，csv 或 json(每行一个对象)
+uint32_t perf_report_step = 10; // PERF_REPORT_STEP (us)，报告器按仿真时间检查墙钟的步长
+std::string scheduler_type = ""; // SCHEDULER_TYPE，事件调度器，如 ns3::TwoLevelCalendarScheduler，空则使用默认(MapScheduler)
+bool dci_packet_train = false; // DCI_PACKET_TRAIN，DCI链路上在途的包由信道按序保存、每次只调度一个接收事件(QbbChannel的PacketTrain)，到达时间不变
+// [NEW] 分布式仿真(需 --enable-mpi, mpirun -np N)：每个DC(主机、交换机、DCI交换机)整体分配给一个rank，
+// DC间的DCI链路使用QbbRemoteChannel，lookahead即DCI链路时延(约10ms)
+bool mpi_partition = false; // MPI_PARTITION
+uint32_t mpi_rank = 0, mpi_size = 1;
+// [NEW] 多线程仿真(单进程，无需MPI)：DC同样整体分配给分区，每个分区一个线程(MultithreadedSimulatorImpl)
+uint32_t thread_partition = 1; // THREAD_PARTITION，线程数，大于1时开启
+bool thread_mode = false;
+uint32_t num_parts = 1; // 分区数：MPI rank数或线程数
+std::vector<uint32_t> node_rank; // 每个节点所在的分区
+// [NEW] 扫参模式：建好拓扑和路由后，为每个(ROUTING_MODE, CC_MODE, FLOW_FILE)组合fork一个子进程，
+// 子进程写时复制地共享拓扑和路由，各自写入自己的OUTPUT_DIR
+std::vector<int> sweep_routing_modes; // SWEEP_ROUTING_MODE
+std::vector<uint32_t> sweep_cc_modes; // SWEEP_CC_MODE
+std::vector<std::string> sweep_flow_files; // SWEEP_FLOW_FILE
+uint32_t sweep_jobs = 0; // SWEEP_JOBS，同时运行的子进程数，0为CPU核数除以每个子进程的线程数
+std::vector<std::pair<std::string*, std::string> > output_templates; // 输出文件的配置原文，子进程按自己的OUTPUT_DIR和CC_NAME重新展开
 
 unordered_map<uint64_t, uint32_t> rate2kmax, rate2kmin;
 unordered_map<uint64_t, double> rate2pmax;
@@ -134,12 +168,14 @@ std::string file_size = "";
  * Runtime varibles
  ***********************************************/
 std::ifstream topof, flowf, tracef;
+FlowFileReader flowb; // FLOW_FILE为二进制流文件(utils/flow-convert生成)时的只读映射
 
 NodeContainer n; // keep track of a set of node pointers
 
 uint64_t nic_rate;
 
 uint64_t maxRtt, maxBdp;
+uint32_t max_switch_hops = 0; // 主机间最短路径上交换机个数的最大值（拓扑直径），决定INT的hop容量
 
 
 // 存储网络中所有节点之间的连接关系
@@ -156,17 +192,33 @@ map<Ptr<Node>, map<Ptr<Node>, Interface> > nbr2if; // neighbor to interface 的
 // 外层 map<Ptr<Node>, ...>：key 是节点指针（源节点）。
 // 内层 map<Ptr<Node>, Interface>：key 是邻居节点指针（目标节点），value 是 Interface 结构体，记录连接这两个节点的端口编号、状态、时延、带宽等信息。
 // [存储网络拓扑信息结构，它维护了网络中所有节点之间的连接关系及其属性，为路由计算和包转发提供了必要的信息]
-// Mapping destination to next hop for each node: <node, <dest, <nexthop0, ...> > >
-map<Ptr<Node>, map<Ptr<Node>, vector<Ptr<Node> > > > nextHop; // 存储每个节点到达其他节点的下一跳路由信息
-// 第一层 map<Ptr<Node>, ...>: 表示当前节点（源节点）
-// 第二层 map<Ptr<Node>, ...>: 表示目标节点（目的地）
-// 第三层 vector<Ptr<Node>>: 表示从当前节点到目标节点的所有可能的下一跳节点列表
-
-map<Ptr<Node>, map<Ptr<Node>, uint64_t> > pairDelay; // 链路时延
-map<Ptr<Node>, map<Ptr<Node>, uint64_t> > pairTxDelay; // 发送端到链路的传输时延
-map<uint32_t, map<uint32_t, uint64_t> > pairBw; // 链路带宽
-map<Ptr<Node>, map<Ptr<Node>, uint64_t> > pairBdp; // 链路带宽时延积
-map<uint32_t, map<uint32_t, uint64_t> > pairRtt; // 链路往返时延
+
+// 路由计算使用的图：CSR邻接表，节点按id编号，每个节点的邻居按id排序(BuildRouteGraph)
+// 边指向nbr2if中的Interface，TakeDownLink修改的up状态对路由计算直接可见
+std::vector<uint32_t> adjStart; // 节点v的边为 [adjStart[v], adjStart[v+1])
+std::vector<uint32_t> adjNode; // 边的对端节点id
+std::vector<Interface*> adjIf; // 边的接口
+std::vector<uint64_t> bwLevels; // 所有链路带宽，去重升序
+std::vector<uint32_t> hosts; // 所有host的节点id
+std::vector<int32_t> hostIdx; // 节点id -> host序号，非host为-1
+
+// 以一个host为目的的路由(CalculateRoute)，按节点id索引的扁平数组
+struct HostRoute{
+	std::vector<int32_t> dis; // 到该host的跳数，不可达为-1
+	// 所有最短跳数路径中的最小时延，以及最小时延路径中带宽最大者的带宽和传输时延
+	std::vector<uint64_t> delay, txDelay, bw;
+	// 节点v去往该host的下一跳为边 nhEdge[nhStart[v], nhStart[v+1])，按BFS顺序
+	std::vector<uint32_t> nhStart, nhEdge;
+	uint32_t maxSwitchHops; // 到其他host的最大交换机跳数
+};
+std::vector<HostRoute> hostRoute; // 按host序号索引
+uint32_t route_threads = 0; // ROUTE_THREADS，并行计算路由的线程数，0为CPU核数
+
+// host对的带宽、带宽时延积与往返时延，按 host_pair(src, dst) 索引
+std::vector<uint64_t> pairBw, pairBdp, pairRtt;
+inline uint32_t host_pair(uint32_t src, uint32_t dst){
+	return hostIdx[src] * hosts.size() + hostIdx[dst];
+}
 
 std::vector<Ipv4Address> serverAddress;
 
@@ -188,13 +240,123 @@ uint32_t flow_num;
 static uint32_t scheduled_flows = 0;
 static bool all_flows_scheduled = false;
 // 移除看门狗相关
+static uint32_t local_flows = 0; // 分布式仿真：源主机在本rank的流数
+
+// 分布式仿真：节点是否由本rank模拟
+bool IsLocalNode(uint32_t id){
+	return !mpi_partition || n.Get(id)->GetSystemId() == mpi_rank;
+}
+
+// 分布式仿真：本rank的流全部完成后标记为done，但继续处理事件(为其他rank的流转发/回ACK)，
+// 所有rank都done后 Simulator::Run() 在同一轮同步中返回
+static uint32_t completed_flows = 0; // 多线程仿真时各分区并发累加(原子操作)
+void check_local_flows_done(){
+	if (!mpi_partition || !all_flows_scheduled || completed_flows != local_flows)
+		return;
+	std::cout << GetCurrentTime() << "Rank " << mpi_rank << ": all " << local_flows << " local flows completed.\n";
+	DynamicCast<DistributedSimulatorImpl>(Simulator::GetImplementation())->SetLocalDone();
+}
+
+// 分区p的输出文件：MPI为 <file>.rank<N>，多线程为 <file>.part<N>
+std::string part_file(const std::string &file, uint32_t p){
+	return file + (mpi_partition ? ".rank" : ".part") + std::to_string(p);
+}
+
+// 分布式仿真：每个rank写自己的输出文件 <file>.rank<N>，结束后由rank 0合并FCT/PFC
+std::string rank_file(const std::string &file){
+	if (!mpi_partition)
+		return file;
+	return part_file(file, mpi_rank);
+}
+
+// 多线程仿真：节点的事件由其分区的线程执行，每个分区写自己的输出文件，结束后合并；
+// 其他情况只有一个文件(rank_file)
+std::vector<FILE*> open_part_outputs(const std::string &file){
+	std::vector<FILE*> fout;
+	if (!thread_mode)
+		fout.push_back(fopen(rank_file(file).c_str(), "w"));
+	else
+		for (uint32_t p = 0; p < num_parts; p++)
+			fout.push_back(fopen(part_file(file, p).c_str(), "w"));
+	return fout;
+}
+
+// 节点id对应的输出文件
+FILE* node_output(const std::vector<FILE*> &fout, uint32_t id){
+	return fout[thread_mode ? node_rank[id] : 0];
+}
+
+void close_part_outputs(std::vector<FILE*> &fout){
+	for (FILE *f : fout)
+		fclose(f);
+	fout.clear();
+}
+
+// 扫参子进程：把父进程打开的输出文件换成自己的文件，已绑定到trace回调的FILE*不变
+bool reopen_part_outputs(std::vector<FILE*> &fout, const std::string &file){
+	for (uint32_t p = 0; p < fout.size(); p++){
+		std::string name = thread_mode ? part_file(file, p) : rank_file(file);
+		if (freopen(name.c_str(), "w", fout[p]) == NULL){
+			std::cerr << "Error: Unable to open output file " << name << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// 扫参父进程：删除自己没有写入的输出文件
+void remove_part_outputs(std::vector<FILE*> &fout, const std::string &file){
+	for (uint32_t p = 0; p < fout.size(); p++)
+		remove((thread_mode ? part_file(file, p) : rank_file(file)).c_str());
+	close_part_outputs(fout);
+}
 
 // [NEW] 记录DCI switch的uplink和downlink端口 
 std::map<uint32_t, std::vector<uint32_t>> dciId2UplinkIf;
 // std::map<uint32_t, std::vector<uint32_t>> dciId2DownlinkIf; // 没必要记录
 
+// 打开FLOW_FILE并读入流数：文本格式，或utils/flow-convert转换的二进制格式
+bool OpenFlowFile(uint32_t node_num){
+	if (IsFlowFile(flow_file.c_str())) {
+		const char *err = flowb.Open(flow_file.c_str());
+		if (err != NULL) {
+			std::cerr << "Error: Unable to read binary flow file " << flow_file << ": " << err << std::endl;
+			return false;
+		}
+		std::cout << GetCurrentTime() << "Binary flow file: " << flowb.GetN() << " flows, " << flowb.GetHeader().hostCount << " hosts" << std::endl;
+		if (flowb.GetHeader().hostCount > node_num) {
+			std::cerr << "Error: binary flow file " << flow_file << " has node ids up to " << flowb.GetHeader().hostCount - 1 << ", the topology has " << node_num << " nodes" << std::endl;
+			return false;
+		}
+		flow_num = (uint32_t)flowb.GetN(); // flow-convert限制流数不超过2^32-1
+	} else {
+		flowf.open(flow_file.c_str());
+		if (!flowf.is_open()) {
+			std::cerr << "Error: Unable to open flow file " << flow_file << std::endl;
+			return false;
+		}
+		// C++中的>>操作符在读取时会自动忽略所有"空白字符", 包括：空格、制表符、换行符、回车符等
+		SkipComments(flowf) >> flow_num;
+	}
+	return true;
+}
+
 // 读取flow文件（健壮版：跳过注释/空行并检测读取失败）
 bool ReadFlowInput(){
+	// 二进制流文件：直接读取映射中的定长记录，不做解析也不逐流打印
+	if (flowb.IsOpen()){
+		if (flow_input.idx >= flow_num)
+			return false;
+		const FlowFormat &f = flowb.Get(flow_input.idx);
+		flow_input.src = f.src;
+		flow_input.dst = f.dst;
+		flow_input.pg = f.pg;
+		flow_input.dport = f.dport;
+		flow_input.flowSize = f.size;
+		flow_input.start_time = f.startTime;
+		NS_ASSERT(n.Get(flow_input.src)->GetNodeType() == 0 && n.Get(flow_input.dst)->GetNodeType() == 0);
+		return true;
+	}
 	if (flow_input.idx < flow_num){
 		if (!(SkipComments(flowf) >> flow_input.src >> flow_input.dst >> flow_input.pg >> flow_input.dport >> flow_input.flowSize >> flow_input.start_time)){
 			std::cerr << "[ERROR] Failed to read flow line #" << flow_input.idx << ", shrink flow_num to " << flow_input.idx << std::endl;
@@ -202,7 +364,8 @@ bool ReadFlowInput(){
 			flow_num = flow_input.idx;
 			return false;
 		}
-		std::cout << "[INFO] Flow Idx: " << flow_input.idx << ". Read flow: " << flow_input.src << " -> " << flow_input.dst << ", size: " << flow_input.flowSize << ", start_time: " << flow_input.start_time << "s" << std::endl;
+		if (perf_report_interval <= 0) // 开启性能报告时不逐流打印
+			std::cout << "[INFO] Flow Idx: " << flow_input.idx << ". Read flow: " << flow_input.src << " -> " << flow_input.dst << ", size: " << flow_input.flowSize << ", start_time: " << flow_input.start_time << "s" << std::endl;
 		NS_ASSERT(n.Get(flow_input.src)->GetNodeType() == 0 && n.Get(flow_input.dst)->GetNodeType() == 0); // 断言确保流量的源节点和目标节点都是主机类型（NodeType为0），而不是交换机或其他类型的节点。这是因为只有主机才能作为流量的源和目的地。
 		// 当断言失败时，NS-3会调用内部的NS_FATAL_ERROR函数，该函数最终会调用std::terminate()或类似函数强制终止程序。
 		return true;
@@ -223,14 +386,21 @@ void ScheduleFlowInputs(){
 		uint32_t dip_u32 = serverAddress[flow_input.dst].Get();
 		uint64_t rxkey = ((uint64_t)dip_u32 << 32) | ((uint64_t)flow_input.pg << 16) | (uint64_t)flow_input.dport;
 		rxqp_refcount[rxkey]++;
-		// 创建RdmaClientHelper对象，用于创建应用程序
-		RdmaClientHelper clientHelper(
-			flow_input.pg, serverAddress[flow_input.src], serverAddress[flow_input.dst], port, flow_input.dport, flow_input.flowSize, has_win?(global_t==1?maxBdp:pairBdp[n.Get(flow_input.src)][n.Get(flow_input.dst)]):0, global_t==1?maxRtt:pairRtt[flow_input.src][flow_input.dst]
-		);
-
-		// 创建应用容器，给流量的[发送端]安装应用
-		ApplicationContainer appCon = clientHelper.Install(n.Get(flow_input.src));
-		appCon.Start(Time(0)); // 设置应用的开始时间
+		// 在[发送端]直接添加流（分布式仿真时只在源主机所在的rank添加）：不为每条流创建RdmaClient应用，
+		// 同一时刻同一主机的流由RdmaDriver的一个事件批量启动，流完成后QP即被回收
+		if (IsLocalNode(flow_input.src)){
+			RdmaDriver::Flow f;
+			f.size = flow_input.flowSize;
+			f.pg = flow_input.pg;
+			f.sip = serverAddress[flow_input.src];
+			f.dip = serverAddress[flow_input.dst];
+			f.sport = port;
+			f.dport = flow_input.dport;
+			f.win = has_win?(global_t==1?maxBdp:pairBdp[host_pair(flow_input.src, flow_input.dst)]):0;
+			f.baseRtt = global_t==1?maxRtt:pairRtt[host_pair(flow_input.src, flow_input.dst)];
+			n.Get(flow_input.src)->GetObject<RdmaDriver>()->AddFlow(f);
+			local_flows++;
+		}
 
 		// 读取下一条流
 		flow_input.idx++;
@@ -251,6 +421,8 @@ void ScheduleFlowInputs(){
 		all_flows_scheduled = true;
 		std::cout << GetCurrentTime() << "All flows scheduled: " << scheduled_flows << "/" << flow_num << std::endl;
 		flowf.close();
+		flowb.Close();
+		check_local_flows_done();
 	}
 }
 
@@ -262,12 +434,11 @@ uint32_t ip_to_node_id(Ipv4Address ip){
 	return (ip.Get() >> 8) & 0xffff;
 }
 
-// 在 qp_finish 函数中增加计数
-static uint32_t completed_flows = 0;
+// 在 qp_finish 函数中增加计数（completed_flows 定义在前面）
 
 void qp_finish(FILE* fout, Ptr<RdmaQueuePair> q){
 	uint32_t sid = ip_to_node_id(q->sip), did = ip_to_node_id(q->dip);
-	uint64_t base_rtt = pairRtt[sid][did], b = pairBw[sid][did]; // 获取路径RTT和带宽
+	uint64_t base_rtt = pairRtt[host_pair(sid, did)], b = pairBw[host_pair(sid, did)]; // 获取路径RTT和带宽
 	uint64_t total_bytes = q->m_size + ((q->m_size-1) / packet_payload_size + 1) * (CustomHeader::GetStaticWholeHeaderSize() - IntHeader::GetStaticSize()); // translate to the minimum bytes required (with header but no INT)
 
 	// printf("[TEST] total_bytes: %lu\n", total_bytes); 
@@ -279,24 +450,145 @@ void qp_finish(FILE* fout, Ptr<RdmaQueuePair> q){
 	// printf("[TEST] fout: %08x %08x %u %u %lu %lu %lu %lu\n", q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->m_size, q->startTime.GetTimeStep(), (Simulator::Now() - q->startTime).GetTimeStep(), standalone_fct); 
 	fflush(fout);
 
-	// remove rxQp from the receiver
-	Ptr<Node> dstNode = n.Get(did);
-	Ptr<RdmaDriver> rdma = dstNode->GetObject<RdmaDriver> ();
-	rdma->m_rdma->DeleteRxQp(q->sip.Get(), q->m_pg, q->sport);
+	// remove rxQp from the receiver (a receiver on another rank or another thread's partition keeps its rxQp until the end)
+	if (IsLocalNode(did) && (!thread_mode || node_rank[did] == node_rank[sid])){
+		Ptr<Node> dstNode = n.Get(did);
+		Ptr<RdmaDriver> rdma = dstNode->GetObject<RdmaDriver> ();
+		rdma->m_rdma->DeleteRxQp(q->sip.Get(), q->m_pg, q->sport);
+	}
 
-	completed_flows++;
-	std::cout << "[TEST] completed_flows: " << completed_flows << std::endl;
-    if (completed_flows == flow_num) {
+	uint32_t done = __sync_add_and_fetch(&completed_flows, 1);
+	if (perf_report_interval <= 0)
+		std::cout << "[TEST] completed_flows: " << done << std::endl;
+	if (mpi_partition) {
+		check_local_flows_done();
+	} else if (done == flow_num) {
         // 所有流都完成了,停止仿真
         std::cout << GetCurrentTime() << "All flows completed. Stopping simulation.\n";
         Simulator::Stop();
     }
 }
 
+// [NEW] 分布式仿真：合并各rank的 <file>.rank<N> 并按时间排序（FCT按完成时间 start+fct，PFC按时间戳）
+// 多线程仿真同样合并各分区的 <file>.part<N>
+void merge_rank_outputs(const std::string &file, bool isFct){
+	std::vector<std::pair<uint64_t, std::string> > lines;
+	for (uint32_t r = 0; r < num_parts; r++){
+		std::string name = part_file(file, r);
+		std::ifstream in(name.c_str());
+		std::string line;
+		while (std::getline(in, line)){
+			std::istringstream ls(line);
+			uint64_t key = 0;
+			if (isFct){
+				std::string sip, dip;
+				uint64_t sport, dport, size, start, fct;
+				ls >> sip >> dip >> sport >> dport >> size >> start >> fct;
+				key = start + fct;
+			}else{
+				ls >> key;
+			}
+			lines.push_back(std::make_pair(key, line));
+		}
+		in.close();
+		remove(name.c_str());
+	}
+	std::stable_sort(lines.begin(), lines.end(),
+			[](const std::pair<uint64_t, std::string> &a, const std::pair<uint64_t, std::string> &b){ return a.first < b.first; });
+	FILE *fout = fopen(file.c_str(), "w");
+	for (auto &l : lines)
+		fprintf(fout, "%s\n", l.second.c_str());
+	fclose(fout);
+	std::cout << GetCurrentTime() << "Merged " << lines.size() << " lines from " << num_parts << (mpi_partition ? " ranks" : " partitions") << " into " << file << std::endl;
+}
+
 void get_pfc(FILE* fout, Ptr<QbbNetDevice> dev, uint32_t type){
 	fprintf(fout, "%lu %u %u %u %u\n", Simulator::Now().GetTimeStep(), dev->GetNode()->GetId(), dev->GetNode()->GetNodeType(), dev->GetIfIndex(), type);
 }
 
+// [NEW] 路由追踪：所有被追踪流的逐跳记录写入同一个文件（QbbChannel的FlowPath trace source）
+std::vector<FILE*> flow_path_outputs;
+void trace_flow_path(FILE* fout, Ptr<const Packet> p, Ptr<QbbNetDevice> src, Ptr<QbbNetDevice> dst){
+	static const char *nodeTypeName[] = {"Host  ", "Switch", "DCI   "};
+	CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
+	ch.getInt = 0;
+	p->PeekHeader(ch);
+	uint32_t srcType = src->GetNode()->GetNodeType(), dstType = dst->GetNode()->GetNodeType();
+	// 包序列号：RDMA使用UDP，序号按payload大小累加
+	fprintf(fout, "%lu [Flow-%u Seq-%u] From %s-%-4u -> To %s-%-4u (Src IP:%u:%u -> Dst IP:%u:%u)\n",
+			Simulator::Now().GetTimeStep(), p->GetTraceFlowId(), ch.udp.seq,
+			srcType < 3 ? nodeTypeName[srcType] : "Unknown", src->GetNode()->GetId(),
+			dstType < 3 ? nodeTypeName[dstType] : "Unknown", dst->GetNode()->GetId(),
+			ch.sip, ch.udp.sport, ch.dip, ch.udp.dport);
+}
+
+// [NEW] 仿真性能报告：按墙钟周期输出仿真时间、已执行事件数、事件速率、待处理事件数、每主机活跃QP数和RSS
+// 报告器本身是一个按仿真时间步进(PERF_REPORT_STEP)的事件，每次只检查墙钟，到达PERF_REPORT_INTERVAL才写一行
+FILE *perf_report_output = NULL;
+double perf_start_wall = 0, perf_last_wall = 0;
+uint64_t perf_last_events = 0;
+
+double get_wall_time(){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+uint64_t get_rss_bytes(){
+	uint64_t size = 0, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+void write_perf_report(FILE* fout, double wall){
+	// 每个主机当前的活跃QP数（m_qpMap在流完成时删除QP）
+	vector<uint32_t> hostQps;
+	uint64_t activeQps = 0;
+	uint32_t busyHosts = 0, maxQps = 0;
+	for (uint32_t i = 0; i < n.GetN(); i++){
+		if (n.Get(i)->GetNodeType() != 0)
+			continue;
+		uint32_t cnt = n.Get(i)->GetObject<RdmaDriver>()->m_rdma->m_qpMap.size();
+		hostQps.push_back(cnt);
+		activeQps += cnt;
+		if (cnt > 0)
+			busyHosts++;
+		maxQps = std::max(maxQps, cnt);
+	}
+	uint64_t events = Simulator::GetEventCount();
+	double evRate = wall > perf_last_wall ? (events - perf_last_events) / (wall - perf_last_wall) : 0;
+	uint64_t rss = get_rss_bytes();
+	if (perf_report_format == "json"){
+		fprintf(fout, "{\"wall_s\":%.3f,\"sim_ns\":%lu,\"events\":%lu,\"events_per_sec\":%.0f,\"pending_events\":%lu,"
+				"\"active_qps\":%lu,\"busy_hosts\":%u,\"max_host_qps\":%u,\"completed_flows\":%u,\"rss_bytes\":%lu,\"host_qps\":[",
+				wall - perf_start_wall, Simulator::Now().GetTimeStep(), events, evRate, Simulator::GetPendingEventCount(),
+				activeQps, busyHosts, maxQps, completed_flows, rss);
+		for (uint32_t i = 0; i < hostQps.size(); i++)
+			fprintf(fout, i ? ",%u" : "%u", hostQps[i]);
+		fprintf(fout, "]}\n");
+	}else{
+		fprintf(fout, "%.3f,%lu,%lu,%.0f,%lu,%lu,%u,%u,%u,%lu\n",
+				wall - perf_start_wall, Simulator::Now().GetTimeStep(), events, evRate, Simulator::GetPendingEventCount(),
+				activeQps, busyHosts, maxQps, completed_flows, rss);
+	}
+	fflush(fout);
+	perf_last_wall = wall;
+	perf_last_events = events;
+}
+
+void perf_report(FILE* fout){
+	double wall = get_wall_time();
+	if (wall - perf_last_wall >= perf_report_interval)
+		write_perf_report(fout, wall);
+	if (!Simulator::IsFinished())
+		Simulator::Schedule(MicroSeconds(perf_report_step), &perf_report, fout);
+}
+
 struct QlenDistribution{
 	vector<uint32_t> cnt; // cnt[i] is the number of times that the queue len is i KB
 
@@ -313,6 +605,8 @@ map<uint32_t, map<uint32_t, QlenDistribution> > queue_result;
 
 void monitor_buffer(FILE* qlen_output, NodeContainer *n){
 	for (uint32_t i = 0; i < n->GetN(); i++){
+		if (!IsLocalNode(i))
+			continue;
 		if (n->Get(i)->GetNodeType() == 1){ // is switch
 			Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n->Get(i));
 			if (queue_result.find(i) == queue_result.end())
@@ -408,103 +702,97 @@ void CalculateRoute(Ptr<Node> host){
 */
 
 // NEW 更新后的BFS,记录所有候选路径中时延最小的，带宽最大的
-void CalculateRoute(Ptr<Node> host) {
-    // 定义路径信息结构
-    struct PathInfo {
-        uint64_t delay;      // 路径总延迟
-        uint64_t txDelay;    // 路径传输延迟
-        uint64_t bw;         // 路径最小带宽
-        vector<Ptr<Node>> path;  // 路径上的节点
-    };
-    
-    // BFS所需的数据结构
-    vector<Ptr<Node>> q;  // BFS队列
-    map<Ptr<Node>, int> dis;  // 到每个节点的最小跳数
-    map<Ptr<Node>, vector<PathInfo>> nodePaths;  // 每个节点的所有候选路径
-    
-    // 初始化
-    q.push_back(host);
-    dis[host] = 0;
-    nodePaths[host].push_back({0, 0, 0xfffffffffffffffflu, {host}});
-    
-    // BFS遍历
-    for (int i = 0; i < (int)q.size(); i++) {
-        Ptr<Node> now = q[i];
-        int d = dis[now];
-        
-        // 遍历当前节点的所有邻居
-        for (auto it = nbr2if[now].begin(); it != nbr2if[now].end(); it++) {
-            if (!it->second.up)
-                continue;
-            Ptr<Node> next = it->first;
-            
-            // 计算到达next的新路径信息
-            for (const auto& curPath : nodePaths[now]) {
-                PathInfo newPath = curPath;
-                newPath.path.push_back(next);
-                newPath.delay = curPath.delay + it->second.delay;
-                newPath.txDelay = curPath.txDelay + packet_payload_size * 1000000000lu * 8 / it->second.bw;
-                newPath.bw = std::min(curPath.bw, it->second.bw);
-                
-                // 如果是第一次访问next或者是相同跳数的其他路径
-                if (dis.find(next) == dis.end()) {
-                    dis[next] = d + 1;
-                    nodePaths[next].push_back(newPath);
-                    // 只将交换机加入队列继续扩展
-                    if (next->GetNodeType() == 1 || next->GetNodeType() == 2)
-                        q.push_back(next);
-
-					// 添加nextHop (仅在第一次访问时添加)
-                    nextHop[next][host].push_back(now);
-                } else if (d + 1 == dis[next]) {
-                    nodePaths[next].push_back(newPath);
-
-					// 检查是否已经添加过这个nextHop
-                    bool already_added = false;
-                    for (const auto& nh : nextHop[next][host]) {
-                        if (nh == now) {
-                            already_added = true;
-                            break;
-                        }
-                    }
-                    if (!already_added) {
-                        nextHop[next][host].push_back(now);
-                    }
-                }
-                
-            }
-        }
-    }
-    
-    // 对每个可达节点，选择最优路径
-    for (const auto& it : nodePaths) {
-        Ptr<Node> node = it.first;
-        const vector<PathInfo>& paths = it.second;
-        
-        if (paths.empty())
-            continue;
-            
-        // 1. 找出最小delay
-        uint64_t minDelay = UINT64_MAX;
-        for (const auto& p : paths) {
-            minDelay = std::min(minDelay, p.delay);
-        }
-        
-        // 2. 在最小delay的路径中找出最大带宽
-        uint64_t maxBw = 0;
-        uint64_t bestTxDelay = 0;
-        for (const auto& p : paths) {
-            if (p.delay == minDelay && p.bw > maxBw) {
-                maxBw = p.bw;
-                bestTxDelay = p.txDelay;
-            }
-        }
-        
-        // 3. 记录最优路径的信息
-        pairDelay[node][host] = minDelay;
-        pairTxDelay[node][host] = bestTxDelay;
-        pairBw[node->GetId()][host->GetId()] = maxBw;
-    }
+// 结果与逐条枚举最短跳数路径相同：
+// 1. 最小时延路径的前缀也是最小时延路径，所以delay按BFS层逐跳取最小值
+// 2. 带宽取最小时延路径中的最大值；带宽相同时取枚举顺序(前驱的BFS顺序)中的第一条路径的传输时延。
+//    first[v*K+k]记录到v的第一条带宽>=bwLevels[k]的最小时延路径的传输时延，K为带宽种类数
+// 结果写入hostRoute[h]，各host之间互不影响，可并行计算
+void CalculateRoute(uint32_t h, std::vector<uint64_t> &first){
+	const uint64_t NONE = UINT64_MAX;
+	uint32_t N = adjStart.size() - 1, K = bwLevels.size(), host = hosts[h];
+	HostRoute &r = hostRoute[h];
+	r.dis.assign(N, -1);
+	r.delay.assign(N, 0);
+	r.txDelay.assign(N, 0);
+	r.bw.assign(N, 0);
+	r.nhStart.assign(N + 1, 0);
+	r.maxSwitchHops = 0;
+	first.assign((size_t)N * K, NONE);
+
+	// BFS: 只经过交换机转发，不允许通过主机中转
+	std::vector<uint32_t> q;
+	q.push_back(host);
+	r.dis[host] = 0;
+	for (uint32_t k = 0; k < K; k++)
+		first[(size_t)host * K + k] = 0;
+	for (uint32_t i = 0; i < q.size(); i++){
+		uint32_t now = q[i];
+		int32_t d = r.dis[now];
+		for (uint32_t e = adjStart[now]; e < adjStart[now + 1]; e++){
+			const Interface &intf = *adjIf[e];
+			if (!intf.up)
+				continue;
+			uint32_t next = adjNode[e];
+			if (r.dis[next] < 0){
+				r.dis[next] = d + 1;
+				r.delay[next] = NONE;
+				if (hostIdx[next] < 0) // 不是主机 (工作线程不能使用Ptr<Node>：引用计数不是线程安全的)
+					q.push_back(next);
+			}
+			if (r.dis[next] != d + 1)
+				continue;
+			r.nhStart[next + 1]++; // now是next去往host的下一跳
+			uint64_t delay = r.delay[now] + intf.delay;
+			if (delay > r.delay[next])
+				continue;
+			uint64_t *f = &first[(size_t)next * K];
+			if (delay < r.delay[next]){
+				r.delay[next] = delay;
+				std::fill(f, f + K, NONE);
+			}
+			uint64_t tx = packet_payload_size * 1000000000lu * 8 / intf.bw;
+			const uint64_t *g = &first[(size_t)now * K];
+			for (uint32_t k = 0; k < K && bwLevels[k] <= intf.bw; k++)
+				if (f[k] == NONE && g[k] != NONE)
+					f[k] = g[k] + tx;
+		}
+	}
+
+	// 下一跳：按BFS顺序记录，与原先逐路径追加(去重)的顺序相同
+	for (uint32_t v = 0; v < N; v++)
+		r.nhStart[v + 1] += r.nhStart[v];
+	r.nhEdge.resize(r.nhStart[N]);
+	std::vector<uint32_t> fill(r.nhStart.begin(), r.nhStart.end() - 1);
+	for (uint32_t i = 0; i < q.size(); i++){
+		uint32_t now = q[i];
+		for (uint32_t e = adjStart[now]; e < adjStart[now + 1]; e++){
+			uint32_t next = adjNode[e];
+			if (adjIf[e]->up && r.dis[next] == r.dis[now] + 1){
+				// 记录next上指向now的边(邻居按id排序)
+				uint32_t back = std::lower_bound(adjNode.begin() + adjStart[next], adjNode.begin() + adjStart[next + 1], now) - adjNode.begin();
+				r.nhEdge[fill[next]++] = back;
+			}
+		}
+	}
+
+	// 最优路径的带宽和传输时延；记录到其他主机的最大交换机跳数
+	for (uint32_t v = 0; v < N; v++){
+		if (r.dis[v] < 0)
+			continue;
+		if (v == host){
+			r.bw[v] = 0xfffffffffffffffflu;
+			continue;
+		}
+		const uint64_t *f = &first[(size_t)v * K];
+		for (uint32_t k = K; k-- > 0; )
+			if (f[k] != NONE){
+				r.bw[v] = bwLevels[k];
+				r.txDelay[v] = f[k];
+				break;
+			}
+		if (hostIdx[v] >= 0 && r.dis[v] > 1 && (uint32_t)r.dis[v] - 1 > r.maxSwitchHops)
+			r.maxSwitchHops = r.dis[v] - 1;
+	}
 }
 
 /*
@@ -628,99 +916,375 @@ void CalculateRoute(Ptr<Node> host) {
 */
 
 
-// 计算所有host的路由
-void CalculateRoutes(NodeContainer &n){
-	for (int i = 0; i < (int)n.GetN(); i++){
-		Ptr<Node> node = n.Get(i);
-		if (node->GetNodeType() == 0)
-			CalculateRoute(node);
+// 由nbr2if建立路由计算使用的CSR邻接表和host编号，在所有链路建立之后调用一次
+void BuildRouteGraph(NodeContainer &n){
+	uint32_t N = n.GetN();
+	adjStart.assign(N + 1, 0);
+	adjNode.clear();
+	adjIf.clear();
+	bwLevels.clear();
+	hosts.clear();
+	hostIdx.assign(N, -1);
+	for (uint32_t v = 0; v < N; v++){
+		Ptr<Node> node = n.Get(v);
+		std::vector<std::pair<uint32_t, Interface*> > nbr;
+		auto it = nbr2if.find(node);
+		if (it != nbr2if.end())
+			for (auto &j : it->second){
+				nbr.push_back(std::make_pair(j.first->GetId(), &j.second));
+				bwLevels.push_back(j.second.bw);
+			}
+		std::sort(nbr.begin(), nbr.end());
+		for (auto &j : nbr){
+			adjNode.push_back(j.first);
+			adjIf.push_back(j.second);
+		}
+		adjStart[v + 1] = adjNode.size();
+		if (node->GetNodeType() == 0){
+			hostIdx[v] = hosts.size();
+			hosts.push_back(v);
+		}
 	}
+	std::sort(bwLevels.begin(), bwLevels.end());
+	bwLevels.erase(std::unique(bwLevels.begin(), bwLevels.end()), bwLevels.end());
+}
+
+// 计算一组host的路由：各host的BFS由多个线程并行计算
+static const std::vector<uint32_t> *route_todo = NULL; // 待计算的host序号
+static uint32_t route_next = 0;
+void CalculateRouteWorker(void){
+	std::vector<uint64_t> first;
+	while (true){
+		uint32_t i = __sync_fetch_and_add(&route_next, 1);
+		if (i >= route_todo->size())
+			break;
+		CalculateRoute((*route_todo)[i], first);
+	}
+}
+
+void CalculateRoutes(const std::vector<uint32_t> &todo){
+	hostRoute.resize(hosts.size());
+	route_todo = &todo;
+	route_next = 0;
+	uint32_t nthreads = route_threads > 0 ? route_threads : sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = std::max(1u, std::min<uint32_t>(nthreads, todo.size()));
+	std::vector<Ptr<SystemThread> > threads;
+	for (uint32_t i = 1; i < nthreads; i++){
+		threads.push_back(Create<SystemThread>(MakeCallback(&CalculateRouteWorker)));
+		threads.back()->Start();
+	}
+	CalculateRouteWorker();
+	for (uint32_t i = 0; i < threads.size(); i++)
+		threads[i]->Join();
+	route_todo = NULL;
+	for (uint32_t i = 0; i < todo.size(); i++)
+		max_switch_hops = std::max(max_switch_hops, hostRoute[todo[i]].maxSwitchHops);
+}
+
+void CalculateRoutes(){
+	std::vector<uint32_t> todo(hosts.size());
+	for (uint32_t h = 0; h < hosts.size(); h++)
+		todo[h] = h;
+	CalculateRoutes(todo);
+}
+
+// 节点v去往某个host的出端口，按下一跳的顺序
+void GetRouteInterfaces(const HostRoute &r, uint32_t v, std::vector<int> &intf){
+	intf.clear();
+	for (uint32_t k = r.nhStart[v]; k < r.nhStart[v + 1]; k++)
+		intf.push_back(adjIf[r.nhEdge[k]]->idx);
+}
+
+// 设置节点v去往hosts[h]的路由表项(替换原有表项，intf为空时删除)，并写入路由表CSV
+// CSV中同一(src_id,dst_id)的后一行覆盖前一行，next_hop_id为空表示已不可达
+std::ofstream route_csv;
+void SetRoutingEntry(uint32_t v, uint32_t h, const std::vector<int> &intf){
+	// 将已经构建好的路由表信息写入本地CSV文件，第一次调用时创建并写入标题行
+	if (!route_csv.is_open()) {
+		route_csv.open((output_dir + "routing_table.csv").c_str(), std::ios::out);
+		route_csv << "src_id,dst_id,next_hop_id\n";
+	}
+
+	Ptr<Node> node = n.Get(v);
+	// The IP address of the dst.
+	Ipv4Address dstAddr = serverAddress[hosts[h]];
+	// 根据节点类型，设置路由表项
+	if (node->GetNodeType() == 1) // is switch
+		DynamicCast<SwitchNode>(node)->SetTableEntry(dstAddr, intf);
+	else if (node->GetNodeType() == 2) // is DCISwitch
+		DynamicCast<DCISwitchNode>(node)->SetTableEntry(dstAddr, intf);
+	else{ // is host
+		node->GetObject<RdmaDriver>()->m_rdma->SetTableEntry(dstAddr, intf);
+	}
+	const HostRoute &r = hostRoute[h];
+	route_csv << v << "," << hosts[h] << ",";
+	for (uint32_t k = r.nhStart[v]; k < r.nhStart[v + 1]; k++)
+		route_csv << (k > r.nhStart[v] ? ";" : "") << adjNode[r.nhEdge[k]];
+	route_csv << "\n";
 }
 
 // [重要]路由表设置函数，负责为网络中的所有节点（主机、交换机、DCI交换机）配置路由表项。
-// 它使用预先计算好的下一跳信息（存储在 nextHop 数据结构中）来设置每个节点的路由表
-// 为每个主机的RdmaHw对象(调用AddTableEntry)设置路由表
+// 它使用预先计算好的下一跳信息（存储在 hostRoute 中）来设置每个节点的路由表
+// 为每个主机的RdmaHw对象设置路由表
 void SetRoutingEntries(){
-	// 将已经构建好的路由表信息写入本地CSV文件
-		std::string route_file = output_dir + "routing_table.csv";
-
+	std::vector<int> intf;
 	// For each node.
-	for (auto i = nextHop.begin(); i != nextHop.end(); i++){
-		Ptr<Node> node = i->first;
-		auto &table = i->second;
-		for (auto j = table.begin(); j != table.end(); j++){
-			// The destination node.
-			Ptr<Node> dst = j->first;
-			// The IP address of the dst.
-			Ipv4Address dstAddr = dst->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+	for (uint32_t v = 0; v < adjStart.size() - 1; v++){
+		for (uint32_t h = 0; h < hosts.size(); h++){
 			// The next hops towards the dst.
-			vector<Ptr<Node> > nexts = j->second;
-			for (int k = 0; k < (int)nexts.size(); k++){
-				Ptr<Node> next = nexts[k];
-				uint32_t interface = nbr2if[node][next].idx;
-				// 根据节点类型，添加路由表项
-				if (node->GetNodeType() == 1) // is switch
-					DynamicCast<SwitchNode>(node)->AddTableEntry(dstAddr, interface);
-				else if (node->GetNodeType() == 2) // is DCISwitch
-					DynamicCast<DCISwitchNode>(node)->AddTableEntry(dstAddr, interface);
-				else{ // is host
-					node->GetObject<RdmaDriver>()->m_rdma->AddTableEntry(dstAddr, interface);
-				}
-			}
-		}
-
-		// 将路由表信息写入CSV文件
-		static std::ofstream route_csv(route_file.c_str(), std::ios::out);
-		// 写入标题行（仅在文件为空时写入）
-		static bool header_written = false;
-		if (!header_written) {
-			route_csv << "src_id,dst_id,next_hop_id\n";
-			header_written = true;
-		}
-		for (auto j2 = table.begin(); j2 != table.end(); j2++) {
-			Ptr<Node> dst2 = j2->first;
-			route_csv << node->GetId() << "," << dst2->GetId() << ",";
-			bool first = true;
-			for (auto nh : j2->second) {
-				if (!first) route_csv << ";";
-				route_csv << nh->GetId();
-				first = false;
-			}
-			route_csv << "\n";
+			GetRouteInterfaces(hostRoute[h], v, intf);
+			if (!intf.empty())
+				SetRoutingEntry(v, h, intf);
 		}
 	}
-	std::cout << GetCurrentTime() << "Routing table set and saved to " << route_file << std::endl;
+	route_csv.flush();
+	std::cout << GetCurrentTime() << "Routing table set and saved to " << output_dir << "routing_table.csv" << std::endl;
 
 }
 
+// 节点a是否以b为去往该host的下一跳，即a-b链路在该host的最短路径DAG上
+bool RouteUsesLink(const HostRoute &r, uint32_t a, uint32_t b){
+	for (uint32_t k = r.nhStart[a]; k < r.nhStart[a + 1]; k++)
+		if (adjNode[r.nhEdge[k]] == b)
+			return true;
+	return false;
+}
+
 // 链路故障处理函数
 // take down the link between a and b, and redo the routing
+// 只有最短路径DAG经过该链路的目的host的路由会变化：只重新计算这些host，
+// 只更新下一跳变化的表项，只在路由表变化的主机上重新分配qp
 void TakeDownLink(NodeContainer n, Ptr<Node> a, Ptr<Node> b){
 	if (!nbr2if[a][b].up)
 		return;
+	uint32_t ia = a->GetId(), ib = b->GetId();
+	std::vector<uint32_t> todo;
+	for (uint32_t h = 0; h < hosts.size(); h++)
+		if (RouteUsesLink(hostRoute[h], ia, ib) || RouteUsesLink(hostRoute[h], ib, ia))
+			todo.push_back(h);
+	std::vector<HostRoute> old(todo.size());
+	for (uint32_t i = 0; i < todo.size(); i++)
+		std::swap(old[i], hostRoute[todo[i]]);
+
 	// take down link between a and b
 	nbr2if[a][b].up = nbr2if[b][a].up = false;
-	nextHop.clear();
-	CalculateRoutes(n);
-	// clear routing tables
-	for (uint32_t i = 0; i < n.GetN(); i++){
-		if (n.Get(i)->GetNodeType() == 1)
-			DynamicCast<SwitchNode>(n.Get(i))->ClearTable();
-		else if (n.Get(i)->GetNodeType() == 2) // is DCISwitch
-			DynamicCast<DCISwitchNode>(n.Get(i))->ClearTable();
-		else
-			n.Get(i)->GetObject<RdmaDriver>()->m_rdma->ClearTable();
-	}
+	CalculateRoutes(todo);
+	// INT的hop容量在建立时确定，不能再扩大：绕行路径的交换机数不能超过它，否则PushHop会回绕覆盖前面的hop
+	NS_ABORT_MSG_IF(max_switch_hops > IntHeader::maxHop, "detour after taking down link " << ia << "-" << ib << " has " << max_switch_hops << " switch hops, more than the INT hop capacity " << IntHeader::maxHop);
 	DynamicCast<QbbNetDevice>(a->GetDevice(nbr2if[a][b].idx))->TakeDown();
 	DynamicCast<QbbNetDevice>(b->GetDevice(nbr2if[b][a].idx))->TakeDown();
-	// reset routing table
-	SetRoutingEntries();
 
-	// redistribute qp on each host
-	for (uint32_t i = 0; i < n.GetN(); i++){
-		if (n.Get(i)->GetNodeType() == 0)
-			n.Get(i)->GetObject<RdmaDriver>()->m_rdma->RedistributeQp();
+	// update the changed routing entries
+	uint32_t N = adjStart.size() - 1, changed = 0;
+	std::vector<bool> redistribute(N, false);
+	std::vector<int> oldIntf, newIntf;
+	for (uint32_t i = 0; i < todo.size(); i++){
+		for (uint32_t v = 0; v < N; v++){
+			GetRouteInterfaces(old[i], v, oldIntf);
+			GetRouteInterfaces(hostRoute[todo[i]], v, newIntf);
+			if (oldIntf == newIntf)
+				continue;
+			SetRoutingEntry(v, todo[i], newIntf);
+			changed++;
+			if (n.Get(v)->GetNodeType() == 0)
+				redistribute[v] = true;
+		}
+	}
+
+	route_csv.flush();
+
+	// redistribute qp on the hosts whose routing table changed
+	for (uint32_t v = 0; v < N; v++){
+		if (redistribute[v])
+			n.Get(v)->GetObject<RdmaDriver>()->m_rdma->RedistributeQp();
+	}
+	std::cout << GetCurrentTime() << "Link " << ia << "-" << ib << " down: " << todo.size() << " of " << hosts.size()
+		<< " destinations rerouted, " << changed << " routing entries changed" << std::endl;
+}
+
+// IntHeader::mode和PINT由CC_MODE决定
+void SetIntHeaderMode(){
+	// IntHeader::mode
+	if (cc_mode == 7) // timely, use ts
+		IntHeader::mode = IntHeader::TS;
+	else if (cc_mode == 3) // hpcc, use int
+		IntHeader::mode = IntHeader::NORMAL;
+	else if (cc_mode == 10) // hpcc-pint
+		IntHeader::mode = IntHeader::PINT;
+	else // others, no extra header
+		IntHeader::mode = IntHeader::NONE;
+
+	// Set Pint
+	if (cc_mode == 10){
+		Pint::set_log_base(pint_log_base);
+		IntHeader::pint_bytes = Pint::get_n_bytes();
+		printf("PINT bits: %d bytes: %d\n", Pint::get_n_bits(), Pint::get_n_bytes());
+	}
+}
+
+// 扫参 ----------------------------------------------------------
+// 一次扫参运行的参数，未扫的参数取配置文件中的值
+struct SweepVariant{
+	int routingMode;
+	uint32_t ccMode;
+	std::string flowFile;
+	std::string outputDir; // OUTPUT_DIR下按扫描的参数建子目录：<流文件名>/<ECMP|UCMP|Ours>/<CC名>/
+};
+
+std::string GetRoutingName(int mode){
+	if (mode == 0)
+		return "ECMP";
+	else if (mode == 1)
+		return "UCMP";
+	else if (mode == 2)
+		return "Ours";
+	return std::to_string(mode);
+}
+
+// 去掉目录和扩展名的文件名
+std::string GetFileStem(const std::string &file){
+	std::string name = file.substr(file.find_last_of('/') + 1);
+	size_t dot = name.find_last_of('.');
+	return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+std::vector<SweepVariant> GetSweepVariants(){
+	std::vector<int> rms = sweep_routing_modes.empty() ? std::vector<int>(1, routing_mode) : sweep_routing_modes;
+	std::vector<uint32_t> ccs = sweep_cc_modes.empty() ? std::vector<uint32_t>(1, cc_mode) : sweep_cc_modes;
+	std::vector<std::string> ffs = sweep_flow_files.empty() ? std::vector<std::string>(1, flow_file) : sweep_flow_files;
+	std::vector<SweepVariant> variants;
+	for (int rm : rms){
+		for (const std::string &ff : ffs){
+			for (uint32_t cc : ccs){
+				SweepVariant v;
+				v.routingMode = rm;
+				v.ccMode = cc;
+				v.flowFile = ff;
+				v.outputDir = output_dir;
+				if (!sweep_flow_files.empty())
+					v.outputDir += GetFileStem(ff) + "/";
+				if (!sweep_routing_modes.empty())
+					v.outputDir += GetRoutingName(rm) + "/";
+				if (!sweep_cc_modes.empty())
+					v.outputDir += GetCcName(cc) + "/";
+				variants.push_back(v);
+			}
+		}
+	}
+	return variants;
+}
+
+// 各次运行的输出文件必须在自己的OUTPUT_DIR下，否则会互相覆盖
+bool CheckSweepOutputs(){
+	std::vector<std::pair<std::string*, std::string> > used;
+	used.push_back(std::make_pair(&fct_output_file, "FCT_OUTPUT_FILE"));
+	used.push_back(std::make_pair(&pfc_output_file, "PFC_OUTPUT_FILE"));
+	used.push_back(std::make_pair(&qlen_mon_file, "QLEN_MON_FILE"));
+	if (enable_trace)
+		used.push_back(std::make_pair(&trace_output_file, "TRACE_OUTPUT_FILE"));
+	if (enable_link_util_record)
+		used.push_back(std::make_pair(&link_util_output_file, "LINK_UTIL_OUTPUT_FILE"));
+	for (auto &u : used){
+		bool found = false;
+		for (auto &t : output_templates)
+			if (t.first == u.first && t.second.find("${OUTPUT_DIR}") != std::string::npos)
+				found = true;
+		if (!found){
+			std::cerr << "Error: sweep runs need " << u.second << " under ${OUTPUT_DIR}" << std::endl;
+			return false;
+		}
 	}
+	return true;
+}
+
+// 扫参：拓扑和路由建好后为每个组合fork一个子进程，同时运行的子进程不超过SWEEP_JOBS。
+// 子进程返回true并得到自己的组合，继续运行仿真；
+// 父进程等待所有子进程结束后返回false，exitCode在有子进程失败时为1
+bool ForkSweep(SweepVariant &variant, int &exitCode){
+	std::vector<SweepVariant> variants = GetSweepVariants();
+	uint32_t jobs = sweep_jobs;
+	if (jobs == 0)
+		jobs = std::max<uint32_t>(1, sysconf(_SC_NPROCESSORS_ONLN) / (thread_mode ? num_parts : 1));
+	std::cout << GetCurrentTime() << "Sweep: " << variants.size() << " runs, " << jobs << " at a time, logs in <run dir>/log.txt" << std::endl;
+
+	double start = get_wall_time();
+	std::map<pid_t, uint32_t> running;
+	uint32_t next = 0, failed = 0;
+	while (next < variants.size() || !running.empty()){
+		if (next < variants.size() && running.size() < jobs){
+			// 缓冲区中的输出不能被子进程再写一遍
+			std::cout.flush();
+			fflush(NULL);
+			pid_t pid = fork();
+			if (pid == 0){
+				variant = variants[next];
+				return true;
+			}
+			if (pid < 0){
+				std::cerr << GetCurrentTime() << "Sweep: fork failed for " << variants[next].outputDir << std::endl;
+				failed++;
+			}else{
+				running[pid] = next;
+				std::cout << GetCurrentTime() << "Sweep: started " << variants[next].outputDir << std::endl;
+			}
+			next++;
+			continue;
+		}
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+			break;
+		auto it = running.find(pid);
+		if (it == running.end())
+			continue;
+		bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		if (!ok)
+			failed++;
+		std::cout << GetCurrentTime() << "Sweep: " << (ok ? "finished " : "FAILED ") << variants[it->second].outputDir
+			<< " after " << get_wall_time() - start << "s" << std::endl;
+		running.erase(it);
+	}
+	std::cout << GetCurrentTime() << "Sweep: " << variants.size() - failed << "/" << variants.size() << " runs succeeded in "
+		<< get_wall_time() - start << "s" << std::endl;
+	exitCode = failed > 0 ? 1 : 0;
+	return false;
+}
+
+// 扫参子进程：换成自己的参数和OUTPUT_DIR，标准输出/错误写入OUTPUT_DIR/log.txt
+bool SetupSweepChild(const SweepVariant &v, std::vector<FILE*> &fct_outputs, std::vector<FILE*> &pfc_files){
+	std::string parent_route_file = output_dir + "routing_table.csv";
+	routing_mode = v.routingMode;
+	cc_mode = v.ccMode;
+	flow_file = v.flowFile;
+	output_dir = v.outputDir;
+	if (system(("mkdir -p " + output_dir).c_str()) != 0 || freopen((output_dir + "log.txt").c_str(), "w", stdout) == NULL)
+		return false;
+	dup2(fileno(stdout), fileno(stderr));
+	std::cout << std::left << setw(27) << "ROUTING_MODE" << GetRoutingName(routing_mode) << '\n';
+	std::cout << std::left << setw(27) << "CC_MODE" << GetCcName(cc_mode) << '\n';
+	std::cout << std::left << setw(27) << "FLOW_FILE" << flow_file << '\n';
+	std::cout << std::left << setw(27) << "OUTPUT_DIR" << output_dir << '\n';
+
+	// 输出文件按自己的OUTPUT_DIR和CC_NAME重新展开；父进程已打开并绑定到trace的文件换成自己的
+	for (auto &t : output_templates)
+		*t.first = replace_config_variables(t.second);
+	if (!reopen_part_outputs(fct_outputs, fct_output_file) || !reopen_part_outputs(pfc_files, pfc_output_file))
+		return false;
+	// 路由表：复制父进程写好的routing_table.csv，链路故障时的变化追加到自己的副本
+	route_csv.close();
+	{
+		std::ifstream src(parent_route_file.c_str(), std::ios::binary);
+		std::ofstream dst((output_dir + "routing_table.csv").c_str(), std::ios::binary);
+		dst << src.rdbuf();
+	}
+	route_csv.open((output_dir + "routing_table.csv").c_str(), std::ios::app);
+
+	SetIntHeaderMode();
+	for (uint32_t i = 0; i < n.GetN(); i++)
+		if (n.Get(i)->GetNodeType() == 0)
+			n.Get(i)->GetObject<RdmaDriver>()->m_rdma->SetAttribute("CcMode", UintegerValue(cc_mode));
+	// 交换机的CcMode和RoutingMode在Step 7设置
+	return OpenFlowFile(n.GetN());
 }
 
 // 路由相关 ----------------------------------------------------------
@@ -885,7 +1449,9 @@ int main(int argc, char *argv[])
 				if (argc > 2)
 				{
 					trace_output_file = trace_output_file + std::string(argv[2]);
+					temp += std::string(argv[2]);
 				}
+				output_templates.push_back(std::make_pair(&trace_output_file, temp));
 				std::cout << std::left << setw(27) << "TRACE_OUTPUT_FILE" << trace_output_file << "\n";
 			}
 			else if (key.compare("SIMULATOR_STOP_TIME") == 0)
@@ -968,6 +1534,7 @@ int main(int argc, char *argv[])
 				std::string temp;
 				conf >> temp;
 				fct_output_file = replace_config_variables(temp);
+				output_templates.push_back(std::make_pair(&fct_output_file, temp));
 				std::cout << std::left << setw(27) << "FCT_OUTPUT_FILE" << fct_output_file << '\n';
 			}else if (key.compare("HAS_WIN") == 0){
 				conf >> has_win;
@@ -1009,6 +1576,7 @@ int main(int argc, char *argv[])
 				std::string temp;
 				conf >> temp;
 				pfc_output_file = replace_config_variables(temp);
+				output_templates.push_back(std::make_pair(&pfc_output_file, temp));
 				std::cout << std::left << setw(27) << "PFC_OUTPUT_FILE" << pfc_output_file << '\n';
 			}else if (key.compare("ENABLE_LINK_UTIL_RECORD") == 0){
 				uint32_t v;
@@ -1019,6 +1587,7 @@ int main(int argc, char *argv[])
 				std::string temp;
 				conf >> temp;
 				link_util_output_file = replace_config_variables(temp);
+				output_templates.push_back(std::make_pair(&link_util_output_file, temp));
 				std::cout << std::left << setw(27) << "LINK_UTIL_OUTPUT_FILE" << link_util_output_file << '\n';
 			}else if (key.compare("LINK_DOWN") == 0){
 				conf >> link_down_time >> link_down_A >> link_down_B;
@@ -1075,6 +1644,7 @@ int main(int argc, char *argv[])
 				std::string temp;
 				conf >> temp;
 				qlen_mon_file = replace_config_variables(temp);
+				output_templates.push_back(std::make_pair(&qlen_mon_file, temp));
 				std::cout << std::left << setw(27) << "QLEN_MON_FILE" << qlen_mon_file << '\n';
 			}else if (key.compare("QLEN_MON_START") == 0){
 				conf >> qlen_mon_start;
@@ -1138,6 +1708,70 @@ int main(int argc, char *argv[])
 			}else if (key.compare("S_TOTAL") == 0) {
 				conf >> s_total;
 				std::cout << std::left << setw(27) << "S_TOTAL" << s_total << '\n';
+			}else if (key.compare("CONG_SAMPLE_INTERVAL") == 0) {
+				conf >> cong_sample_interval;
+				std::cout << std::left << setw(27) << "CONG_SAMPLE_INTERVAL (us)" << cong_sample_interval << '\n';
+			}else if (key.compare("PERF_REPORT_INTERVAL") == 0) {
+				conf >> perf_report_interval;
+				std::cout << std::left << setw(27) << "PERF_REPORT_INTERVAL (s)" << perf_report_interval << '\n';
+			}else if (key.compare("PERF_REPORT_FORMAT") == 0) {
+				conf >> perf_report_format;
+				if (perf_report_format != "json")
+					perf_report_format = "csv";
+				std::cout << std::left << setw(27) << "PERF_REPORT_FORMAT" << perf_report_format << '\n';
+			}else if (key.compare("PERF_REPORT_STEP") == 0) {
+				conf >> perf_report_step;
+				if (perf_report_step == 0)
+					perf_report_step = 1;
+				std::cout << std::left << setw(27) << "PERF_REPORT_STEP (us)" << perf_report_step << '\n';
+			}else if (key.compare("SCHEDULER_TYPE") == 0) {
+				conf >> scheduler_type;
+				std::cout << std::left << setw(27) << "SCHEDULER_TYPE" << scheduler_type << '\n';
+			}else if (key.compare("DCI_PACKET_TRAIN") == 0) {
+				uint32_t v;
+				conf >> v;
+				dci_packet_train = v;
+				std::cout << std::left << setw(27) << "DCI_PACKET_TRAIN" << (dci_packet_train ? "Yes" : "No") << '\n';
+			}else if (key.compare("MPI_PARTITION") == 0) {
+				uint32_t v;
+				conf >> v;
+				mpi_partition = v;
+				std::cout << std::left << setw(27) << "MPI_PARTITION" << (mpi_partition ? "Yes" : "No") << '\n';
+			}else if (key.compare("THREAD_PARTITION") == 0) {
+				conf >> thread_partition;
+				if (thread_partition == 0)
+					thread_partition = 1;
+				std::cout << std::left << setw(27) << "THREAD_PARTITION" << thread_partition << '\n';
+			}else if (key.compare("ROUTE_THREADS") == 0) {
+				conf >> route_threads;
+				std::cout << std::left << setw(27) << "ROUTE_THREADS" << route_threads << '\n';
+			}else if (key.compare("SWEEP_ROUTING_MODE") == 0) {
+				std::string line;
+				std::getline(conf, line);
+				std::istringstream ls(line);
+				int v;
+				while (ls >> v)
+					sweep_routing_modes.push_back(v);
+				std::cout << std::left << setw(27) << "SWEEP_ROUTING_MODE" << line << '\n';
+			}else if (key.compare("SWEEP_CC_MODE") == 0) {
+				std::string line;
+				std::getline(conf, line);
+				std::istringstream ls(line);
+				uint32_t v;
+				while (ls >> v)
+					sweep_cc_modes.push_back(v);
+				std::cout << std::left << setw(27) << "SWEEP_CC_MODE" << line << '\n';
+			}else if (key.compare("SWEEP_FLOW_FILE") == 0) {
+				std::string line, v;
+				std::getline(conf, line);
+				std::istringstream ls(line);
+				while (ls >> v){
+					sweep_flow_files.push_back(replace_config_variables(v));
+					std::cout << std::left << setw(27) << "SWEEP_FLOW_FILE" << sweep_flow_files.back() << '\n';
+				}
+			}else if (key.compare("SWEEP_JOBS") == 0) {
+				conf >> sweep_jobs;
+				std::cout << std::left << setw(27) << "SWEEP_JOBS" << sweep_jobs << '\n';
 			}
 
 			fflush(stdout);
@@ -1152,6 +1786,41 @@ int main(int argc, char *argv[])
 	}
 
 
+	// [NEW] 扫参模式：fork与MPI不能一起使用
+	bool sweeping = !sweep_routing_modes.empty() || !sweep_cc_modes.empty() || !sweep_flow_files.empty();
+	if (sweeping && (mpi_partition || !CheckSweepOutputs())){
+		if (mpi_partition)
+			std::cout << "Error: SWEEP_* keys can not be used with MPI_PARTITION\n";
+		return 1;
+	}
+
+	// [NEW] 分布式仿真：须在第一次使用Simulator之前选择DistributedSimulatorImpl并初始化MPI
+	if (mpi_partition){
+#ifdef NS3_MPI
+		GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+		MpiInterface::Enable(&argc, &argv);
+		mpi_rank = MpiInterface::GetSystemId();
+		mpi_size = MpiInterface::GetSize();
+		num_parts = mpi_size;
+		std::cout << GetCurrentTime() << "MPI rank " << mpi_rank << "/" << mpi_size << std::endl;
+#else
+		std::cout << "Error: MPI_PARTITION requires building ns-3 with --enable-mpi\n";
+		return 1;
+#endif
+	}else if (thread_partition > 1){
+		// 分区数在读入拓扑后确定(不超过DC数)
+		GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::MultithreadedSimulatorImpl"));
+		thread_mode = true;
+		num_parts = thread_partition;
+	}
+
+	// [NEW] 事件调度器：跨DC场景下 ns3::TwoLevelCalendarScheduler 比默认的 MapScheduler 快
+	if (scheduler_type != ""){
+		ObjectFactory schedFactory;
+		schedFactory.SetTypeId(scheduler_type);
+		Simulator::SetScheduler(schedFactory);
+	}
+
 	bool dynamicth = use_dynamic_pfc_threshold;
 	Config::SetDefault("ns3::QbbNetDevice::PauseTime", UintegerValue(pause_time));
 	Config::SetDefault("ns3::QbbNetDevice::QcnEnabled", BooleanValue(enable_qcn));
@@ -1159,22 +1828,7 @@ int main(int argc, char *argv[])
 
 	// set int_multi
 	IntHop::multi = int_multi;
-	// IntHeader::mode
-	if (cc_mode == 7) // timely, use ts
-		IntHeader::mode = IntHeader::TS;
-	else if (cc_mode == 3) // hpcc, use int
-		IntHeader::mode = IntHeader::NORMAL;
-	else if (cc_mode == 10) // hpcc-pint
-		IntHeader::mode = IntHeader::PINT;
-	else // others, no extra header
-		IntHeader::mode = IntHeader::NONE;
-
-	// Set Pint
-	if (cc_mode == 10){
-		Pint::set_log_base(pint_log_base);
-		IntHeader::pint_bytes = Pint::get_n_bytes();
-		printf("PINT bits: %d bytes: %d\n", Pint::get_n_bits(), Pint::get_n_bytes());
-	}
+	SetIntHeaderMode();
 
 	//SeedManager::SetSeed(time(NULL));
 
@@ -1187,20 +1841,12 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 	
-	flowf.open(flow_file.c_str());  // 读取FLOW_FILE文件，指定网络流量
-	if (!flowf.is_open()) {
-		std::cerr << "Error: Unable to open flow file " << flow_file << std::endl;
-		return 1;
-	}
-
 	tracef.open(trace_file.c_str()); // 读取TRACE_FILE文件，指定监测节点
 	if (!tracef.is_open()) {
 		std::cerr << "Error: Unable to open trace file " << trace_file << std::endl;
 		return 1;
 	}
 	uint32_t node_num, switch_num, link_num, trace_num;
-	// C++中的>>操作符在读取时会自动忽略所有"空白字符", 包括：空格、制表符、换行符、回车符等
-	SkipComments(flowf) >> flow_num;
 	SkipComments(tracef) >> trace_num;
 
 	// 读取拓扑基本信息，支持两种格式：
@@ -1226,6 +1872,10 @@ int main(int argc, char *argv[])
 		std::cout << GetCurrentTime() << "[test]Got 3 parameters, node_num: " << node_num << ", switch_num: " << switch_num << ", link_num: " << link_num << std::endl;
 	}
 
+	// 读取FLOW_FILE文件，指定网络流量；扫参时由各子进程打开自己的流文件
+	if (!sweeping && !OpenFlowFile(node_num))
+		return 1;
+
 	// 2.2 根据节点类型，创建服务器节点或交换机节点
 	// 2.2.1 初始化节点类型数组
 	std::vector<uint32_t> node_type(node_num, 0); // 初始全部为主机节点(0)
@@ -1246,17 +1896,55 @@ int main(int argc, char *argv[])
 		// std::cout << "[test]DCISwitch dci_sid: " << dci_sid << " has been created." << std::endl;
 	}
 
+	// [NEW] 分布式仿真：去掉DCI交换机之间的链路后，每个连通分量是一个DC，DC按编号轮流分配给各rank
+	node_rank.assign(node_num, 0);
+	if (mpi_partition || thread_mode){
+		std::streampos link_pos = topof.tellg();
+		std::vector<uint32_t> dc_root(node_num);
+		for (uint32_t i = 0; i < node_num; i++)
+			dc_root[i] = i;
+		auto find_root = [&dc_root](uint32_t x){
+			while (dc_root[x] != x)
+				x = dc_root[x] = dc_root[dc_root[x]];
+			return x;
+		};
+		for (uint32_t i = 0; i < link_num; i++){
+			uint32_t src, dst;
+			std::string data_rate, link_delay;
+			double error_rate;
+			SkipComments(topof) >> src >> dst >> data_rate >> link_delay >> error_rate;
+			if (node_type[src] == 2 && node_type[dst] == 2) // DCI链路
+				continue;
+			dc_root[find_root(src)] = find_root(dst);
+		}
+		topof.clear();
+		topof.seekg(link_pos); // 链路在3.1中再读一遍
+		std::map<uint32_t, uint32_t> dc_idx;
+		for (uint32_t i = 0; i < node_num; i++){
+			uint32_t root = find_root(i);
+			if (dc_idx.find(root) == dc_idx.end()){
+				uint32_t idx = dc_idx.size();
+				dc_idx[root] = idx;
+			}
+		}
+		if (thread_mode)
+			num_parts = std::min<uint32_t>(num_parts, dc_idx.size()); // 多于DC数的线程没有事件可做
+		for (uint32_t i = 0; i < node_num; i++)
+			node_rank[i] = dc_idx[find_root(i)] % num_parts;
+		std::cout << GetCurrentTime() << "Partitioned " << dc_idx.size() << " DCs over " << num_parts << (mpi_partition ? " ranks" : " threads") << std::endl;
+	}
+
 	// 2.2.2 根据节点类型，创建服务器节点或交换机节点
 	for (uint32_t i = 0; i < node_num; i++){
 		if (node_type[i] == 0) // 创建主机节点
-			n.Add(CreateObject<Node>()); 
+			n.Add(CreateObject<Node>(node_rank[i])); 
 		else if (node_type[i] == 1){ // 创建DC内交换机节点
-			Ptr<SwitchNode> sw = CreateObject<SwitchNode>(); 
+			Ptr<SwitchNode> sw = CreateObject<SwitchNode>(node_rank[i]); 
 			n.Add(sw); // 创建交换机节点
 			sw->SetAttribute("EcnEnabled", BooleanValue(enable_qcn));
 		}
 		else if (node_type[i] == 2){ // 创建DCI交换机节点
-			Ptr<DCISwitchNode> sw = CreateObject<DCISwitchNode>(); 
+			Ptr<DCISwitchNode> sw = CreateObject<DCISwitchNode>(node_rank[i]); 
 			n.Add(sw); // 创建交换机节点
 			sw->SetAttribute("EcnEnabled", BooleanValue(enable_qcn));
 			sw->SetAttribute("Mtu", UintegerValue(packet_payload_size));
@@ -1282,14 +1970,19 @@ int main(int argc, char *argv[])
 	std::cout << GetCurrentTime() << "[test]Create channels and links." << std::endl;
 
 	// Explicitly create the channels required by the topology.
-	Ptr<RateErrorModel> rem = CreateObject<RateErrorModel>();
-	Ptr<UniformRandomVariable> uv = CreateObject<UniformRandomVariable>();
-	rem->SetRandomVariable(uv);
-	uv->SetStream(50);
-	rem->SetAttribute("ErrorRate", DoubleValue(error_rate_per_link));
-	rem->SetAttribute("ErrorUnit", StringValue("ERROR_UNIT_PACKET"));
+	// ERROR_RATE_PER_LINK为0时不安装共享的ReceiveErrorModel(否则每收一个包都要抽一次随机数)；
+	// 多线程仿真时错误模型不能被各分区共享，每条链路各建一个
+	Ptr<RateErrorModel> rem = 0;
+	if (error_rate_per_link > 0 && !thread_mode){
+		rem = CreateObject<RateErrorModel>();
+		Ptr<UniformRandomVariable> uv = CreateObject<UniformRandomVariable>();
+		rem->SetRandomVariable(uv);
+		uv->SetStream(50);
+		rem->SetAttribute("ErrorRate", DoubleValue(error_rate_per_link));
+		rem->SetAttribute("ErrorUnit", StringValue("ERROR_UNIT_PACKET"));
+	}
 
-	FILE *pfc_file = fopen(pfc_output_file.c_str(), "w");
+	std::vector<FILE*> pfc_files = open_part_outputs(pfc_output_file);
 
 	QbbHelper qbb;
 	Ipv4AddressHelper ipv4;
@@ -1307,8 +2000,11 @@ int main(int argc, char *argv[])
 		// 设置链路属性
 		qbb.SetDeviceAttribute("DataRate", StringValue(data_rate));
 		qbb.SetChannelAttribute("Delay", StringValue(link_delay));
+		qbb.SetChannelAttribute("PacketTrain", BooleanValue(dci_packet_train && node_type[src] == 2 && node_type[dst] == 2));
 
-		if (error_rate > 0) {
+		if (error_rate > 0 || (thread_mode && error_rate_per_link > 0)) {
+			if (error_rate <= 0)
+				error_rate = error_rate_per_link;
 			Ptr<RateErrorModel> rem = CreateObject<RateErrorModel>();
 			Ptr<UniformRandomVariable> uv = CreateObject<UniformRandomVariable>();
 			rem->SetRandomVariable(uv);
@@ -1357,8 +2053,8 @@ int main(int argc, char *argv[])
 		ipv4.Assign(d);
 
 		// setup PFC trace
-		DynamicCast<QbbNetDevice>(d.Get(0))->TraceConnectWithoutContext("QbbPfc", MakeBoundCallback (&get_pfc, pfc_file, DynamicCast<QbbNetDevice>(d.Get(0))));
-		DynamicCast<QbbNetDevice>(d.Get(1))->TraceConnectWithoutContext("QbbPfc", MakeBoundCallback (&get_pfc, pfc_file, DynamicCast<QbbNetDevice>(d.Get(1))));
+		DynamicCast<QbbNetDevice>(d.Get(0))->TraceConnectWithoutContext("QbbPfc", MakeBoundCallback (&get_pfc, node_output(pfc_files, src), DynamicCast<QbbNetDevice>(d.Get(0))));
+		DynamicCast<QbbNetDevice>(d.Get(1))->TraceConnectWithoutContext("QbbPfc", MakeBoundCallback (&get_pfc, node_output(pfc_files, dst), DynamicCast<QbbNetDevice>(d.Get(1))));
 		
 		// ======= 此处为同步到DCISwitch的代码 =======
 		// 获取链路参数
@@ -1374,8 +2070,7 @@ int main(int argc, char *argv[])
 		if (snode->GetNodeType() == 2) {
 			// std::cout << GetCurrentTime() << "[test]DCI id: " << snode->GetId() << std::endl;
 			Ptr<DCISwitchNode> dci_sw = DynamicCast<DCISwitchNode>(snode);
-			dci_sw->m_linkDelay[port_src] = delay_src;
-			dci_sw->m_linkBw[port_src] = bw_src;
+			dci_sw->SetLinkInfo(port_src, delay_src, bw_src);
 
 			// 获取端口所对应的节点编号
 			for (auto& kv : nbr2if[snode]) {
@@ -1395,8 +2090,7 @@ int main(int argc, char *argv[])
 
 		if (dnode->GetNodeType() == 2) {
         Ptr<DCISwitchNode> dci_sw = DynamicCast<DCISwitchNode>(dnode);
-        dci_sw->m_linkDelay[port_dst] = delay_dst;
-        dci_sw->m_linkBw[port_dst] = bw_dst;
+        dci_sw->SetLinkInfo(port_dst, delay_dst, bw_dst);
 
 		// 获取端口所对应的节点编号
 		for (auto& kv : nbr2if[dnode]) {
@@ -1425,6 +2119,7 @@ int main(int argc, char *argv[])
 		// std::cout << "[TEST]n.Get(i)->GetNodeType(): " << n.Get(i)->GetNodeType() << std::endl;
 		if (n.Get(i)->GetNodeType() == 1){ // is switch
 			Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n.Get(i));
+			sw->InitPorts(); // 按实际端口数分配交换机/MMU的每端口状态
 			uint32_t shift = 3; // by default 1/8
 			for (uint32_t j = 1; j < sw->GetNDevices(); j++){
 				Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(sw->GetDevice(j));
@@ -1457,6 +2152,7 @@ int main(int argc, char *argv[])
 		}
 		else if (n.Get(i)->GetNodeType() == 2){ // is DCISwitch
 			Ptr<DCISwitchNode> sw = DynamicCast<DCISwitchNode>(n.Get(i));
+			sw->InitPorts(); // 按实际端口数分配交换机/MMU的每端口状态
 			uint32_t shift = 3; // by default 1/8
 			for (uint32_t j = 1; j < sw->GetNDevices(); j++){
 				Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(sw->GetDevice(j));
@@ -1483,14 +2179,12 @@ int main(int argc, char *argv[])
 			// std::cout << "[TEST]DCISwitch: " << sw->GetId() << "buffer_size: " << dci_buffer_size << "MB" << std::endl;
 			sw->m_mmu->node_id = sw->GetId();
 
-			// [NEW] 启动对端口队列的周期性监控
-			// Ptr<DCISwitchNode> dciSw = DynamicCast<DCISwitchNode>(n.Get(i));
-        	// Simulator::Schedule(NanoSeconds(0), &DCISwitchNode::PeriodicMonitorCongestionState, dciSw);
+			// [NEW] 端口队列的周期性监控由DCISwitchNode在RoutingMode 2下收到首包时自行启动（周期见CONG_SAMPLE_INTERVAL）
 		}
 	}
 
 	// #if ENABLE_QP
-	FILE *fct_output = fopen(fct_output_file.c_str(), "w");
+	std::vector<FILE*> fct_outputs = open_part_outputs(fct_output_file);
 
 	// Step 5: install RDMA driver for server host 安装RDMA驱动 [服务器主机端]
 	for (uint32_t i = 0; i < node_num; i++){
@@ -1528,7 +2222,7 @@ int main(int argc, char *argv[])
 
 			node->AggregateObject (rdma);
 			rdma->Init(); // check rdma-driver.cc, 根据网卡的数量，为每一个网卡创建一个Qbb网卡设备
-			rdma->TraceConnectWithoutContext("QpComplete", MakeBoundCallback (qp_finish, fct_output));
+			rdma->TraceConnectWithoutContext("QpComplete", MakeBoundCallback (qp_finish, node_output(fct_outputs, i)));
 		}
 	}
 	// #endif
@@ -1541,9 +2235,15 @@ int main(int argc, char *argv[])
 
 	// Step 6: setup routing 计算每个节点的路由，以及建立路由表
 	std::cout << GetCurrentTime() << "[test]Setup routing." << std::endl;
-	CalculateRoutes(n);
+	BuildRouteGraph(n);
+	CalculateRoutes();
 	SetRoutingEntries();
 
+	// INT的hop容量按拓扑直径设置，多预留2跳给链路故障后的绕行路径
+	NS_ABORT_MSG_IF(max_switch_hops + 2 > IntHeader::maxHopLimit, "topology diameter " << max_switch_hops << " + 2 exceeds IntHeader::maxHopLimit " << IntHeader::maxHopLimit);
+	IntHeader::maxHop = max_switch_hops + 2;
+	std::cout << GetCurrentTime() << "[test]Max switch hops: " << max_switch_hops << ", INT hop capacity: " << IntHeader::maxHop << std::endl;
+
 	// get BDP and delay
 	maxRtt = maxBdp = 0;
 	// TEST
@@ -1552,19 +2252,20 @@ int main(int argc, char *argv[])
 	uint64_t crtDelay = 0;
 	uint64_t crtTxDelay = 0;
 
-	for (uint32_t i = 0; i < node_num; i++){
-		if (n.Get(i)->GetNodeType() != 0)
-			continue;
-		for (uint32_t j = 0; j < node_num; j++){
-			if (n.Get(j)->GetNodeType() != 0)
-				continue;
-			uint64_t delay = pairDelay[n.Get(i)][n.Get(j)];
-			uint64_t txDelay = pairTxDelay[n.Get(i)][n.Get(j)];
+	pairBw.assign(hosts.size() * hosts.size(), 0);
+	pairBdp.assign(hosts.size() * hosts.size(), 0);
+	pairRtt.assign(hosts.size() * hosts.size(), 0);
+	for (uint32_t i : hosts){
+		for (uint32_t j : hosts){
+			const HostRoute &r = hostRoute[hostIdx[j]];
+			uint64_t delay = r.delay[i];
+			uint64_t txDelay = r.txDelay[i];
 			uint64_t rtt = delay * 2 + txDelay;
-			uint64_t bw = pairBw[i][j];
+			uint64_t bw = r.bw[i];
 			uint64_t bdp = rtt * bw / 1000000000/8; 
-			pairBdp[n.Get(i)][n.Get(j)] = bdp;
-			pairRtt[i][j] = rtt;
+			pairBw[host_pair(i, j)] = bw;
+			pairBdp[host_pair(i, j)] = bdp;
+			pairRtt[host_pair(i, j)] = rtt;
 
 			
 			if (bdp > maxBdp) {
@@ -1585,6 +2286,19 @@ int main(int argc, char *argv[])
 	// printf("%scrtRtt=crtDelay*2+crtTxDelay = %lu * 2 + %lu  =%lu(ns)\n", GetCurrentTime().c_str(), crtDelay, crtTxDelay, crtRtt);
 
 
+	// [NEW] 扫参模式：拓扑和路由已建好，为每个组合fork一个子进程，子进程从这里继续，父进程等待后退出
+	if (sweeping){
+		SweepVariant variant;
+		int ret;
+		if (!ForkSweep(variant, ret)){
+			remove_part_outputs(fct_outputs, fct_output_file);
+			remove_part_outputs(pfc_files, pfc_output_file);
+			return ret;
+		}
+		if (!SetupSweepChild(variant, fct_outputs, pfc_files))
+			return 1;
+	}
+
 	// Step 7: setup switch CC 配置交换机拥塞控制参数
 	//
 	for (uint32_t i = 0; i < node_num; i++){
@@ -1608,6 +2322,7 @@ int main(int argc, char *argv[])
 			dciSw->SetAttribute("Alpha", UintegerValue(alpha_cost));
 			dciSw->SetAttribute("Beta", UintegerValue(beta_cost));
 			dciSw->SetAttribute("S_total", UintegerValue(s_total));
+			dciSw->SetAttribute("CongSampleInterval", TimeValue(MicroSeconds(cong_sample_interval)));
 		}
 	}
 
@@ -1617,10 +2332,12 @@ int main(int argc, char *argv[])
 	// 用于指定监测节点
 	// add trace
 	//
-	FILE *trace_output = NULL;
+	std::vector<FILE*> trace_outputs;
 	if (enable_trace)
 	{
-		NodeContainer trace_nodes;
+		// 多线程仿真：每个分区的节点写自己的trace文件 <file>.part<N>(二进制格式，不合并)
+		trace_outputs = open_part_outputs(trace_output_file);
+		std::vector<NodeContainer> trace_nodes(trace_outputs.size());
 		for (uint32_t i = 0; i < trace_num; i++)
 		{
 			uint32_t nid;
@@ -1628,12 +2345,12 @@ int main(int argc, char *argv[])
 			if (nid >= n.GetN()){
 				continue;
 			}
-			trace_nodes = NodeContainer(trace_nodes, n.Get(nid));
+			uint32_t p = thread_mode ? node_rank[nid] : 0;
+			trace_nodes[p] = NodeContainer(trace_nodes[p], n.Get(nid));
 		}
 
-		trace_output = fopen(trace_output_file.c_str(), "w");
-		
-		qbb.EnableTracing(trace_output, trace_nodes);
+		for (uint32_t p = 0; p < trace_outputs.size(); p++)
+			qbb.EnableTracing(trace_outputs[p], trace_nodes[p]);
 		// dump link speed to trace file
 		
 			SimSetting sim_setting;
@@ -1646,7 +2363,8 @@ int main(int argc, char *argv[])
 				}
 			}
 			sim_setting.win = maxBdp;
-			sim_setting.Serialize(trace_output);
+			for (FILE *trace_output : trace_outputs)
+				sim_setting.Serialize(trace_output);
 	}
 
 
@@ -1694,20 +2412,20 @@ int main(int argc, char *argv[])
 	}
 
 	// schedule buffer monitor
-	FILE* qlen_output = fopen(qlen_mon_file.c_str(), "w");
+	FILE* qlen_output = fopen(rank_file(qlen_mon_file).c_str(), "w");
 	Simulator::Schedule(NanoSeconds(qlen_mon_start), &monitor_buffer, qlen_output, &n);
 
 	// [NEW] 新增链路利用率的追踪代码
 	FILE *fout_uplink = nullptr;
 	if (enable_link_util_record) {
 	// 创建 uplink 和 conn 输出文件
-	fout_uplink = fopen(link_util_output_file.c_str(), "w");
+	fout_uplink = fopen(rank_file(link_util_output_file).c_str(), "w");
 	// FILE *fout_conn = fopen((output_dir + "/conn.txt").c_str(), "w");
 
 	
 	for (int ToRId = 0; ToRId < node_num; ToRId++) {
 		Ptr<Node> node = n.Get(ToRId);
-		if (node->GetNodeType() == 2) {  // DCI switches
+		if (node->GetNodeType() == 2 && IsLocalNode(ToRId)) {  // DCI switches
 			auto swNode = DynamicCast<DCISwitchNode>(node);
 			for (auto &nextNodeIf : nbr2if[node]) {
 				if (nextNodeIf.first->GetNodeType() == 2) {  // nextNode is DCI switch (i.e., uplink)
@@ -1735,18 +2453,46 @@ int main(int argc, char *argv[])
 	NS_LOG_INFO("Run Simulation.");
 	// Simulator::Stop(Seconds(simulator_stop_time)); // 设置仿真停止时间
 
+	// [NEW] 性能报告：墙钟周期采样，输出到 perf_report.csv / perf_report.json
+	if (perf_report_interval > 0){
+		perf_report_output = fopen(rank_file(output_dir + "perf_report." + perf_report_format).c_str(), "w");
+		if (perf_report_format == "csv")
+			fprintf(perf_report_output, "wall_s,sim_ns,events,events_per_sec,pending_events,active_qps,busy_hosts,max_host_qps,completed_flows,rss_bytes\n");
+		perf_start_wall = perf_last_wall = get_wall_time();
+		perf_last_events = Simulator::GetEventCount();
+		Simulator::Schedule(Seconds(0), &perf_report, perf_report_output);
+	}
+
 	Simulator::Run();
 
-	Simulator::Destroy();
-	NS_LOG_INFO("Done.");
+	if (perf_report_output){
+		write_perf_report(perf_report_output, get_wall_time()); // 结束时的最后一行
+		fclose(perf_report_output);
+	}
 
 	// [new]清理资源
-	QbbChannel::CleanupTraceFiles();
-
-	if (enable_trace && trace_output) {
-		fclose(trace_output);
+	close_part_outputs(flow_path_outputs);
+	close_part_outputs(trace_outputs);
+
+	// [NEW] 分布式仿真：各rank写完后由rank 0合并FCT和PFC输出；多线程仿真合并各分区的输出
+	if (mpi_partition || thread_mode){
+		close_part_outputs(fct_outputs);
+		close_part_outputs(pfc_files);
+#ifdef NS3_MPI
+		if (mpi_partition)
+			MPI_Barrier(MPI_COMM_WORLD);
+#endif
+		if (mpi_rank == 0){
+			merge_rank_outputs(fct_output_file, true);
+			merge_rank_outputs(pfc_output_file, false);
+		}
 	}
 
+	Simulator::Destroy();
+	if (mpi_partition)
+		MpiInterface::Disable(); // MPI_Finalize
+	NS_LOG_INFO("Done.");
+
 	endt = clock();
 	std::cout << GetCurrentTime() << "Simulation time: " << (double)(endt - begint) / CLOCKS_PER_SEC << "s\n";
 	// 仿真结束后关闭文件
@@ -1899,11 +2645,19 @@ void ConfigureFlowTracking(const std::string& trace_flows_file, const std::strin
         );
         
         // 添加到追踪列表
-        QbbChannel::AddTraceFlow(flowIDToTrace, output_dir);
+        QbbChannel::AddTraceFlow(flowIDToTrace);
         
     }
 
     tracef.close();
+
+    // 有追踪流时才连接trace source，整个运行只使用一个带缓冲的输出文件
+    if (flow_num > 0) {
+        // 多线程仿真：跨分区的QbbRemoteChannel不能触发FlowPath(两端设备属于不同线程，引用计数不是线程安全的)，路径会缺少跨DC的跳
+        NS_ABORT_MSG_IF(thread_mode, "flow path tracing (" << trace_flows_file << ") is not supported with THREAD_PARTITION > 1");
+        flow_path_outputs = open_part_outputs(output_dir + "flow_path_trace.txt");
+        Config::ConnectWithoutContext("/ChannelList/*/$ns3::QbbChannel/FlowPath", MakeBoundCallback(&trace_flow_path, flow_path_outputs[0]));
+    }
 }
 
 // 辅助函数来检查目录是否存在
@@ -1917,6 +2671,21 @@ bool DirectoryExists(const std::string& path) {
 }
 
 // 对输出文件进行统一命名（包括对应文件夹，和后缀cc）
+std::string GetCcName(uint32_t mode) {
+	if (mode == 1)
+		return "dcqcn";
+	else if (mode == 3)
+		return "hpcc";
+	else if (mode == 7)
+		return "timely";
+	else if (mode == 8)
+		return "dctcp";
+	else if (mode == 10)
+		return "hpcc-pint";
+	else
+		return std::to_string(mode);
+}
+
 std::string replace_config_variables(const std::string& input) {
 	std::string result = input;
 	// 替换${WORKING_DIR} 或 ${OUTPUT_DIR}
@@ -1972,20 +2741,7 @@ std::string replace_config_variables(const std::string& input) {
 	// 替换${CC_NAME}
 	pos = result.find("${CC_NAME}");
 	while (pos != std::string::npos) {
-		std::string cc_name;
-		if (cc_mode == 1)
-			cc_name = "dcqcn";
-		else if (cc_mode == 3)
-			cc_name = "hpcc";
-		else if (cc_mode == 7)
-			cc_name = "timely";
-		else if (cc_mode == 8)
-			cc_name = "dctcp";
-		else if (cc_mode == 10)
-			cc_name = "hpcc-pint";
-		else
-			cc_name = std::to_string(cc_mode);
-
+		std::string cc_name = GetCcName(cc_mode);
 		result.replace(pos, 10, cc_name);
 		pos = result.find("${CC_NAME}", pos + cc_name.length());
 	}
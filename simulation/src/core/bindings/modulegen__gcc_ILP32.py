@@ -605,8 +605,8 @@ def register_Ns3EventId_methods(root_module, cls):
     cls.add_constructor([param('ns3::EventId const &', 'arg0')])
     ## event-id.h (module 'core'): ns3::EventId::EventId() [constructor]
     cls.add_constructor([])
-    ## event-id.h (module 'core'): ns3::EventId::EventId(ns3::Ptr<ns3::EventImpl> const & impl, uint64_t ts, uint32_t context, uint32_t uid) [constructor]
-    cls.add_constructor([param('ns3::Ptr< ns3::EventImpl > const &', 'impl'), param('uint64_t', 'ts'), param('uint32_t', 'context'), param('uint32_t', 'uid')])
+    ## event-id.h (module 'core'): ns3::EventId::EventId(ns3::Ptr<ns3::EventImpl> const & impl, uint64_t ts, uint32_t context, uint64_t uid) [constructor]
+    cls.add_constructor([param('ns3::Ptr< ns3::EventImpl > const &', 'impl'), param('uint64_t', 'ts'), param('uint32_t', 'context'), param('uint64_t', 'uid')])
     ## event-id.h (module 'core'): void ns3::EventId::Cancel() [member function]
     cls.add_method('Cancel', 
                    'void', 
@@ -621,9 +621,9 @@ def register_Ns3EventId_methods(root_module, cls):
                    'uint64_t', 
                    [], 
                    is_const=True)
-    ## event-id.h (module 'core'): uint32_t ns3::EventId::GetUid() const [member function]
+    ## event-id.h (module 'core'): uint64_t ns3::EventId::GetUid() const [member function]
     cls.add_method('GetUid', 
-                   'uint32_t', 
+                   'uint64_t', 
                    [], 
                    is_const=True)
     ## event-id.h (module 'core'): bool ns3::EventId::IsExpired() const [member function]
@@ -1963,7 +1963,7 @@ def register_Ns3SchedulerEventKey_methods(root_module, cls):
     ## scheduler.h (module 'core'): ns3::Scheduler::EventKey::m_ts [variable]
     cls.add_instance_attribute('m_ts', 'uint64_t', is_const=False)
     ## scheduler.h (module 'core'): ns3::Scheduler::EventKey::m_uid [variable]
-    cls.add_instance_attribute('m_uid', 'uint32_t', is_const=False)
+    cls.add_instance_attribute('m_uid', 'uint64_t', is_const=False)
     return
 
 def register_Ns3SequentialRandomVariable_methods(root_module, cls):
@@ -64,6 +64,8 @@ public:
   virtual void SetScheduler (ObjectFactory schedulerFactory);
   virtual uint32_t GetSystemId (void) const; 
   virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+  virtual uint64_t GetPendingEventCount (void) const;
 
 private:
   virtual void DoDispose (void);
@@ -87,13 +89,15 @@ private:
   bool m_stop;
   Ptr<Scheduler> m_events;
 
-  uint32_t m_uid;
-  uint32_t m_currentUid;
+  uint64_t m_uid;
+  uint64_t m_currentUid;
   uint64_t m_currentTs;
   uint32_t m_currentContext;
   // number of events that have been inserted but not yet scheduled,
   // not counting the "destroy" events; this is used for validation
   int m_unscheduledEvents;
+  // number of events executed so far
+  uint64_t m_eventCount;
 #if HAVE_PTHREAD_H
   SystemThread::ThreadId m_main;
 #endif
@@ -182,6 +182,15 @@ public:
    * \return the current simulation context
    */
   virtual uint32_t GetContext (void) const = 0;
+  /**
+   * \return the number of events executed so far
+   */
+  virtual uint64_t GetEventCount (void) const = 0;
+  /**
+   * \return the number of events scheduled but not executed yet
+   *          (cancelled events stay counted until they are dequeued)
+   */
+  virtual uint64_t GetPendingEventCount (void) const = 0;
 };
 
 } // namespace ns3
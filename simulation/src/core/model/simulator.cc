@@ -302,6 +302,18 @@ Simulator::GetContext (void)
   return GetImpl ()->GetContext ();
 }
 
+uint64_t
+Simulator::GetEventCount (void)
+{
+  return GetImpl ()->GetEventCount ();
+}
+
+uint64_t
+Simulator::GetPendingEventCount (void)
+{
+  return GetImpl ()->GetPendingEventCount ();
+}
+
 uint32_t
 Simulator::GetSystemId (void)
 {
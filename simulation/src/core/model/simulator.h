@@ -748,6 +748,16 @@ public:
    */
   static uint32_t GetContext (void);
 
+  /**
+   * \returns the number of events executed so far
+   */
+  static uint64_t GetEventCount (void);
+
+  /**
+   * \returns the number of events scheduled but not executed yet
+   */
+  static uint64_t GetPendingEventCount (void);
+
   /**
    * \param time delay until the event expires
    * \param event the event to schedule
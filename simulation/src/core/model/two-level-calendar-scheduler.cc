@@ -0,0 +1,343 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "two-level-calendar-scheduler.h"
+#include "event-impl.h"
+#include "uinteger.h"
+#include "assert.h"
+#include "log.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TwoLevelCalendarScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (TwoLevelCalendarScheduler);
+
+namespace {
+// std heap algorithms build max-heaps: compare with > to get the earliest event on top
+struct EventGreater
+{
+  bool operator () (const Scheduler::Event &a, const Scheduler::Event &b) const
+  {
+    return a.key > b.key;
+  }
+};
+} // anonymous namespace
+
+TypeId
+TwoLevelCalendarScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TwoLevelCalendarScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<TwoLevelCalendarScheduler> ()
+    .AddAttribute ("BucketWidth",
+                   "Width of a near bucket, in time steps (rounded up to a power of two).",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&TwoLevelCalendarScheduler::m_bucketWidth),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("NearBuckets",
+                   "Number of near buckets (rounded up to a power of two).",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&TwoLevelCalendarScheduler::m_nearBuckets),
+                   MakeUintegerChecker<uint32_t> (2, 1 << 24))
+    .AddAttribute ("FarBuckets",
+                   "Number of far buckets, each NearBuckets*BucketWidth wide (rounded up to a power of two).",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&TwoLevelCalendarScheduler::m_farBuckets),
+                   MakeUintegerChecker<uint32_t> (2, 1 << 24))
+  ;
+  return tid;
+}
+
+TwoLevelCalendarScheduler::TwoLevelCalendarScheduler ()
+  : m_bucketWidth (1024),
+    m_nearBuckets (1024),
+    m_farBuckets (1024),
+    m_qSize (0)
+{
+  NS_LOG_FUNCTION (this);
+  Init ();
+}
+TwoLevelCalendarScheduler::~TwoLevelCalendarScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TwoLevelCalendarScheduler::NotifyConstructionCompleted (void)
+{
+  NS_LOG_FUNCTION (this);
+  // attributes are only known now
+  NS_ASSERT (m_qSize == 0);
+  Init ();
+  Scheduler::NotifyConstructionCompleted ();
+}
+
+uint32_t
+TwoLevelCalendarScheduler::Log2Ceil (uint32_t v)
+{
+  uint32_t bits = 0;
+  while ((uint64_t)1 << bits < v)
+    {
+      bits++;
+    }
+  return bits;
+}
+
+void
+TwoLevelCalendarScheduler::Init (void)
+{
+  NS_LOG_FUNCTION (this << m_bucketWidth << m_nearBuckets << m_farBuckets);
+  m_widthBits = Log2Ceil (m_bucketWidth);
+  m_nearBits = Log2Ceil (m_nearBuckets);
+  m_farBits = Log2Ceil (m_farBuckets);
+  NS_ASSERT (m_widthBits + m_nearBits + m_farBits < 64);
+  uint32_t nNear = 1 << m_nearBits, nFar = 1 << m_farBits;
+
+  m_bottom.clear ();
+  m_near.assign (nNear, Bucket ());
+  m_nearMap.assign ((nNear + 63) / 64, 0);
+  m_nearCount = 0;
+  m_far.assign (nFar, Bucket ());
+  m_farMap.assign ((nFar + 63) / 64, 0);
+  m_farCount = 0;
+  m_overflow.clear ();
+  m_curNear = 0;
+  m_curFar = 0;
+}
+
+int64_t
+TwoLevelCalendarScheduler::FindNextSet (const std::vector<uint64_t> &map, uint32_t from)
+{
+  uint32_t w = from / 64;
+  if (w >= map.size ())
+    {
+      return -1;
+    }
+  uint64_t word = map[w] & (~(uint64_t)0 << (from % 64));
+  while (true)
+    {
+      if (word != 0)
+        {
+          return (int64_t)w * 64 + __builtin_ctzll (word);
+        }
+      if (++w == map.size ())
+        {
+          return -1;
+        }
+      word = map[w];
+    }
+}
+
+void
+TwoLevelCalendarScheduler::DoInsert (const Event &ev)
+{
+  uint64_t nearIdx = ev.key.m_ts >> m_widthBits;
+  if (nearIdx <= m_curNear)
+    {
+      m_bottom.push_back (ev);
+      std::push_heap (m_bottom.begin (), m_bottom.end (), EventGreater ());
+      return;
+    }
+  // nearIdx > m_curNear >= (m_curFar << m_nearBits) - 1, so farIdx >= m_curFar
+  uint64_t farIdx = nearIdx >> m_nearBits;
+  if (farIdx == m_curFar)
+    {
+      uint32_t i = nearIdx & ((1 << m_nearBits) - 1);
+      m_near[i].push_back (ev);
+      m_nearMap[i / 64] |= (uint64_t)1 << (i % 64);
+      m_nearCount++;
+    }
+  else if (farIdx - m_curFar < ((uint64_t)1 << m_farBits))
+    {
+      uint32_t i = farIdx & ((1 << m_farBits) - 1);
+      m_far[i].push_back (ev);
+      m_farMap[i / 64] |= (uint64_t)1 << (i % 64);
+      m_farCount++;
+    }
+  else
+    {
+      m_overflow.push_back (ev);
+      std::push_heap (m_overflow.begin (), m_overflow.end (), EventGreater ());
+    }
+}
+
+void
+TwoLevelCalendarScheduler::Advance (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t nearMask = (1 << m_nearBits) - 1, farMask = (1 << m_farBits) - 1;
+  while (m_bottom.empty ())
+    {
+      NS_ASSERT (m_qSize > 0);
+      if (m_nearCount > 0)
+        {
+          // the next non-empty near bucket of the current far bucket
+          int64_t i = FindNextSet (m_nearMap, (m_curNear + 1) & nearMask);
+          NS_ASSERT (i >= 0);
+          m_curNear = (m_curFar << m_nearBits) | i;
+          m_bottom.swap (m_near[i]);
+          m_nearMap[i / 64] &= ~((uint64_t)1 << (i % 64));
+          m_nearCount -= m_bottom.size ();
+          std::make_heap (m_bottom.begin (), m_bottom.end (), EventGreater ());
+          NS_LOG_LOGIC ("near bucket " << m_curNear << " to bottom, " << m_bottom.size () << " events");
+          continue;
+        }
+
+      // the near calendar is empty: move on to the next non-empty far bucket
+      bool fromFar = m_farCount > 0;
+      uint64_t nextFar;
+      if (fromFar)
+        {
+          int64_t i = FindNextSet (m_farMap, (m_curFar + 1) & farMask);
+          if (i < 0)
+            {
+              i = FindNextSet (m_farMap, 0);
+            }
+          NS_ASSERT (i >= 0);
+          nextFar = m_curFar + ((i - m_curFar) & farMask);
+        }
+      else
+        {
+          nextFar = m_overflow.front ().key.m_ts >> (m_widthBits + m_nearBits);
+        }
+      NS_ASSERT (nextFar > m_curFar);
+      m_curFar = nextFar;
+      m_curNear = (m_curFar << m_nearBits) - 1;
+      NS_LOG_LOGIC ("far bucket " << m_curFar);
+
+      if (fromFar)
+        {
+          uint32_t i = m_curFar & farMask;
+          Bucket &bucket = m_far[i];
+          for (Bucket::const_iterator it = bucket.begin (); it != bucket.end (); ++it)
+            {
+              uint32_t j = (it->key.m_ts >> m_widthBits) & nearMask;
+              m_near[j].push_back (*it);
+              m_nearMap[j / 64] |= (uint64_t)1 << (j % 64);
+            }
+          m_nearCount += bucket.size ();
+          m_farCount -= bucket.size ();
+          bucket.clear ();
+          m_farMap[i / 64] &= ~((uint64_t)1 << (i % 64));
+        }
+      // pull the overflow events that the far calendar now covers
+      while (!m_overflow.empty ()
+             && (m_overflow.front ().key.m_ts >> (m_widthBits + m_nearBits)) - m_curFar <= farMask)
+        {
+          std::pop_heap (m_overflow.begin (), m_overflow.end (), EventGreater ());
+          Scheduler::Event ev = m_overflow.back ();
+          m_overflow.pop_back ();
+          DoInsert (ev);
+        }
+    }
+}
+
+void
+TwoLevelCalendarScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.key.m_ts << ev.key.m_uid);
+  DoInsert (ev);
+  m_qSize++;
+}
+bool
+TwoLevelCalendarScheduler::IsEmpty (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_qSize == 0;
+}
+Scheduler::Event
+TwoLevelCalendarScheduler::PeekNext (void) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  // refilling the bottom does not change the order of the queue, only where events are kept
+  const_cast<TwoLevelCalendarScheduler *> (this)->Advance ();
+  return m_bottom.front ();
+}
+Scheduler::Event
+TwoLevelCalendarScheduler::RemoveNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  Advance ();
+  std::pop_heap (m_bottom.begin (), m_bottom.end (), EventGreater ());
+  Scheduler::Event ev = m_bottom.back ();
+  m_bottom.pop_back ();
+  m_qSize--;
+  return ev;
+}
+
+bool
+TwoLevelCalendarScheduler::RemoveFromBucket (Bucket &bucket, const Event &ev)
+{
+  for (Bucket::iterator i = bucket.begin (); i != bucket.end (); ++i)
+    {
+      if (i->key.m_uid == ev.key.m_uid)
+        {
+          NS_ASSERT (ev.impl == i->impl);
+          *i = bucket.back ();
+          bucket.pop_back ();
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+TwoLevelCalendarScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.key.m_ts << ev.key.m_uid);
+  NS_ASSERT (!IsEmpty ());
+  uint64_t nearIdx = ev.key.m_ts >> m_widthBits;
+  uint64_t farIdx = nearIdx >> m_nearBits;
+  bool found;
+  if (nearIdx <= m_curNear)
+    {
+      found = RemoveFromBucket (m_bottom, ev);
+      std::make_heap (m_bottom.begin (), m_bottom.end (), EventGreater ());
+    }
+  else if (farIdx == m_curFar)
+    {
+      uint32_t i = nearIdx & ((1 << m_nearBits) - 1);
+      found = RemoveFromBucket (m_near[i], ev);
+      m_nearCount -= found;
+      if (m_near[i].empty ())
+        {
+          m_nearMap[i / 64] &= ~((uint64_t)1 << (i % 64));
+        }
+    }
+  else if (farIdx - m_curFar < ((uint64_t)1 << m_farBits))
+    {
+      uint32_t i = farIdx & ((1 << m_farBits) - 1);
+      found = RemoveFromBucket (m_far[i], ev);
+      m_farCount -= found;
+      if (m_far[i].empty ())
+        {
+          m_farMap[i / 64] &= ~((uint64_t)1 << (i % 64));
+        }
+    }
+  else
+    {
+      found = RemoveFromBucket (m_overflow, ev);
+      std::make_heap (m_overflow.begin (), m_overflow.end (), EventGreater ());
+    }
+  NS_ASSERT (found);
+  m_qSize--;
+}
+
+} // namespace ns3
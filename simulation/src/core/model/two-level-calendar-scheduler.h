@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TWO_LEVEL_CALENDAR_SCHEDULER_H
+#define TWO_LEVEL_CALENDAR_SCHEDULER_H
+
+#include "scheduler.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup scheduler
+ * \brief a two-level calendar event scheduler with an overflow tier
+ *
+ * Events are kept in three tiers, ordered by their timestamp:
+ *  - the bottom: a binary heap holding every event of the current near
+ *    bucket (and any event scheduled at or before it);
+ *  - the near calendar: NearBuckets unsorted buckets of BucketWidth time
+ *    steps each, covering exactly one far bucket;
+ *  - the far calendar: FarBuckets unsorted buckets of
+ *    NearBuckets*BucketWidth time steps each;
+ *  - the overflow: a binary heap for everything beyond the far calendar.
+ *
+ * Inserting is O(1) except in the bottom and overflow heaps. An event is
+ * moved at most once from the overflow to the far calendar, once from the
+ * far to the near calendar and once into the bottom, and only the bottom
+ * is ever sorted. Empty buckets are skipped with one bit per bucket.
+ *
+ * The defaults (1024 ns buckets, 1024 near buckets, 1024 far buckets with
+ * a nanosecond time resolution) fit a mix of ~1 us intra-DC events with a
+ * large standing set of ~10 ms inter-DC link arrivals: the former stay in
+ * the bottom and the near calendar, the latter wait unsorted in the far
+ * calendar. The sizes are rounded up to powers of two.
+ */
+class TwoLevelCalendarScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  TwoLevelCalendarScheduler ();
+  virtual ~TwoLevelCalendarScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  typedef std::vector<Scheduler::Event> Bucket;
+
+  virtual void NotifyConstructionCompleted (void);
+  void Init (void);
+  void DoInsert (const Event &ev);
+  // refill the bottom from the calendars once it is empty
+  void Advance (void);
+  static uint32_t Log2Ceil (uint32_t v);
+  static int64_t FindNextSet (const std::vector<uint64_t> &map, uint32_t from);
+  static bool RemoveFromBucket (Bucket &bucket, const Event &ev);
+
+  // attributes
+  uint32_t m_bucketWidth;
+  uint32_t m_nearBuckets;
+  uint32_t m_farBuckets;
+
+  // log2 of the bucket width, of the number of near and far buckets
+  uint32_t m_widthBits;
+  uint32_t m_nearBits;
+  uint32_t m_farBits;
+
+  Bucket m_bottom;                  // heap
+  std::vector<Bucket> m_near;
+  std::vector<uint64_t> m_nearMap;  // one bit per non-empty near bucket
+  uint32_t m_nearCount;
+  std::vector<Bucket> m_far;
+  std::vector<uint64_t> m_farMap;   // one bit per non-empty far bucket
+  uint32_t m_farCount;
+  Bucket m_overflow;                // heap
+
+  // absolute index of the near bucket held by the bottom: every event of
+  // a near bucket <= m_curNear is in the bottom
+  uint64_t m_curNear;
+  // absolute index of the far bucket covered by the near calendar
+  uint64_t m_curFar;
+  // number of events in queue
+  uint32_t m_qSize;
+};
+
+} // namespace ns3
+
+#endif /* TWO_LEVEL_CALENDAR_SCHEDULER_H */
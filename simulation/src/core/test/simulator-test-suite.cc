@@ -23,6 +23,8 @@
 #include "ns3/heap-scheduler.h"
 #include "ns3/map-scheduler.h"
 #include "ns3/calendar-scheduler.h"
+#include "ns3/two-level-calendar-scheduler.h"
+#include "ns3/scheduler.h"
 
 namespace ns3 {
 
@@ -459,6 +461,70 @@ SimulatorTemplateTestCase::DoRun (void)
   Simulator::Destroy ();
 }
 
+// Event uids go past 2^32 in long runs: simultaneous events must stay in
+// scheduling order across that boundary.
+class SchedulerUidTestCase : public TestCase
+{
+public:
+  SchedulerUidTestCase (ObjectFactory schedulerFactory);
+  virtual void DoRun (void);
+  ObjectFactory m_schedulerFactory;
+};
+
+SchedulerUidTestCase::SchedulerUidTestCase (ObjectFactory schedulerFactory)
+  : TestCase ("Check the order of events with uids above 2^32 with " +
+              schedulerFactory.GetTypeId ().GetName ()),
+    m_schedulerFactory (schedulerFactory)
+{
+}
+
+void
+SchedulerUidTestCase::DoRun (void)
+{
+  Ptr<Scheduler> scheduler = m_schedulerFactory.Create<Scheduler> ();
+  const uint64_t wrap = (uint64_t)1 << 32;
+  // inserted out of order; expected order: uid within the same timestamp.
+  // uids are unique: the second timestamp uses uids + 8
+  uint64_t uids[] = { wrap + 1, wrap - 1, 5, wrap, wrap - 2, wrap + 2 };
+  uint64_t ts[] = { 1000, 2000 };
+  for (uint32_t t = 0; t < 2; t++)
+    {
+      for (uint32_t i = 0; i < 6; i++)
+        {
+          Scheduler::Event ev;
+          ev.impl = 0;
+          ev.key.m_ts = ts[t];
+          ev.key.m_uid = uids[i] + 8 * t;
+          ev.key.m_context = 0;
+          scheduler->Insert (ev);
+        }
+    }
+  // an event above 2^32 can be removed
+  Scheduler::Event removed;
+  removed.impl = 0;
+  removed.key.m_ts = 2000;
+  removed.key.m_uid = wrap + 1 + 8;
+  removed.key.m_context = 0;
+  scheduler->Remove (removed);
+
+  uint64_t expected[] = { 5, wrap - 2, wrap - 1, wrap, wrap + 1, wrap + 2 };
+  for (uint32_t t = 0; t < 2; t++)
+    {
+      for (uint32_t i = 0; i < 6; i++)
+        {
+          if (t == 1 && expected[i] == wrap + 1)
+            {
+              continue;
+            }
+          NS_TEST_ASSERT_MSG_EQ (scheduler->IsEmpty (), false, "events left");
+          Scheduler::Event ev = scheduler->RemoveNext ();
+          NS_TEST_EXPECT_MSG_EQ (ev.key.m_ts, ts[t], "timestamp order");
+          NS_TEST_EXPECT_MSG_EQ (ev.key.m_uid, expected[i] + 8 * t, "uid order");
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (scheduler->IsEmpty (), true, "all events removed");
+}
+
 class SimulatorTestSuite : public TestSuite
 {
 public:
@@ -475,6 +541,19 @@ public:
     AddTestCase (new SimulatorEventsTestCase (factory));
     factory.SetTypeId (CalendarScheduler::GetTypeId ());
     AddTestCase (new SimulatorEventsTestCase (factory));
+    factory.SetTypeId (TwoLevelCalendarScheduler::GetTypeId ());
+    AddTestCase (new SimulatorEventsTestCase (factory));
+
+    factory.SetTypeId (ListScheduler::GetTypeId ());
+    AddTestCase (new SchedulerUidTestCase (factory));
+    factory.SetTypeId (MapScheduler::GetTypeId ());
+    AddTestCase (new SchedulerUidTestCase (factory));
+    factory.SetTypeId (HeapScheduler::GetTypeId ());
+    AddTestCase (new SchedulerUidTestCase (factory));
+    factory.SetTypeId (CalendarScheduler::GetTypeId ());
+    AddTestCase (new SchedulerUidTestCase (factory));
+    factory.SetTypeId (TwoLevelCalendarScheduler::GetTypeId ());
+    AddTestCase (new SchedulerUidTestCase (factory));
   }
 } g_simulatorTestSuite;
 
@@ -67,6 +67,11 @@ LbtsMessage::GetMyId ()
 {
   return m_myId;
 }
+bool
+LbtsMessage::IsFinished ()
+{
+  return m_isFinished;
+}
 
 Time DistributedSimulatorImpl::m_lookAhead = Seconds (0);
 
@@ -94,6 +99,8 @@ DistributedSimulatorImpl::DistributedSimulatorImpl ()
 #endif
 
   m_stop = false;
+  m_localDone = false;
+  m_globalFinished = false;
   // uids are allocated from 4.
   // uid 0 is "invalid" events
   // uid 1 is "now" events
@@ -104,6 +111,7 @@ DistributedSimulatorImpl::DistributedSimulatorImpl ()
   m_currentTs = 0;
   m_currentContext = 0xffffffff;
   m_unscheduledEvents = 0;
+  m_eventCount = 0;
   m_events = 0;
 }
 
@@ -238,6 +246,7 @@ DistributedSimulatorImpl::ProcessOneEvent (void)
 
   NS_ASSERT (next.key.m_ts >= m_currentTs);
   m_unscheduledEvents--;
+  m_eventCount++;
 
   NS_LOG_LOGIC ("handle " << next.key.m_ts);
   m_currentTs = next.key.m_ts;
@@ -253,10 +262,26 @@ DistributedSimulatorImpl::IsFinished (void) const
   return m_events->IsEmpty () || m_stop;
 }
 
+bool
+DistributedSimulatorImpl::IsLocalFinished (void) const
+{
+  return m_events->IsEmpty () || m_stop || m_localDone;
+}
+
+void
+DistributedSimulatorImpl::SetLocalDone (void)
+{
+  m_localDone = true;
+}
+
 uint64_t
 DistributedSimulatorImpl::NextTs (void) const
 {
-  NS_ASSERT (!m_events->IsEmpty ());
+  // an idle rank must still take part in the LBTS rounds
+  if (m_events->IsEmpty ())
+    {
+      return GetMaximumSimulationTime ().GetTimeStep ();
+    }
   Scheduler::Event ev = m_events->PeekNext ();
   return ev.key.m_ts;
 }
@@ -273,10 +298,14 @@ DistributedSimulatorImpl::Run (void)
 #ifdef NS3_MPI
   CalculateLookAhead ();
   m_stop = false;
-  while (!m_events->IsEmpty () && !m_stop)
+  m_globalFinished = false;
+  // A rank that runs out of events (or is stopped) keeps taking part in the
+  // LBTS rounds: it may still receive packets, and leaving early would block
+  // the other ranks in MPI_Allgather. All ranks leave in the same round.
+  while (!m_globalFinished)
     {
       Time nextTime = Next ();
-      if (nextTime > m_grantedTime)
+      if (nextTime > m_grantedTime || m_stop)
         { // Can't process, calculate a new LBTS
           // First receive any pending messages
           MpiInterface::ReceiveMessages ();
@@ -285,7 +314,7 @@ DistributedSimulatorImpl::Run (void)
           // And check for send completes
           MpiInterface::TestSendComplete ();
           // Finally calculate the lbts
-          LbtsMessage lMsg (MpiInterface::GetRxCount (), MpiInterface::GetTxCount (), m_myId, nextTime);
+          LbtsMessage lMsg (MpiInterface::GetRxCount (), MpiInterface::GetTxCount (), m_myId, IsLocalFinished (), nextTime);
           m_pLBTS[m_myId] = lMsg;
           MPI_Allgather (&lMsg, sizeof (LbtsMessage), MPI_BYTE, m_pLBTS,
                          sizeof (LbtsMessage), MPI_BYTE, MPI_COMM_WORLD);
@@ -295,6 +324,7 @@ DistributedSimulatorImpl::Run (void)
           // so we don't update the granted time.
           uint32_t totRx = m_pLBTS[0].GetRxCount ();
           uint32_t totTx = m_pLBTS[0].GetTxCount ();
+          bool allFinished = m_pLBTS[0].IsFinished ();
 
           for (uint32_t i = 1; i < m_systemCount; ++i)
             {
@@ -304,14 +334,18 @@ DistributedSimulatorImpl::Run (void)
                 }
               totRx += m_pLBTS[i].GetRxCount ();
               totTx += m_pLBTS[i].GetTxCount ();
-
+              allFinished = allFinished && m_pLBTS[i].IsFinished ();
             }
           if (totRx == totTx)
             {
-              m_grantedTime = smallestTime + DistributedSimulatorImpl::m_lookAhead;
+              m_globalFinished = allFinished;
+              if (smallestTime < GetMaximumSimulationTime ())
+                {
+                  m_grantedTime = smallestTime + DistributedSimulatorImpl::m_lookAhead;
+                }
             }
         }
-      if (nextTime <= m_grantedTime)
+      if (!m_globalFinished && !m_stop && !m_events->IsEmpty () && nextTime <= m_grantedTime)
         { // Save to process
           ProcessOneEvent ();
         }
@@ -510,4 +544,16 @@ DistributedSimulatorImpl::GetContext (void) const
   return m_currentContext;
 }
 
+uint64_t
+DistributedSimulatorImpl::GetEventCount (void) const
+{
+  return m_eventCount;
+}
+
+uint64_t
+DistributedSimulatorImpl::GetPendingEventCount (void) const
+{
+  return m_unscheduledEvents;
+}
+
 } // namespace ns3
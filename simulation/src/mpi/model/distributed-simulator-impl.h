@@ -39,7 +39,8 @@ public:
   LbtsMessage ()
     : m_txCount (0),
       m_rxCount (0),
-      m_myId (0)
+      m_myId (0),
+      m_isFinished (false)
   {
   }
 
@@ -47,12 +48,14 @@ public:
    * \param rxc received count
    * \param txc transmitted count
    * \param id mpi rank
+   * \param isFinished whether this rank is finished (stopped, done or out of events)
    * \param t smallest time
    */
-  LbtsMessage (uint32_t rxc, uint32_t txc, uint32_t id, const Time& t)
+  LbtsMessage (uint32_t rxc, uint32_t txc, uint32_t id, bool isFinished, const Time& t)
     : m_txCount (txc),
       m_rxCount (rxc),
       m_myId (id),
+      m_isFinished (isFinished),
       m_smallestTime (t)
   {
   }
@@ -75,11 +78,16 @@ public:
    * \return id which corresponds to mpi rank
    */
   uint32_t GetMyId ();
+  /**
+   * \return true if the rank is finished
+   */
+  bool IsFinished ();
 
 private:
   uint32_t m_txCount;
   uint32_t m_rxCount;
   uint32_t m_myId;
+  bool     m_isFinished;
   Time     m_smallestTime;
 };
 
@@ -115,10 +123,21 @@ public:
   virtual void SetScheduler (ObjectFactory schedulerFactory);
   virtual uint32_t GetSystemId (void) const;
   virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+  virtual uint64_t GetPendingEventCount (void) const;
+
+  /**
+   * Mark this rank as done without stopping it: it keeps processing its
+   * events (e.g. to serve packets sent by the other ranks), and Run ()
+   * returns on every rank in the same LBTS round once all the ranks are
+   * done, stopped or out of events.
+   */
+  void SetLocalDone (void);
 
 private:
   virtual void DoDispose (void);
   void CalculateLookAhead (void);
+  bool IsLocalFinished (void) const;
 
   void ProcessOneEvent (void);
   uint64_t NextTs (void) const;
@@ -127,14 +146,18 @@ private:
 
   DestroyEvents m_destroyEvents;
   bool m_stop;
+  bool m_localDone;
+  bool m_globalFinished;
   Ptr<Scheduler> m_events;
-  uint32_t m_uid;
-  uint32_t m_currentUid;
+  uint64_t m_uid;
+  uint64_t m_currentUid;
   uint64_t m_currentTs;
   uint32_t m_currentContext;
   // number of events that have been inserted but not yet scheduled,
   // not counting the "destroy" events; this is used for validation
   int m_unscheduledEvents;
+  // number of events executed so far
+  uint64_t m_eventCount;
 
   LbtsMessage* m_pLBTS;       // Allocated once we know how many systems
   uint32_t     m_myId;        // MPI Rank
@@ -0,0 +1,813 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "multithreaded-simulator-impl.h"
+
+#include "ns3/simulator.h"
+#include "ns3/scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/system-thread.h"
+#include "ns3/channel.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <sched.h>
+
+NS_LOG_COMPONENT_DEFINE ("MultithreadedSimulatorImpl");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (MultithreadedSimulatorImpl);
+
+namespace {
+const uint64_t NO_EVENT = 0x7fffffffffffffffLL;
+
+// a uid is (G, k), k in the low bits
+const uint32_t UID_K_BITS = 24;
+const uint64_t UID_K_MASK = (1ULL << UID_K_BITS) - 1;
+
+// the partition run by the calling thread, 0 for the global events
+__thread void *g_current __attribute__ ((tls_model ("initial-exec"))) = 0;
+} // anonymous namespace
+
+MultithreadedSimulatorImpl::Barrier::Barrier ()
+  : m_count (1),
+    m_waiting (0),
+    m_sense (0)
+{
+}
+
+void
+MultithreadedSimulatorImpl::Barrier::Init (uint32_t count)
+{
+  m_count = count;
+  m_waiting = 0;
+}
+
+void
+MultithreadedSimulatorImpl::Barrier::Wait (void)
+{
+  uint32_t sense = m_sense.load ();
+  if (m_waiting.fetch_add (1) + 1 == m_count)
+    {
+      m_waiting.store (0);
+      m_sense.store (sense + 1);
+      return;
+    }
+  // windows are short: spin first, but leave the cpu to the others when
+  // there are more threads than cores
+  for (uint32_t spins = 0; m_sense.load () == sense; spins++)
+    {
+      if (spins > 1000)
+        {
+          sched_yield ();
+        }
+    }
+}
+
+TypeId
+MultithreadedSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MultithreadedSimulatorImpl")
+    .SetParent<Object> ()
+    .AddConstructor<MultithreadedSimulatorImpl> ()
+  ;
+  return tid;
+}
+
+MultithreadedSimulatorImpl::MultithreadedSimulatorImpl ()
+  : m_lookAhead (NO_EVENT),
+    m_stop (false),
+    m_done (false),
+    // G starts at 1: uid 0 is "invalid" events, uid 1 "now" events and
+    // uid 2 "destroy" events
+    m_nextG (1),
+    m_gBase (1)
+{
+  NS_LOG_FUNCTION (this);
+  m_global.impl = this;
+  m_global.id = 0;
+  m_global.events = 0;
+  // before ::Run is entered, the m_currentUid will be zero
+  m_global.currentUid = 0;
+  m_global.currentTs = 0;
+  m_global.currentContext = 0xffffffff;
+  m_global.currentEvent = 0;
+  m_global.curG = 0;
+  m_global.curK = 0;
+  m_global.unscheduledEvents = 0;
+  m_global.eventCount = 0;
+  m_global.windowEnd = 0;
+  m_global.stop = false;
+  m_end.m_ts = 0;
+  m_end.m_uid = 0;
+  m_end.m_context = 0;
+}
+
+MultithreadedSimulatorImpl::~MultithreadedSimulatorImpl ()
+{
+}
+
+void
+MultithreadedSimulatorImpl::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_partitions.push_back (&m_global);
+  for (std::vector<LogicalProcess *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      LogicalProcess *lp = *i;
+      while (!lp->events->IsEmpty ())
+        {
+          Scheduler::Event next = lp->events->RemoveNext ();
+          next.impl->Unref ();
+        }
+      lp->events = 0;
+      if (lp != &m_global)
+        {
+          delete lp;
+        }
+    }
+  m_partitions.clear ();
+  SimulatorImpl::DoDispose ();
+}
+
+void
+MultithreadedSimulatorImpl::Destroy ()
+{
+  while (!m_destroyEvents.empty ())
+    {
+      Ptr<EventImpl> ev = m_destroyEvents.front ().PeekEventImpl ();
+      m_destroyEvents.pop_front ();
+      NS_LOG_LOGIC ("handle destroy " << ev);
+      if (!ev->IsCancelled ())
+        {
+          ev->Invoke ();
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::SetScheduler (ObjectFactory schedulerFactory)
+{
+  NS_LOG_FUNCTION (this << schedulerFactory);
+  NS_ASSERT (g_current == 0);
+  m_schedulerFactory = schedulerFactory;
+  m_partitions.push_back (&m_global);
+  for (std::vector<LogicalProcess *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      Ptr<Scheduler> scheduler = schedulerFactory.Create<Scheduler> ();
+      if ((*i)->events != 0)
+        {
+          while (!(*i)->events->IsEmpty ())
+            {
+              Scheduler::Event next = (*i)->events->RemoveNext ();
+              scheduler->Insert (next);
+            }
+        }
+      (*i)->events = scheduler;
+    }
+  m_partitions.pop_back ();
+}
+
+MultithreadedSimulatorImpl::LogicalProcess *
+MultithreadedSimulatorImpl::GetPartition (uint32_t id)
+{
+  while (m_partitions.size () <= id)
+    {
+      // partitions only appear while a single thread runs: setup or global events
+      NS_ASSERT (g_current == 0);
+      LogicalProcess *lp = new LogicalProcess ();
+      lp->impl = this;
+      lp->id = m_partitions.size ();
+      lp->events = m_schedulerFactory.Create<Scheduler> ();
+      lp->currentUid = 0;
+      lp->currentTs = m_global.currentTs;
+      lp->currentContext = 0xffffffff;
+      lp->currentEvent = 0;
+      lp->curG = 0;
+      lp->curK = 0;
+      lp->unscheduledEvents = 0;
+      lp->eventCount = 0;
+      lp->windowEnd = 0;
+      lp->stop = false;
+      m_partitions.push_back (lp);
+    }
+  return m_partitions[id];
+}
+
+MultithreadedSimulatorImpl::LogicalProcess *
+MultithreadedSimulatorImpl::GetContextOwner (uint32_t context)
+{
+  if (context == 0xffffffff)
+    {
+      return &m_global;
+    }
+  if (context < m_nodePartition.size ())
+    {
+      return m_partitions[m_nodePartition[context]];
+    }
+  // a node created since the last lookup: only during setup or global events
+  NS_ASSERT (g_current == 0);
+  for (uint32_t i = m_nodePartition.size (); i < NodeList::GetNNodes (); i++)
+    {
+      m_nodePartition.push_back (NodeList::GetNode (i)->GetSystemId ());
+      GetPartition (m_nodePartition.back ());
+    }
+  if (context < m_nodePartition.size ())
+    {
+      return m_partitions[m_nodePartition[context]];
+    }
+  // not a node
+  return GetPartition (0);
+}
+
+MultithreadedSimulatorImpl::LogicalProcess *
+MultithreadedSimulatorImpl::GetCurrent (void) const
+{
+  if (g_current == 0)
+    {
+      return const_cast<LogicalProcess *> (&m_global);
+    }
+  return static_cast<LogicalProcess *> (g_current);
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetPartitionCount (void) const
+{
+  return m_partitions.size ();
+}
+
+void
+MultithreadedSimulatorImpl::CalculateLookAhead (void)
+{
+  NS_LOG_FUNCTION (this);
+  GetContextOwner (0xfffffffe); // map every node to its partition
+  GetPartition (0);
+  m_lookAhead = NO_EVENT;
+  for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+    {
+      for (uint32_t i = 0; i < (*n)->GetNDevices (); ++i)
+        {
+          Ptr<Channel> channel = (*n)->GetDevice (i)->GetChannel ();
+          if (channel == 0)
+            {
+              continue;
+            }
+          bool remote = false;
+          for (uint32_t j = 0; j < channel->GetNDevices (); ++j)
+            {
+              remote = remote || channel->GetDevice (j)->GetNode ()->GetSystemId () != (*n)->GetSystemId ();
+            }
+          if (!remote)
+            {
+              continue;
+            }
+          TimeValue delay;
+          if (!channel->GetAttributeFailSafe ("Delay", delay))
+            {
+              NS_FATAL_ERROR ("Channel " << channel->GetInstanceTypeId ().GetName ()
+                              << " between two partitions has no Delay attribute");
+            }
+          m_lookAhead = std::min (m_lookAhead, (uint64_t)delay.Get ().GetTimeStep ());
+        }
+    }
+  if (m_lookAhead == 0)
+    {
+      NS_FATAL_ERROR ("A channel between two partitions has no delay: no lookahead");
+    }
+  NS_LOG_LOGIC (m_partitions.size () << " partitions, lookahead " << m_lookAhead);
+}
+
+uint64_t
+MultithreadedSimulatorImpl::NextUid (LogicalProcess *lp)
+{
+  if (lp->curK == 0)
+    {
+      if (lp == &m_global)
+        {
+          // setup or a global event: every event before it is numbered
+          lp->curG = m_nextG++;
+        }
+      else
+        {
+          lp->curG = m_gBase + lp->log.size ();
+          LogEntry e = { lp->currentTs, lp->currentUid };
+          lp->log.push_back (e);
+        }
+    }
+  if (lp->curK > UID_K_MASK)
+    {
+      NS_FATAL_ERROR ("An event inserted more than " << UID_K_MASK + 1 << " events");
+    }
+  return (lp->curG << UID_K_BITS) | lp->curK++;
+}
+
+uint64_t
+MultithreadedSimulatorImpl::FinalUid (const LogicalProcess *lp, uint64_t uid) const
+{
+  uint64_t g = uid >> UID_K_BITS;
+  if (g < m_gBase)
+    {
+      return uid;
+    }
+  // inserted by an event of lp in the window
+  return (lp->finalG[g - m_gBase] << UID_K_BITS) | (uid & UID_K_MASK);
+}
+
+void
+MultithreadedSimulatorImpl::Post (LogicalProcess *lp, LogicalProcess *dst, Scheduler::Event &ev)
+{
+  ev.key.m_uid = NextUid (lp);
+  if (lp == &m_global)
+    {
+      // setup or global event: the partitions are not running
+      Insert (dst, ev);
+      return;
+    }
+  if (dst == &m_global)
+    {
+      NS_FATAL_ERROR ("An event without context can not be scheduled from partition " << lp->id);
+    }
+  if (ev.key.m_ts < lp->windowEnd)
+    {
+      if (dst != lp)
+        {
+          NS_FATAL_ERROR ("Event for node " << ev.key.m_context << " scheduled at " << ev.key.m_ts
+                          << " from partition " << lp->id << ", within the lookahead window ending at "
+                          << lp->windowEnd);
+        }
+      // runs in this window: only compared with the events of lp
+      Insert (lp, ev);
+      return;
+    }
+  lp->out[dst->id].push_back (ev);
+}
+
+void
+MultithreadedSimulatorImpl::Insert (LogicalProcess *lp, Scheduler::Event &ev)
+{
+  lp->unscheduledEvents++;
+  lp->events->Insert (ev);
+}
+
+void
+MultithreadedSimulatorImpl::ProcessOneEvent (LogicalProcess *lp)
+{
+  Scheduler::Event next = lp->events->RemoveNext ();
+
+  NS_ASSERT (next.key.m_ts >= lp->currentTs);
+  lp->unscheduledEvents--;
+  lp->eventCount++;
+
+  NS_LOG_LOGIC ("handle " << next.key.m_ts);
+  lp->currentTs = next.key.m_ts;
+  lp->currentContext = next.key.m_context;
+  lp->currentUid = next.key.m_uid;
+  lp->currentEvent = next.impl;
+  lp->curK = 0;
+  next.impl->Invoke ();
+  // its EventId may hold a provisional uid: mark it expired
+  next.impl->Cancel ();
+  lp->currentEvent = 0;
+  next.impl->Unref ();
+}
+
+void
+MultithreadedSimulatorImpl::ProcessWindow (LogicalProcess *lp)
+{
+  Scheduler::EventKey end = m_end;
+  lp->windowEnd = end.m_ts;
+  lp->log.clear ();
+  while (!lp->stop && !lp->events->IsEmpty () && lp->events->PeekNext ().key < end)
+    {
+      ProcessOneEvent (lp);
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Merge (void)
+{
+  NS_LOG_FUNCTION (this);
+  // give the events of the window that inserted events their G, in the
+  // order of the sequential run: by timestamp, then by final uid
+  uint32_t count = m_partitions.size ();
+  std::vector<uint32_t> pos (count, 0);
+  for (uint32_t i = 0; i < count; i++)
+    {
+      m_partitions[i]->finalG.resize (m_partitions[i]->log.size ());
+    }
+  while (true)
+    {
+      uint32_t best = count;
+      Scheduler::EventKey bestKey;
+      for (uint32_t i = 0; i < count; i++)
+        {
+          LogicalProcess *lp = m_partitions[i];
+          if (pos[i] == lp->log.size ())
+            {
+              continue;
+            }
+          Scheduler::EventKey key;
+          key.m_ts = lp->log[pos[i]].ts;
+          // an event of lp in the window comes before it: already numbered
+          key.m_uid = FinalUid (lp, lp->log[pos[i]].uid);
+          key.m_context = 0;
+          if (best == count || key < bestKey)
+            {
+              best = i;
+              bestKey = key;
+            }
+        }
+      if (best == count)
+        {
+          break;
+        }
+      m_partitions[best]->finalG[pos[best]++] = m_nextG++;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::DrainMailboxes (LogicalProcess *lp)
+{
+  for (std::vector<LogicalProcess *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      Mailbox &box = (*i)->out[lp->id];
+      for (Mailbox::iterator j = box.begin (); j != box.end (); ++j)
+        {
+          j->key.m_uid = FinalUid (*i, j->key.m_uid);
+          Insert (lp, *j);
+        }
+      box.clear ();
+    }
+}
+
+bool
+MultithreadedSimulatorImpl::NextPartitionKey (Scheduler::EventKey &key) const
+{
+  bool any = false;
+  for (std::vector<LogicalProcess *>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      if (!(*i)->events->IsEmpty () && (!any || (*i)->events->PeekNext ().key < key))
+        {
+          key = (*i)->events->PeekNext ().key;
+          any = true;
+        }
+    }
+  return any;
+}
+
+void
+MultithreadedSimulatorImpl::Coordinate (void)
+{
+  NS_LOG_FUNCTION (this);
+  // the partitions are parked: run the global events due before any
+  // partition event, then bound the next window
+  void *saved = g_current;
+  g_current = 0;
+  Scheduler::EventKey next;
+  bool any = NextPartitionKey (next);
+  while (!m_stop && !m_global.events->IsEmpty ()
+         && (!any || m_global.events->PeekNext ().key < next))
+    {
+      ProcessOneEvent (&m_global);
+      // it may have scheduled into any partition
+      any = NextPartitionKey (next);
+    }
+  g_current = saved;
+  if (m_nextG >> (64 - UID_K_BITS))
+    {
+      NS_FATAL_ERROR ("More than 2^" << 64 - UID_K_BITS << " events inserted events: out of uids");
+    }
+
+  bool stop = m_stop;
+  for (std::vector<LogicalProcess *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      stop = stop || (*i)->stop;
+    }
+  if (stop || !any)
+    {
+      m_done = true;
+      return;
+    }
+  m_gBase = m_nextG;
+  m_end.m_ts = next.m_ts + std::min (m_lookAhead, NO_EVENT - next.m_ts);
+  m_end.m_uid = 0;
+  if (!m_global.events->IsEmpty () && m_global.events->PeekNext ().key < m_end)
+    {
+      // the window ends at the global event: the partition events before
+      // it, with the same timestamp included, run first
+      m_end = m_global.events->PeekNext ().key;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::RunThread (LogicalProcess *lp)
+{
+  lp->impl->RunPartition (lp);
+}
+
+void
+MultithreadedSimulatorImpl::RunPartition (LogicalProcess *lp)
+{
+  NS_LOG_FUNCTION (this << lp->id);
+  g_current = lp;
+  while (true)
+    {
+      ProcessWindow (lp);
+      // every partition is done with the window
+      m_barrier.Wait ();
+      if (lp->id == 0)
+        {
+          Merge ();
+        }
+      m_barrier.Wait ();
+      DrainMailboxes (lp);
+      m_barrier.Wait ();
+      if (lp->id == 0)
+        {
+          Coordinate ();
+        }
+      m_barrier.Wait ();
+      if (m_done)
+        {
+          break;
+        }
+    }
+  g_current = 0;
+}
+
+void
+MultithreadedSimulatorImpl::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (g_current == 0);
+  CalculateLookAhead ();
+  uint32_t count = m_partitions.size ();
+  for (std::vector<LogicalProcess *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      (*i)->out.assign (count, Mailbox ());
+      (*i)->stop = false;
+    }
+  m_barrier.Init (count);
+  m_stop = false;
+  m_done = false;
+
+  // the global events before the first partition event
+  Coordinate ();
+  std::vector<Ptr<SystemThread> > threads;
+  for (uint32_t i = 1; i < count && !m_done; i++)
+    {
+      threads.push_back (Create<SystemThread> (MakeBoundCallback (&MultithreadedSimulatorImpl::RunThread, m_partitions[i])));
+      threads.back ()->Start ();
+    }
+  // the calling thread runs the first partition and the global events
+  if (!m_done)
+    {
+      RunPartition (m_partitions[0]);
+    }
+  for (std::vector<Ptr<SystemThread> >::iterator i = threads.begin (); i != threads.end (); ++i)
+    {
+      (*i)->Join ();
+    }
+
+  // from now on the clock seen by the caller is the latest one
+  for (std::vector<LogicalProcess *>::iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      m_global.currentTs = std::max (m_global.currentTs, (*i)->currentTs);
+    }
+  // what is scheduled from now on comes after the run
+  m_global.curK = 0;
+}
+
+Time
+MultithreadedSimulatorImpl::Now (void) const
+{
+  return TimeStep (GetCurrent ()->currentTs);
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetSystemId (void) const
+{
+  LogicalProcess *lp = GetCurrent ();
+  return lp == &m_global ? 0 : lp->id;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetContext (void) const
+{
+  return GetCurrent ()->currentContext;
+}
+
+bool
+MultithreadedSimulatorImpl::IsFinished (void) const
+{
+  // a partition only knows about itself and the global events
+  LogicalProcess *lp = GetCurrent ();
+  bool empty = m_global.events->IsEmpty () && lp->events->IsEmpty ();
+  if (lp == &m_global)
+    {
+      for (std::vector<LogicalProcess *>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+        {
+          empty = empty && (*i)->events->IsEmpty ();
+        }
+    }
+  return empty || m_stop || lp->stop;
+}
+
+void
+MultithreadedSimulatorImpl::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  LogicalProcess *lp = GetCurrent ();
+  if (lp == &m_global)
+    {
+      m_stop = true;
+    }
+  else
+    {
+      // this partition stops at once, the others at the end of the window
+      lp->stop = true;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Stop (Time const &time)
+{
+  Simulator::Schedule (time, &Simulator::Stop);
+}
+
+EventId
+MultithreadedSimulatorImpl::Schedule (Time const &time, EventImpl *event)
+{
+  LogicalProcess *lp = GetCurrent ();
+  Time tAbsolute = time + TimeStep (lp->currentTs);
+
+  NS_ASSERT (tAbsolute.IsPositive ());
+  NS_ASSERT (tAbsolute >= TimeStep (lp->currentTs));
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_ts = static_cast<uint64_t> (tAbsolute.GetTimeStep ());
+  ev.key.m_context = lp->currentContext;
+  Post (lp, lp, ev);
+  return EventId (event, ev.key.m_ts, ev.key.m_context, ev.key.m_uid);
+}
+
+void
+MultithreadedSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &time, EventImpl *event)
+{
+  NS_LOG_FUNCTION (this << context << time.GetTimeStep () << event);
+
+  LogicalProcess *lp = GetCurrent ();
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_ts = lp->currentTs + time.GetTimeStep ();
+  ev.key.m_context = context;
+  Post (lp, GetContextOwner (context), ev);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  LogicalProcess *lp = GetCurrent ();
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_ts = lp->currentTs;
+  ev.key.m_context = lp->currentContext;
+  Post (lp, lp, ev);
+  return EventId (event, ev.key.m_ts, ev.key.m_context, ev.key.m_uid);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  CriticalSection cs (m_destroyMutex);
+  EventId id (Ptr<EventImpl> (event, false), GetCurrent ()->currentTs, 0xffffffff, 2);
+  m_destroyEvents.push_back (id);
+  return id;
+}
+
+Time
+MultithreadedSimulatorImpl::GetDelayLeft (const EventId &id) const
+{
+  if (IsExpired (id))
+    {
+      return TimeStep (0);
+    }
+  else
+    {
+      return TimeStep (id.GetTs () - GetCurrent ()->currentTs);
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Remove (const EventId &id)
+{
+  if (id.GetUid () == 2)
+    {
+      CriticalSection cs (m_destroyMutex);
+      // destroy events.
+      for (DestroyEvents::iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              m_destroyEvents.erase (i);
+              break;
+            }
+        }
+      return;
+    }
+  // the event may still wait in a mailbox, or be queued with another uid
+  // than the one of id: it is dropped when its time comes
+  Cancel (id);
+}
+
+void
+MultithreadedSimulatorImpl::Cancel (const EventId &id)
+{
+  if (!IsExpired (id))
+    {
+      id.PeekEventImpl ()->Cancel ();
+    }
+}
+
+bool
+MultithreadedSimulatorImpl::IsExpired (const EventId &ev) const
+{
+  if (ev.GetUid () == 2)
+    {
+      if (ev.PeekEventImpl () == 0
+          || ev.PeekEventImpl ()->IsCancelled ())
+        {
+          return true;
+        }
+      CriticalSection cs (m_destroyMutex);
+      // destroy events.
+      for (DestroyEvents::const_iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == ev)
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  if (ev.PeekEventImpl () == 0)
+    {
+      return true;
+    }
+  // executed events are cancelled (see ProcessOneEvent)
+  LogicalProcess *lp = const_cast<MultithreadedSimulatorImpl *> (this)->GetContextOwner (ev.GetContext ());
+  return ev.PeekEventImpl ()->IsCancelled () || ev.PeekEventImpl () == lp->currentEvent;
+}
+
+Time
+MultithreadedSimulatorImpl::GetMaximumSimulationTime (void) const
+{
+  // XXX: I am fairly certain other compilers use other non-standard
+  // post-fixes to indicate 64 bit constants.
+  return TimeStep (0x7fffffffffffffffLL);
+}
+
+uint64_t
+MultithreadedSimulatorImpl::GetEventCount (void) const
+{
+  // exact from a global event or after Run (): the partitions are parked
+  uint64_t count = m_global.eventCount;
+  for (std::vector<LogicalProcess *>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      count += (*i)->eventCount;
+    }
+  return count;
+}
+
+uint64_t
+MultithreadedSimulatorImpl::GetPendingEventCount (void) const
+{
+  int64_t count = m_global.unscheduledEvents;
+  for (std::vector<LogicalProcess *>::const_iterator i = m_partitions.begin (); i != m_partitions.end (); ++i)
+    {
+      count += (*i)->unscheduledEvents;
+    }
+  return count;
+}
+
+} // namespace ns3
@@ -0,0 +1,209 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MULTITHREADED_SIMULATOR_IMPL_H
+#define MULTITHREADED_SIMULATOR_IMPL_H
+
+#include "ns3/simulator-impl.h"
+#include "ns3/scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/object-factory.h"
+#include "ns3/system-mutex.h"
+#include "ns3/ptr.h"
+
+#include <list>
+#include <vector>
+#include <atomic>
+
+namespace ns3 {
+
+/**
+ * \ingroup mpi
+ *
+ * \brief shared-memory parallel simulator implementation using lookahead
+ *
+ * The single-process counterpart of DistributedSimulatorImpl: every
+ * partition (the nodes sharing a system id, see Node::GetSystemId) is a
+ * logical process with its own event queue, run by its own thread.
+ *
+ * The partitions advance in windows. A window ends at the smallest
+ * timestamp pending anywhere plus the lookahead, the smallest delay of a
+ * channel between two partitions, so that nothing a partition receives
+ * can fall inside the window it is processing. An event scheduled with
+ * the context (node id) of another partition is posted into the
+ * single-producer single-consumer mailbox of that pair of partitions and
+ * inserted by the receiver after the window: no lock is taken on the
+ * event path.
+ *
+ * Events without a context (scheduled before Run () or by such events:
+ * monitors, flow arrivals, Simulator::Stop (Time)...) form a global
+ * queue. A global event runs alone between two windows, once the
+ * partition events before it have run, and may touch any node.
+ *
+ * Every event runs in the order of the sequential run (DefaultSimulatorImpl),
+ * whatever the thread scheduling. Events with the same timestamp run in the
+ * order they were inserted in: a uid is (G, k) for the k-th event inserted
+ * by the G-th event, in the order of the run, that inserted any. Within a
+ * window a partition only knows its own order, so G is provisional: the
+ * events it inserts for after the window, for itself or for the others,
+ * wait in the mailboxes until Merge () has numbered the events of all the
+ * partitions in that window. Simulator::Remove () only cancels the event.
+ *
+ * Simulator::Stop () called by a partition event stops that partition at
+ * once but the others at the end of the window: they may run events the
+ * sequential run would not. Simulator::Stop (Time) from the setup is a
+ * global event and stops every partition at the same point.
+ *
+ * Objects owned by a partition must only be touched by that partition:
+ * reference counts are not atomic, and packets crossing partitions must
+ * be deep copies (see QbbRemoteChannel).
+ */
+class MultithreadedSimulatorImpl : public SimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  MultithreadedSimulatorImpl ();
+  ~MultithreadedSimulatorImpl ();
+
+  // virtual from SimulatorImpl
+  virtual void Destroy ();
+  virtual bool IsFinished (void) const;
+  virtual void Stop (void);
+  virtual void Stop (Time const &time);
+  virtual EventId Schedule (Time const &time, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, Time const &time, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+  virtual void Remove (const EventId &ev);
+  virtual void Cancel (const EventId &ev);
+  virtual bool IsExpired (const EventId &ev) const;
+  virtual void Run (void);
+  virtual Time Now (void) const;
+  virtual Time GetDelayLeft (const EventId &id) const;
+  virtual Time GetMaximumSimulationTime (void) const;
+  virtual void SetScheduler (ObjectFactory schedulerFactory);
+  /**
+   * \return the partition running the calling thread, 0 outside of the
+   * partitions (setup, global events)
+   */
+  virtual uint32_t GetSystemId (void) const;
+  virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+  virtual uint64_t GetPendingEventCount (void) const;
+
+  /**
+   * \return the number of partitions, i.e. of threads used by Run ()
+   */
+  uint32_t GetPartitionCount (void) const;
+
+private:
+  typedef std::vector<Scheduler::Event> Mailbox;
+
+  // an event of a window that inserted events, numbered by Merge ()
+  struct LogEntry
+  {
+    uint64_t ts;
+    uint64_t uid;
+  };
+
+  // the event queue and clock of a partition, or of the global events
+  struct LogicalProcess
+  {
+    MultithreadedSimulatorImpl *impl;
+    uint32_t id;
+    Ptr<Scheduler> events;
+    uint64_t currentUid;
+    uint64_t currentTs;
+    uint32_t currentContext;
+    // the running event, expired from now on (see IsExpired)
+    EventImpl *currentEvent;
+    // G and the number of events inserted by the running event
+    uint64_t curG;
+    uint64_t curK;
+    // inserted but not yet executed events, for validation
+    int unscheduledEvents;
+    uint64_t eventCount;
+    // timestamp of the end of the window being processed
+    uint64_t windowEnd;
+    // Simulator::Stop () called by an event of this partition
+    bool stop;
+    // out[dst]: the events inserted for dst, this partition included, at or
+    // after the end of the window; drained by dst after Merge ()
+    std::vector<Mailbox> out;
+    // the events of the window that inserted events, in execution order,
+    // and their final G
+    std::vector<LogEntry> log;
+    std::vector<uint64_t> finalG;
+  };
+
+  // a sense-reversing barrier: spins, then yields the cpu
+  class Barrier
+  {
+public:
+    Barrier ();
+    void Init (uint32_t count);
+    void Wait (void);
+private:
+    uint32_t m_count;
+    std::atomic<uint32_t> m_waiting;
+    std::atomic<uint32_t> m_sense;
+  };
+
+  virtual void DoDispose (void);
+  static void RunThread (LogicalProcess *lp);
+  void RunPartition (LogicalProcess *lp);
+  void CalculateLookAhead (void);
+  LogicalProcess *GetPartition (uint32_t id);
+  LogicalProcess *GetContextOwner (uint32_t context);
+  LogicalProcess *GetCurrent (void) const;
+  uint64_t NextUid (LogicalProcess *lp);
+  uint64_t FinalUid (const LogicalProcess *lp, uint64_t uid) const;
+  void Post (LogicalProcess *lp, LogicalProcess *dst, Scheduler::Event &ev);
+  void Insert (LogicalProcess *lp, Scheduler::Event &ev);
+  void ProcessOneEvent (LogicalProcess *lp);
+  void ProcessWindow (LogicalProcess *lp);
+  void Merge (void);
+  void DrainMailboxes (LogicalProcess *lp);
+  bool NextPartitionKey (Scheduler::EventKey &key) const;
+  void Coordinate (void);
+
+  typedef std::list<EventId> DestroyEvents;
+
+  DestroyEvents m_destroyEvents;
+  mutable SystemMutex m_destroyMutex;
+  ObjectFactory m_schedulerFactory;
+  LogicalProcess m_global;
+  std::vector<LogicalProcess *> m_partitions;
+  // partition of each node id
+  std::vector<uint32_t> m_nodePartition;
+  uint64_t m_lookAhead;
+  // Simulator::Stop () called by a global event
+  bool m_stop;
+  // set by Coordinate () when the run is over
+  bool m_done;
+  Barrier m_barrier;
+  // the partitions run the events before m_end in the window
+  Scheduler::EventKey m_end;
+  // the next G to give, and the first one of the window: the provisional
+  // G of a partition are m_gBase plus the index in its log
+  uint64_t m_nextG;
+  uint64_t m_gBase;
+};
+
+} // namespace ns3
+
+#endif /* MULTITHREADED_SIMULATOR_IMPL_H */
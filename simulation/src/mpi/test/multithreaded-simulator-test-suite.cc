@@ -0,0 +1,287 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/default-simulator-impl.h"
+#include "ns3/multithreaded-simulator-impl.h"
+#include "ns3/node.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/nstime.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * A SimpleChannel with a Delay attribute: the lookahead between the
+ * partitions it joins (see MultithreadedSimulatorImpl::CalculateLookAhead).
+ */
+class LookaheadChannel : public SimpleChannel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LookaheadChannel")
+      .SetParent<SimpleChannel> ()
+      .AddConstructor<LookaheadChannel> ()
+      .AddAttribute ("Delay", "Transmission delay through the channel",
+                     TimeValue (MicroSeconds (10)),
+                     MakeTimeAccessor (&LookaheadChannel::m_delay),
+                     MakeTimeChecker ())
+    ;
+    return tid;
+  }
+private:
+  Time m_delay;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LookaheadChannel);
+
+// node i in partition i, all joined by one channel of 10us
+static void
+BuildTopology (uint32_t n)
+{
+  Ptr<LookaheadChannel> channel = CreateObject<LookaheadChannel> ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Ptr<Node> node = CreateObject<Node> (i);
+      Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+      node->AddDevice (device);
+      device->SetChannel (channel);
+    }
+}
+
+/**
+ * Every event of a small n-partition topology must run at the same time and
+ * in the same order on each node as with DefaultSimulatorImpl. The events
+ * tie on purpose: a node receives at the end of the lookahead window of the
+ * sender while it runs its own events of the same timestamp, global events
+ * (no context) inject events at the timestamps the partitions are running,
+ * and Simulator::Stop (Time) cuts the run in the middle of a timestamp.
+ */
+class MultithreadedOrderTestCase : public TestCase
+{
+public:
+  MultithreadedOrderTestCase (uint32_t n);
+private:
+  struct Entry
+  {
+    uint64_t ts;
+    uint64_t tag;
+    uint32_t context;
+  };
+  typedef std::vector<Entry> Trace;
+
+  virtual void DoRun (void);
+  void RunOnce (Ptr<SimulatorImpl> impl);
+  void Deliver (uint32_t node, uint64_t tag, uint32_t hops);
+  void Global (uint64_t tag);
+  void Record (Trace &trace, uint64_t tag);
+  void Compare (const Trace &seq, const Trace &mt, std::string what);
+
+  uint32_t m_n;
+  // m_trace[i] is written by the partition of node i only, m_trace[n] by
+  // the global events
+  std::vector<Trace> m_trace;
+  uint64_t m_eventCount;
+  uint64_t m_end;
+  uint32_t m_partitions;
+};
+
+MultithreadedOrderTestCase::MultithreadedOrderTestCase (uint32_t n)
+  : TestCase ("Check that MultithreadedSimulatorImpl runs the events in the sequential order"),
+    m_n (n)
+{
+}
+
+void
+MultithreadedOrderTestCase::Record (Trace &trace, uint64_t tag)
+{
+  Entry e = { (uint64_t)Simulator::Now ().GetTimeStep (), tag, Simulator::GetContext () };
+  trace.push_back (e);
+}
+
+void
+MultithreadedOrderTestCase::Deliver (uint32_t node, uint64_t tag, uint32_t hops)
+{
+  Record (m_trace[node], tag);
+  if (hops == 0)
+    {
+      return;
+    }
+  // to the next partition right at the end of the window, and to the node
+  // itself at the same time, before it and at once
+  uint32_t next = (node + 1) % m_n;
+  Simulator::ScheduleWithContext (next, MicroSeconds (10), &MultithreadedOrderTestCase::Deliver, this, next, tag * 4, hops - 1);
+  Simulator::Schedule (MicroSeconds (10), &MultithreadedOrderTestCase::Deliver, this, node, tag * 4 + 1, hops - 1);
+  Simulator::Schedule (MicroSeconds (3), &MultithreadedOrderTestCase::Deliver, this, node, tag * 4 + 2, hops - 1);
+  Simulator::ScheduleNow (&MultithreadedOrderTestCase::Deliver, this, node, tag * 4 + 3, hops - 1);
+}
+
+void
+MultithreadedOrderTestCase::Global (uint64_t tag)
+{
+  Record (m_trace[m_n], tag);
+  for (uint32_t i = 0; i < m_n; i++)
+    {
+      Simulator::ScheduleWithContext (i, Seconds (0), &MultithreadedOrderTestCase::Deliver, this, i, tag * 16 + i, 2);
+    }
+  if (tag < 5)
+    {
+      Simulator::Schedule (MicroSeconds (10), &MultithreadedOrderTestCase::Global, this, tag + 1);
+    }
+}
+
+void
+MultithreadedOrderTestCase::RunOnce (Ptr<SimulatorImpl> impl)
+{
+  Simulator::Destroy ();
+  Simulator::SetImplementation (impl);
+  BuildTopology (m_n);
+  m_trace.assign (m_n + 1, Trace ());
+
+  for (uint32_t i = 0; i < m_n; i++)
+    {
+      Simulator::ScheduleWithContext (i, Seconds (0), &MultithreadedOrderTestCase::Deliver, this, i, 1000 + i, 4);
+      Simulator::ScheduleWithContext (i, MicroSeconds (5), &MultithreadedOrderTestCase::Deliver, this, i, 2000 + i, 4);
+    }
+  // global events at the timestamps of the partitions
+  Simulator::Schedule (MicroSeconds (10), &MultithreadedOrderTestCase::Global, this, 1);
+  Simulator::Schedule (MicroSeconds (13), &MultithreadedOrderTestCase::Global, this, 100);
+  // after some of the events of 45us
+  Simulator::Stop (MicroSeconds (45));
+  Simulator::Run ();
+  m_eventCount = Simulator::GetEventCount ();
+  m_end = Simulator::Now ().GetTimeStep ();
+  Ptr<MultithreadedSimulatorImpl> mt = DynamicCast<MultithreadedSimulatorImpl> (impl);
+  m_partitions = mt == 0 ? 1 : mt->GetPartitionCount ();
+  Simulator::Destroy ();
+}
+
+void
+MultithreadedOrderTestCase::Compare (const Trace &seq, const Trace &mt, std::string what)
+{
+  NS_TEST_ASSERT_MSG_EQ (mt.size (), seq.size (), "Not the same number of events on " << what);
+  for (uint32_t i = 0; i < seq.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (mt[i].ts, seq[i].ts, "Event " << i << " of " << what << " at another time");
+      NS_TEST_ASSERT_MSG_EQ (mt[i].tag, seq[i].tag, "Event " << i << " of " << what << " out of order");
+      NS_TEST_ASSERT_MSG_EQ (mt[i].context, seq[i].context, "Event " << i << " of " << what << " in another context");
+    }
+}
+
+void
+MultithreadedOrderTestCase::DoRun (void)
+{
+  RunOnce (CreateObject<DefaultSimulatorImpl> ());
+  std::vector<Trace> seq = m_trace;
+  uint64_t seqEventCount = m_eventCount;
+  uint64_t seqEnd = m_end;
+  NS_TEST_ASSERT_MSG_EQ (seq[m_n].size (), 5, "The global events did not all run");
+  NS_TEST_ASSERT_MSG_EQ (seqEnd, (uint64_t)MicroSeconds (45).GetTimeStep (), "The run did not stop at the stop time");
+
+  RunOnce (CreateObject<MultithreadedSimulatorImpl> ());
+  NS_TEST_ASSERT_MSG_EQ (m_partitions, m_n, "One partition per node expected");
+  for (uint32_t i = 0; i < m_n; i++)
+    {
+      std::ostringstream oss;
+      oss << "node " << i;
+      Compare (seq[i], m_trace[i], oss.str ());
+    }
+  Compare (seq[m_n], m_trace[m_n], "the global events");
+  NS_TEST_ASSERT_MSG_EQ (m_eventCount, seqEventCount, "Not the same number of executed events");
+  NS_TEST_ASSERT_MSG_EQ (m_end, seqEnd, "Not the same time at the end of the run");
+}
+
+/**
+ * An event for another partition scheduled inside the lookahead window is
+ * a fatal error. The run is forked: NS_FATAL_ERROR aborts the process.
+ */
+class MultithreadedLookaheadTestCase : public TestCase
+{
+public:
+  MultithreadedLookaheadTestCase ();
+private:
+  virtual void DoRun (void);
+  static void Send (void);
+  static void Receive (void) {}
+  static int RunChild (Time delay);
+};
+
+MultithreadedLookaheadTestCase::MultithreadedLookaheadTestCase ()
+  : TestCase ("Check that MultithreadedSimulatorImpl rejects an event for another partition within the lookahead")
+{
+}
+
+static Time g_sendDelay;
+
+void
+MultithreadedLookaheadTestCase::Send (void)
+{
+  Simulator::ScheduleWithContext (1, g_sendDelay, &MultithreadedLookaheadTestCase::Receive);
+}
+
+int
+MultithreadedLookaheadTestCase::RunChild (Time delay)
+{
+  Simulator::Destroy ();
+  pid_t pid = fork ();
+  if (pid == 0)
+    {
+      int null = open ("/dev/null", O_WRONLY);
+      dup2 (null, 2);
+      Simulator::SetImplementation (CreateObject<MultithreadedSimulatorImpl> ());
+      BuildTopology (2);
+      g_sendDelay = delay;
+      Simulator::ScheduleWithContext (0, MicroSeconds (1), &MultithreadedLookaheadTestCase::Send);
+      Simulator::Run ();
+      Simulator::Destroy ();
+      _exit (0);
+    }
+  int status = 0;
+  waitpid (pid, &status, 0);
+  return status;
+}
+
+void
+MultithreadedLookaheadTestCase::DoRun (void)
+{
+  int status = RunChild (MicroSeconds (10));
+  NS_TEST_ASSERT_MSG_EQ (WIFEXITED (status) && WEXITSTATUS (status) == 0, true, "A send at the lookahead must be accepted");
+  status = RunChild (MicroSeconds (1));
+  NS_TEST_ASSERT_MSG_EQ (WIFSIGNALED (status) && WTERMSIG (status) == SIGABRT, true, "A send within the lookahead must abort");
+}
+
+class MultithreadedSimulatorTestSuite : public TestSuite
+{
+public:
+  MultithreadedSimulatorTestSuite ()
+    : TestSuite ("multithreaded-simulator")
+  {
+    AddTestCase (new MultithreadedOrderTestCase (2));
+    AddTestCase (new MultithreadedOrderTestCase (3));
+    AddTestCase (new MultithreadedLookaheadTestCase ());
+  }
+} g_multithreadedSimulatorTestSuite;
+
+} // namespace ns3
@@ -46,7 +46,7 @@ static struct Zeroes
 namespace ns3 {
 
 
-uint32_t Buffer::g_recommendedStart = 0;
+thread_local uint32_t Buffer::g_recommendedStart = 0;
 #ifdef BUFFER_FREE_LIST
 /* The following macros are pretty evil but they are needed to allow us to
  * keep track of 3 possible states for the g_freeList variable:
@@ -64,6 +64,7 @@ uint32_t Buffer::g_recommendedStart = 0;
  * which the compiler assigns to zero-memory which is initialized to _zero_
  * before the constructors run so this ensures perfect handling of crazy 
  * constructor orderings.
+ * Each thread has its own free list, destroyed when the thread exits.
  */
 #define MAGIC_DESTROYED (~(long) 0)
 #define IS_UNINITIALIZED(x) (x == (Buffer::FreeList*)0)
@@ -71,9 +72,9 @@ uint32_t Buffer::g_recommendedStart = 0;
 #define IS_INITIALIZED(x) (!IS_UNINITIALIZED (x) && !IS_DESTROYED (x))
 #define DESTROYED ((Buffer::FreeList*)MAGIC_DESTROYED)
 #define UNINITIALIZED ((Buffer::FreeList*)0)
-uint32_t Buffer::g_maxSize = 0;
-Buffer::FreeList *Buffer::g_freeList = 0;
-struct Buffer::LocalStaticDestructor Buffer::g_localStaticDestructor;
+thread_local uint32_t Buffer::g_maxSize = 0;
+thread_local Buffer::FreeList *Buffer::g_freeList = 0;
+thread_local struct Buffer::LocalStaticDestructor Buffer::g_localStaticDestructor;
 
 Buffer::LocalStaticDestructor::~LocalStaticDestructor(void)
 {
@@ -89,11 +90,23 @@ Buffer::LocalStaticDestructor::~LocalStaticDestructor(void)
     }
 }
 
+void
+Buffer::CreateFreeList (void)
+{
+  g_freeList = new Buffer::FreeList ();
+  // registers the destructor of the free list of this thread
+  (void)&g_localStaticDestructor;
+}
+
 void
 Buffer::Recycle (struct Buffer::Data *data)
 {
   NS_ASSERT (data->m_count == 0);
-  NS_ASSERT (!IS_UNINITIALIZED (g_freeList));
+  if (IS_UNINITIALIZED (g_freeList))
+    {
+      // the buffer was created by another thread
+      CreateFreeList ();
+    }
   g_maxSize = std::max (g_maxSize, data->m_size);
   /* feed into free list */
   if (data->m_size < g_maxSize ||
@@ -115,7 +128,7 @@ Buffer::Create (uint32_t dataSize)
   /* try to find a buffer correctly sized. */
   if (IS_UNINITIALIZED (g_freeList))
     {
-      g_freeList = new Buffer::FreeList ();
+      CreateFreeList ();
     }
   else if (IS_INITIALIZED (g_freeList))
     {
@@ -25,7 +25,7 @@
 #include <ostream>
 #include "ns3/assert.h"
 
-#define noBUFFER_FREE_LIST 1
+#define BUFFER_FREE_LIST 1
 
 namespace ns3 {
 
@@ -596,7 +596,7 @@ private:
    * writing data. i.e., m_start should be initialized to this 
    * value.
    */
-  static uint32_t g_recommendedStart;
+  static thread_local uint32_t g_recommendedStart;
 
   /* offset to the start of the virtual zero area from the start 
    * of m_data->m_data
@@ -621,9 +621,12 @@ private:
   {
     ~LocalStaticDestructor ();
   };
-  static uint32_t g_maxSize;
-  static FreeList *g_freeList;
-  static struct LocalStaticDestructor g_localStaticDestructor;
+  // per thread: the partitions of MultithreadedSimulatorImpl allocate
+  // and free buffers concurrently
+  static thread_local uint32_t g_maxSize;
+  static thread_local FreeList *g_freeList;
+  static thread_local struct LocalStaticDestructor g_localStaticDestructor;
+  static void CreateFreeList (void);
 #endif
 };
 
@@ -30,8 +30,8 @@ namespace ns3 {
 
 #ifdef USE_FREE_LIST
 
-struct PacketTagList::TagData *PacketTagList::g_free = 0;
-uint32_t PacketTagList::g_nfree = 0;
+thread_local struct PacketTagList::TagData *PacketTagList::g_free = 0;
+thread_local uint32_t PacketTagList::g_nfree = 0;
 
 struct PacketTagList::TagData *
 PacketTagList::AllocData (void) const
@@ -64,8 +64,9 @@ private:
   struct PacketTagList::TagData *AllocData (void) const;
   void FreeData (struct TagData *data) const;
 
-  static struct PacketTagList::TagData *g_free;
-  static uint32_t g_nfree;
+  // per thread, like the other packet free lists
+  static thread_local struct PacketTagList::TagData *g_free;
+  static thread_local uint32_t g_nfree;
 
   struct TagData *m_next;
 };
@@ -28,7 +28,57 @@ NS_LOG_COMPONENT_DEFINE ("Packet");
 
 namespace ns3 {
 
-uint32_t Packet::m_globalUid = 0;
+thread_local uint32_t Packet::m_globalUid = 0;
+
+/* same states as Buffer::g_freeList: 0 = not created yet, 1 = already destroyed,
+ * one list per thread */
+#define PACKET_FREE_LIST_DESTROYED ((Packet::FreeList*)1)
+#define PACKET_FREE_LIST_MAX 1000
+thread_local Packet::FreeList *Packet::g_freeList = 0;
+thread_local struct Packet::LocalStaticDestructor Packet::g_localStaticDestructor;
+
+Packet::LocalStaticDestructor::~LocalStaticDestructor (void)
+{
+  if (g_freeList != 0 && g_freeList != PACKET_FREE_LIST_DESTROYED)
+    {
+      for (FreeList::iterator i = g_freeList->begin (); i != g_freeList->end (); i++)
+        {
+          ::operator delete (*i);
+        }
+      delete g_freeList;
+    }
+  g_freeList = PACKET_FREE_LIST_DESTROYED;
+}
+
+void *
+Packet::operator new (size_t size)
+{
+  if (size == sizeof (Packet) && g_freeList != 0 && g_freeList != PACKET_FREE_LIST_DESTROYED
+      && !g_freeList->empty ())
+    {
+      void *p = g_freeList->back ();
+      g_freeList->pop_back ();
+      return p;
+    }
+  return ::operator new (size);
+}
+
+void
+Packet::operator delete (void *p, size_t size)
+{
+  if (g_freeList == 0)
+    {
+      g_freeList = new FreeList ();
+      (void)&g_localStaticDestructor;
+    }
+  if (size != sizeof (Packet) || g_freeList == PACKET_FREE_LIST_DESTROYED
+      || g_freeList->size () >= PACKET_FREE_LIST_MAX)
+    {
+      ::operator delete (p);
+      return;
+    }
+  g_freeList->push_back (p);
+}
 
 TypeId 
 ByteTagIterator::Item::GetTypeId (void) const
@@ -138,6 +188,8 @@ Packet::Packet ()
     m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, 0),
     m_nixVector (0)
 {
+  m_traceFlowId = 0;
+  m_hdrDesc.valid = 0;
   m_globalUid++;
 }
 
@@ -147,6 +199,8 @@ Packet::Packet (const Packet &o)
     m_packetTagList (o.m_packetTagList),
     m_metadata (o.m_metadata)
 {
+  m_traceFlowId = o.m_traceFlowId;
+  m_hdrDesc = o.m_hdrDesc;
   o.m_nixVector ? m_nixVector = o.m_nixVector->Copy ()
     : m_nixVector = 0;
 }
@@ -162,6 +216,8 @@ Packet::operator = (const Packet &o)
   m_byteTagList = o.m_byteTagList;
   m_packetTagList = o.m_packetTagList;
   m_metadata = o.m_metadata;
+  m_traceFlowId = o.m_traceFlowId;
+  m_hdrDesc = o.m_hdrDesc;
   o.m_nixVector ? m_nixVector = o.m_nixVector->Copy () 
     : m_nixVector = 0;
   return *this;
@@ -180,6 +236,8 @@ Packet::Packet (uint32_t size)
     m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, size),
     m_nixVector (0)
 {
+  m_traceFlowId = 0;
+  m_hdrDesc.valid = 0;
   m_globalUid++;
 }
 Packet::Packet (uint8_t const *buffer, uint32_t size, bool magic)
@@ -189,6 +247,8 @@ Packet::Packet (uint8_t const *buffer, uint32_t size, bool magic)
     m_metadata (0,0),
     m_nixVector (0)
 {
+  m_traceFlowId = 0;
+  m_hdrDesc.valid = 0;
   NS_ASSERT (magic);
   Deserialize (buffer, size);
 }
@@ -206,6 +266,8 @@ Packet::Packet (uint8_t const*buffer, uint32_t size)
     m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, size),
     m_nixVector (0)
 {
+  m_traceFlowId = 0;
+  m_hdrDesc.valid = 0;
   m_globalUid++;
   m_buffer.AddAtStart (size);
   Buffer::Iterator i = m_buffer.Begin ();
@@ -220,6 +282,8 @@ Packet::Packet (const Buffer &buffer,  const ByteTagList &byteTagList,
     m_metadata (metadata),
     m_nixVector (0)
 {
+  m_traceFlowId = 0;
+  m_hdrDesc.valid = 0;
 }
 
 Ptr<Packet>
@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <vector>
 #include "buffer.h"
 #include "header.h"
 #include "trailer.h"
@@ -205,6 +206,19 @@ private:
  * The performance aspects of the Packet API are discussed in 
  * \ref packetperf
  */
+
+// [new] 已解析的包头描述: RdmaHw创建包时填写一次, 交换机逐跳复用, 避免重复解析包头
+// 这些字段在传输过程中不变 (ECN和INT直接在buffer中原地修改)
+struct PacketHeaderDesc {
+  uint32_t sip, dip;
+  uint32_t seq;
+  uint16_t sport, dport;
+  uint16_t pg;
+  uint16_t intOffset; // INT header在buffer中的偏移, 0表示没有INT
+  uint8_t l3Prot;
+  uint8_t valid;
+};
+
 class Packet : public SimpleRefCount<Packet>
 {
 public:
@@ -584,6 +598,19 @@ public:
       return m_traceFlowId;
   }
 
+  // [new] Packet对象池: 释放的Packet放入空闲链表复用, 仿照Buffer的free list
+  static void *operator new (size_t size);
+  static void operator delete (void *p, size_t size);
+
+  // [new] 设置/获取已解析的包头描述, 没有则返回0
+  void SetHeaderDesc(const PacketHeaderDesc &desc) {
+      m_hdrDesc = desc;
+      m_hdrDesc.valid = 1;
+  }
+  const PacketHeaderDesc* GetHeaderDesc() const {
+      return m_hdrDesc.valid ? &m_hdrDesc : 0;
+  }
+
 
 private:
   Packet (const Buffer &buffer, const ByteTagList &byteTagList, 
@@ -592,6 +619,7 @@ private:
   uint32_t Deserialize (uint8_t const*buffer, uint32_t size);
 
   uint32_t m_traceFlowId;  // [new]存储trace flow ID
+  PacketHeaderDesc m_hdrDesc; // [new]已解析的包头描述
 
   Buffer m_buffer;
   ByteTagList m_byteTagList;
@@ -601,7 +629,17 @@ private:
   /* Please see comments above about nix-vector */
   Ptr<NixVector> m_nixVector;
 
-  static uint32_t m_globalUid;
+  // per thread, combined with the system id in the packet uid: each
+  // partition of MultithreadedSimulatorImpl runs its own thread
+  static thread_local uint32_t m_globalUid;
+
+  typedef std::vector<void *> FreeList;
+  struct LocalStaticDestructor
+  {
+    ~LocalStaticDestructor ();
+  };
+  static thread_local FreeList *g_freeList;
+  static thread_local struct LocalStaticDestructor g_localStaticDestructor;
 };
 
 std::ostream& operator<< (std::ostream& os, const Packet &packet);
@@ -324,6 +324,30 @@ CustomHeader::Deserialize (Buffer::Iterator start)
   return l2Size + l3Size + l4Size;
 }
 
+void CustomHeader::FromHeaderDesc (const PacketHeaderDesc &desc){
+	l3Prot = desc.l3Prot;
+	sip = desc.sip;
+	dip = desc.dip;
+	if (l3Prot == 0x11){
+		udp.sport = desc.sport;
+		udp.dport = desc.dport;
+		udp.pg = desc.pg;
+		udp.seq = desc.seq;
+	}else if (l3Prot == 0xFC || l3Prot == 0xFD){
+		ack.sport = desc.sport;
+		ack.dport = desc.dport;
+		ack.pg = desc.pg;
+		ack.seq = desc.seq;
+	}
+}
+
+void CustomHeader::SetIpv4EcnInBuffer (uint8_t *buf, uint8_t ecn){
+	buf[1] = (buf[1] & 0xFC) | (ecn & 0x3); // TOS
+	// 与原先Remove/AddHeader(Ipv4Header)的结果一致: 未启用校验和, 校验和字段为0
+	buf[10] = 0;
+	buf[11] = 0;
+}
+
 uint8_t CustomHeader::GetIpv4EcnBits (void) const{
 	return m_tos & 0x3;
 }
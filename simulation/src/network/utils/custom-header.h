@@ -22,6 +22,7 @@
 #define CUSTOM_HEADER_H
 
 #include "ns3/header.h"
+#include "ns3/packet.h"
 #include "ns3/int-header.h"
 
 namespace ns3 {
@@ -133,6 +134,11 @@ public:
 	  } pfc;
   };
 
+  // [new] 从已解析的包头描述中填写 5元组/pg/seq, 不读buffer (不含INT和ECN)
+  void FromHeaderDesc (const PacketHeaderDesc &desc);
+  // [new] 直接修改buffer中IPv4头的ECN位, buf指向IPv4头
+  static void SetIpv4EcnInBuffer (uint8_t *buf, uint8_t ecn);
+
   uint8_t GetIpv4EcnBits (void) const;
   static uint32_t GetAckSerializedSize(void);
   static uint32_t GetUdpHeaderSize(void); // include udp, seqTs, INT
@@ -6,16 +6,15 @@ const uint64_t IntHop::lineRateValues[8] = {25000000000lu,40000000000lu,50000000
 uint32_t IntHop::multi = 1;
 
 IntHeader::Mode IntHeader::mode = NONE;
+uint32_t IntHeader::maxHop = 5;
 int IntHeader::pint_bytes = 2;
 
 IntHeader::IntHeader() : nhop(0) {
-	for (uint32_t i = 0; i < maxHop; i++)
-		hop[i] = {0};
 }
 
 uint32_t IntHeader::GetStaticSize(){
 	if (mode == NORMAL){
-		return sizeof(hop) + sizeof(nhop);
+		return maxHop * sizeof(IntHop) + sizeof(nhop);
 	}else if (mode == TS){
 		return sizeof(ts);
 	}else if (mode == PINT){
@@ -34,14 +33,31 @@ void IntHeader::PushHop(uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t r
 	}
 }
 
+void IntHeader::PushHopInBuffer(uint8_t *buf, uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate){
+	// only do this in INT mode
+	if (mode == NORMAL){
+		uint16_t n;
+		IntHop h;
+		memcpy(&n, buf, sizeof(n));
+		h.Set(time, bytes, qlen, rate);
+		memcpy(buf + sizeof(n) + (n % maxHop) * sizeof(IntHop), h.buf, sizeof(IntHop));
+		n++;
+		memcpy(buf, &n, sizeof(n));
+	}
+}
+
 void IntHeader::Serialize (Buffer::Iterator start) const{
 	Buffer::Iterator i = start;
 	if (mode == NORMAL){
-		for (uint32_t j = 0; j < maxHop; j++){
+		// 只写入有效的hop，剩余槽位填0
+		uint32_t n = nhop < maxHop ? nhop : maxHop;
+		i.WriteU16(nhop);
+		for (uint32_t j = 0; j < n; j++){
 			i.WriteU32(hop[j].buf[0]);
 			i.WriteU32(hop[j].buf[1]);
 		}
-		i.WriteU16(nhop);
+		if (n < maxHop)
+			i.WriteU8(0, (maxHop - n) * sizeof(IntHop));
 	}else if (mode == TS){
 		i.WriteU64(ts);
 	}else if (mode == PINT){
@@ -55,11 +71,13 @@ void IntHeader::Serialize (Buffer::Iterator start) const{
 uint32_t IntHeader::Deserialize (Buffer::Iterator start){
 	Buffer::Iterator i = start;
 	if (mode == NORMAL){
-		for (uint32_t j = 0; j < maxHop; j++){
+		// 只读取有效的hop
+		nhop = i.ReadU16();
+		uint32_t n = nhop < maxHop ? nhop : maxHop;
+		for (uint32_t j = 0; j < n; j++){
 			hop[j].buf[0] = i.ReadU32();
 			hop[j].buf[1] = i.ReadU32();
 		}
-		nhop = i.ReadU16();
 	}else if (mode == TS){
 		ts = i.ReadU64();
 	}else if (mode == PINT){
@@ -4,6 +4,7 @@
 #include "ns3/buffer.h"
 #include <stdint.h>
 #include <cstdio>
+#include <cstring>
 
 namespace ns3 {
 
@@ -81,7 +82,8 @@ public:
 
 class IntHeader{
 public:
-	static const uint32_t maxHop = 64; // 默认是5
+	static const uint32_t maxHopLimit = 32; // 内存中hop数组的上限
+	static uint32_t maxHop; // 运行时hop容量，由拓扑直径决定（默认是5），不能超过maxHopLimit
 	enum Mode{
 		NORMAL = 0,
 		TS = 1,
@@ -91,10 +93,15 @@ public:
 	static Mode mode;
 	static int pint_bytes;
 
-	// Note: the structure of IntHeader must have no internal padding, because we will directly transform the part of packet buffer to IntHeader*
+	// Wire format (NORMAL): nhop (2B) followed by maxHop slots of IntHop (8B each), only the first nhop slots are meaningful.
+	// The slots are fixed rather than only nhop entries: switches write their hop in place at offset 2 + nhop*8
+	// (PushHopInBuffer), which needs the header size to stay the same along the path. A header growing by one
+	// entry per hop would have to be removed and re-added at every switch.
+	// PINT mode still directly transforms the packet buffer to IntHeader* (power is at offset 0);
+	// NORMAL mode uses PushHopInBuffer() to update the packet buffer in place.
 	union{
 		struct {
-			IntHop hop[maxHop];
+			IntHop hop[maxHopLimit];
 			uint16_t nhop;
 		};
 		uint64_t ts;
@@ -109,6 +116,7 @@ public:
 	IntHeader();
 	static uint32_t GetStaticSize();
 	void PushHop(uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate);
+	static void PushHopInBuffer(uint8_t *buf, uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate); // buf points to the serialized IntHeader
 	void Serialize (Buffer::Iterator start) const;
 	uint32_t Deserialize (Buffer::Iterator start);
 	uint64_t GetTs(void);
@@ -265,6 +265,11 @@ QbbHelper::Install (Ptr<Node> a, Ptr<Node> b)
           useNormalChannel = false;
         }
     }
+  else if (a->GetSystemId () != b->GetSystemId ())
+    {
+      // partitions run by the threads of MultithreadedSimulatorImpl
+      useNormalChannel = false;
+    }
   if (useNormalChannel)
     {
       channel = m_channelFactory.Create<QbbChannel> ();
@@ -272,6 +277,9 @@ QbbHelper::Install (Ptr<Node> a, Ptr<Node> b)
   else
     {
       channel = m_remoteChannelFactory.Create<QbbRemoteChannel> ();
+    }
+  if (!useNormalChannel && MpiInterface::IsEnabled ())
+    {
       Ptr<MpiReceiver> mpiRecA = CreateObject<MpiReceiver> ();
       Ptr<MpiReceiver> mpiRecB = CreateObject<MpiReceiver> ();
       mpiRecA->SetReceiveCallback (MakeCallback (&QbbNetDevice::Receive, devA));
@@ -6,6 +6,7 @@
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/log.h"
 #include "dci-switch-node.h"
 #include "qbb-net-device.h"
 #include "ppp-header.h"
@@ -16,6 +17,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+
+NS_LOG_COMPONENT_DEFINE("DCISwitchNode");
+
 namespace ns3 {
 
 TypeId DCISwitchNode::GetTypeId (void)
@@ -55,15 +59,15 @@ TypeId DCISwitchNode::GetTypeId (void)
 		MakeUintegerChecker<uint32_t>())
     .AddAttribute ("W_dl", "Weight for delay in static cost calculation.",
                    UintegerValue (3),
-                   MakeUintegerAccessor (&DCISwitchNode::m_w_dl),
+                   MakeUintegerAccessor (&DCISwitchNode::SetWdl, &DCISwitchNode::GetWdl),
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("W_bw", "Weight for bandwidth in static cost calculation.",
                    UintegerValue (1),
-                   MakeUintegerAccessor (&DCISwitchNode::m_w_bw),
+                   MakeUintegerAccessor (&DCISwitchNode::SetWbw, &DCISwitchNode::GetWbw),
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("S_static", "Shift factor for static cost normalization.",
                    UintegerValue (2),
-                   MakeUintegerAccessor (&DCISwitchNode::m_S_static),
+                   MakeUintegerAccessor (&DCISwitchNode::SetSstatic, &DCISwitchNode::GetSstatic),
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("W_ql", "Weight for queue length in congestion cost calculation.",
                    UintegerValue (2),
@@ -93,24 +97,29 @@ TypeId DCISwitchNode::GetTypeId (void)
                    UintegerValue (2),
                    MakeUintegerAccessor (&DCISwitchNode::m_S_total),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CongSampleInterval", "Interval of the periodic congestion sampler (RoutingMode 2).",
+                   TimeValue (MicroSeconds (100)),
+                   MakeTimeAccessor (&DCISwitchNode::m_congSampleInterval),
+                   MakeTimeChecker ())
   ;
   return tid;
 }
 
 DCISwitchNode::DCISwitchNode(){
+	InitSwitch();
+}
+
+DCISwitchNode::DCISwitchNode(uint32_t systemId) : Node(systemId){
+	InitSwitch();
+}
+
+void DCISwitchNode::InitSwitch(){
 	m_ecmpSeed = m_id;
+	m_rng.SetStream(m_id, NodeRng::SWITCH);
 	m_node_type = 2; // 2 for DCI Switch
 	m_mmu = CreateObject<SwitchMmu>(); // 创建交换机MMU
-	for (uint32_t i = 0; i < pCnt; i++)
-		for (uint32_t j = 0; j < pCnt; j++)
-			for (uint32_t k = 0; k < qCnt; k++)
-				m_bytes[i][j][k] = 0;
-	for (uint32_t i = 0; i < pCnt; i++)
-		m_txBytes[i] = 0;
-	for (uint32_t i = 0; i < pCnt; i++)
-		m_lastPktSize[i] = m_lastPktTs[i] = 0;
-	for (uint32_t i = 0; i < pCnt; i++)
-		m_u[i] = 0;
+	m_mmu->m_rng.SetStream(m_id, NodeRng::MMU);
+	m_nDev = 0;
 
 	// [NEW] 带宽分段阈值与分数初始化（示例 N=10, MAX_BW=800Gbps）
     for (int i = 0; i < kClassNum; ++i) {
@@ -169,11 +178,16 @@ int DCISwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader &ch){
 
 	// === 启动开销函数的构建 ===
 	if (m_routingMode == 2) { // 0: ECMP, 1: UCMP, 2: Ours
-		CleanIdleFlows(); // 清理超时流
+		CleanIdleFlows(); // 增量清理超时流
+
+		// 拥塞采样器空闲时停止，收到新包时立即采样一次并重新启动
+		if (!m_congSampleEvent.IsRunning())
+			PeriodicMonitorCongestionState();
+		m_rxSinceSample = true;
 
-		auto it = flow2outdev.find(flowId);
-		// 仅在流的第一个包时调用，进行成本计算
-		if (it == flow2outdev.end()) {
+		FlowEntry *it = flow2outdev.Find(flowId);
+		// 仅在流的第一个包（或流已闲置超时）时调用，进行成本计算
+		if (it == NULL || Simulator::Now() - it->lastSeen > IDLE_TIMEOUT) {
 			uint32_t best_intf = nexthops[0];
 			uint32_t min_cost = UINT32_MAX;
 
@@ -185,26 +199,13 @@ int DCISwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader &ch){
 
 		// 第一步：计算所有路径的拥塞成本
 		for (auto intf_idx : nexthops) {
-			// 1 计算静态成本
-			uint16_t delay_ms = static_cast<uint16_t>(m_linkDelay[intf_idx] / 1e6);
-            uint8_t delay_score = CalcDelayCost(delay_ms); // 计算时延成本
-			// std::cout << "DelayCost: " <<  delay_score<< std::endl;
-            uint8_t bw_score = CalcBwCost(m_linkBw[intf_idx]); // 计算链路容量成本
-			// std::cout << "BWcost:"  << bw_score << std::endl;
-            uint32_t staticScore = m_w_dl * delay_score + m_w_bw * bw_score;
-			// std::cout << "StaticCost: " << staticScore << std::endl;
-            uint8_t C_static = std::min(staticScore >> m_S_static, 255u);
-
-
-			// 2 计算拥塞成本
-			MonitorCongestionState(); // 先更新当前队列拥塞状态
-
-			uint8_t QLevel = CalcQLevel(intf_idx);
-			UpdateDurationPenalty(intf_idx, QLevel); // 更新拥塞持续性计数器
-			uint8_t DurationPenalty = CalcDurationPenalty(intf_idx);
-			uint8_t TrendLevel = CalcTrendLevel(intf_idx, m_linkBw[intf_idx]);
-
-			uint32_t congScore = m_w_ql * QLevel + m_w_tl * TrendLevel + m_w_dp * DurationPenalty;
+			// 1 静态成本（链路接入或权重变化时已预计算）
+            uint8_t C_static = m_staticCost[intf_idx];
+
+
+			// 2 计算拥塞成本（直接读取周期采样的结果）
+			const PortCongLevel &lv = m_congLevel[intf_idx];
+			uint32_t congScore = m_w_ql * lv.QLevel + m_w_tl * lv.TrendLevel + m_w_dp * lv.DurationPenalty;
 			uint8_t C_cong = std::min(congScore >> m_S_cong, 255u);
 
 			// 3 三个元素加权求和
@@ -259,22 +260,23 @@ int DCISwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader &ch){
 		}
 
 			// 记录流与输出端口的映射关系
-			flow2outdev[flowId].outDevIdx = selected_intf; // 或你的端口选择逻辑
-			flow2outdev[flowId].lastSeen = Simulator::Now();
+			it = flow2outdev.Insert(flowId);
+			it->outDevIdx = selected_intf; // 或你的端口选择逻辑
+			it->lastSeen = Simulator::Now();
 
 			return selected_intf;
 		} else { // 后续包, 更新lastSeen
 			// 刷新 last_seen 时间戳，并返回之前选择的端口
-			it->second.lastSeen =  Simulator::Now();
+			it->lastSeen =  Simulator::Now();
 
-            return it->second.outDevIdx;
+            return it->outDevIdx;
 		}
 	}
 
 	else if ( m_routingMode == 1) { // 0: ECMP, 1: UCMP, 2: Ours
-		auto it = flow2outdev.find(flowId);
+		FlowEntry *it = flow2outdev.Find(flowId);
 		// 如果是流的第一个包，则进行选路计算
-		if (it == flow2outdev.end()) {
+		if (it == NULL) {
 			std::vector<std::pair<uint64_t, int>> bw_path_pairs;
 			uint64_t max_bw = 0;
 
@@ -321,12 +323,14 @@ int DCISwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader &ch){
 			}
 
 			// 为此流记录路由决策
-			flow2outdev[flowId] = {selected_intf, Simulator::Now()};
+			it = flow2outdev.Insert(flowId);
+			it->outDevIdx = selected_intf;
+			it->lastSeen = Simulator::Now();
 
 			return selected_intf;
 		} else { // 对于流的后续包
 			// 返回之前选择的端口
-			return it->second.outDevIdx;
+			return it->outDevIdx;
 		}
 
 	}
@@ -351,6 +355,19 @@ int DCISwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader &ch){
 	return nexthops[idx];
 }
 
+void DCISwitchNode::InitPorts(){
+	uint32_t n = GetNDevices();
+	SwitchMmu::QueueCounter zero = {};
+	m_nDev = n;
+	m_bytes.assign(n * n, zero);
+	m_txBytes.assign(n, 0);
+	m_lastPktSize.assign(n, 0);
+	m_lastPktTs.assign(n, 0);
+	m_u.assign(n, 0);
+	m_pintCalc.assign(n, PintPortCalc());
+	m_mmu->InitPorts(n);
+}
+
 void DCISwitchNode::CheckAndSendPfc(uint32_t inDev, uint32_t qIndex){
 	Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(m_devices[inDev]);
 	if (m_mmu->CheckShouldPause(inDev, qIndex)){
@@ -392,7 +409,7 @@ void DCISwitchNode::SendToDev(Ptr<Packet>p, CustomHeader &ch){
 			}
 			CheckAndSendPfc(inDev, qIndex);
 		}
-		m_bytes[inDev][idx][qIndex] += p->GetSize();
+		m_bytes[inDev * m_nDev + idx][qIndex] += p->GetSize();
 		m_devices[idx]->SwitchSend(qIndex, p, ch);
 
 		if(m_routingMode == 2) { // 0: ECMP, 1: UCMP, 2: Ours
@@ -478,6 +495,14 @@ void DCISwitchNode::AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx){
 	m_rtTable[dip].push_back(intf_idx);
 }
 
+void DCISwitchNode::SetTableEntry(Ipv4Address &dstAddr, const std::vector<int> &intf_idx){
+	uint32_t dip = dstAddr.Get();
+	if (intf_idx.empty())
+		m_rtTable.erase(dip);
+	else
+		m_rtTable[dip] = intf_idx;
+}
+
 void DCISwitchNode::ClearTable(){
 	m_rtTable.clear();
 }
@@ -495,29 +520,23 @@ void DCISwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<P
 		uint32_t inDev = t.GetFlowId();
 		m_mmu->RemoveFromIngressAdmission(inDev, qIndex, p->GetSize());
 		m_mmu->RemoveFromEgressAdmission(ifIndex, qIndex, p->GetSize());
-		m_bytes[inDev][ifIndex][qIndex] -= p->GetSize();
+		m_bytes[inDev * m_nDev + ifIndex][qIndex] -= p->GetSize();
 		if (m_ecnEnabled){
 			bool egressCongested = m_mmu->ShouldSendCN(ifIndex, qIndex);
-			if (egressCongested){
-				PppHeader ppp;
-				Ipv4Header h;
-				p->RemoveHeader(ppp);
-				p->RemoveHeader(h);
-				h.SetEcn((Ipv4Header::EcnType)0x03);
-				p->AddHeader(h);
-				p->AddHeader(ppp);
-			}
+			if (egressCongested) // 原地标记ECN CE
+				CustomHeader::SetIpv4EcnInBuffer(p->GetBuffer() + PppHeader::GetStaticSize(), 0x03);
 		}
 		//CheckAndSendPfc(inDev, qIndex);
 		CheckAndSendResume(inDev, qIndex);
 	}
 	if (1){
 		uint8_t* buf = p->GetBuffer();
-		if (buf[PppHeader::GetStaticSize() + 9] == 0x11){ // udp packet
-			IntHeader *ih = (IntHeader*)&buf[PppHeader::GetStaticSize() + 20 + 8 + 6]; // ppp, ip, udp, SeqTs, INT
+		const PacketHeaderDesc *desc = p->GetHeaderDesc();
+		if (desc != 0 ? desc->intOffset != 0 : buf[PppHeader::GetStaticSize() + 9] == 0x11){ // udp packet
+			IntHeader *ih = (IntHeader*)&buf[desc != 0 ? desc->intOffset : PppHeader::GetStaticSize() + 20 + 8 + 6]; // ppp, ip, udp, SeqTs, INT
 			Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[ifIndex]);
 			if (m_ccMode == 3){ // HPCC
-				ih->PushHop(Simulator::Now().GetTimeStep(), m_txBytes[ifIndex], dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
+				IntHeader::PushHopInBuffer((uint8_t*)ih, Simulator::Now().GetTimeStep(), m_txBytes[ifIndex], dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
 				// printf("[TEST]dci-switch-node.cc: current queueBytes: %u\n", dev->GetQueue()->GetNBytesTotal());
 
 			}else if (m_ccMode == 10){ // HPCC-PINT
@@ -532,43 +551,8 @@ void DCISwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<P
 				/**************************
 				 * approximate calc
 				 *************************/
-				int b = 20, m = 16, l = 20; // see log2apprx's paremeters
-				int sft = logres_shift(b,l);
-				double fct = 1<<sft; // (multiplication factor corresponding to sft)
-				double log_T = log2(m_maxRtt)*fct; // log2(T)*fct
-				double log_B = log2(B)*fct; // log2(B)*fct
-				double log_1e9 = log2(1e9)*fct; // log2(1e9)*fct
-				double qterm = 0;
-				double byteTerm = 0;
-				double uTerm = 0;
-				if ((qlen >> 8) > 0){
-					int log_dt = log2apprx(dt, b, m, l); // ~log2(dt)*fct
-					int log_qlen = log2apprx(qlen >> 8, b, m, l); // ~log2(qlen / 256)*fct
-					qterm = pow(2, (
-								log_dt + log_qlen + log_1e9 - log_B - 2*log_T
-								)/fct
-							) * 256;
-					// 2^((log2(dt)*fct+log2(qlen/256)*fct+log2(1e9)*fct-log2(B)*fct-2*log2(T)*fct)/fct)*256 ~= dt*qlen*1e9/(B*T^2)
-				}
-				if (m_lastPktSize[ifIndex] > 0){
-					int byte = m_lastPktSize[ifIndex];
-					int log_byte = log2apprx(byte, b, m, l);
-					byteTerm = pow(2, (
-								log_byte + log_1e9 - log_B - log_T
-								)/fct
-							);
-					// 2^((log2(byte)*fct+log2(1e9)*fct-log2(B)*fct-log2(T)*fct)/fct) ~= byte*1e9 / (B*T)
-				}
-				if (m_maxRtt > dt && m_u[ifIndex] > 0){
-					int log_T_dt = log2apprx(m_maxRtt - dt, b, m, l); // ~log2(T-dt)*fct
-					int log_u = log2apprx(int(round(m_u[ifIndex] * 8192)), b, m, l); // ~log2(u*512)*fct
-					uTerm = pow(2, (
-								log_T_dt + log_u - log_T
-								)/fct
-							) / 8192;
-					// 2^((log2(T-dt)*fct+log2(u*512)*fct-log2(T)*fct)/fct)/512 = (T-dt)*u/T
-				}
-				newU = qterm+byteTerm+uTerm;
+				// the log2apprx()/pow() form, with the logs of T and B cached per port
+				newU = m_pintCalc[ifIndex].Update(m_maxRtt, B, dt, qlen, m_lastPktSize[ifIndex], m_u[ifIndex], m_rng);
 
 				#if 0
 				/**************************
@@ -589,7 +573,7 @@ void DCISwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<P
 				/************************
 				 * update PINT header
 				 ***********************/
-				uint16_t power = Pint::encode_u(newU);
+				uint16_t power = Pint::encode_u(newU, m_rng.GetNext16());
 				if (power > ih->GetPower())
 					ih->SetPower(power);
 
@@ -616,7 +600,7 @@ int DCISwitchNode::log2apprx(int x, int b, int m, int l){
 		x += + (1 << (msb - m - 1));
 		#else
 		int mask = (1 << (msb-m)) - 1;
-		if ((x0 & mask) > (rand() & mask))
+		if ((x0 & mask) > (int)(m_rng.GetNext32() & mask))
 			x += 1<<(msb-m);
 		#endif
 	}
@@ -652,6 +636,55 @@ uint8_t DCISwitchNode::CalcBwCost(uint64_t bw_bps)
     return 255; // 低于最低阈值
 }
 
+void DCISwitchNode::SetLinkInfo(uint32_t port, uint64_t delay_ns, uint64_t bw_bps)
+{
+	if (m_linkDelay.size() <= port) {
+		m_linkDelay.resize(port + 1, 0);
+		m_linkBw.resize(port + 1, 0);
+		m_staticCost.resize(port + 1, 255);
+	}
+	m_linkDelay[port] = delay_ns;
+	m_linkBw[port] = bw_bps;
+	UpdateStaticCost(port);
+}
+
+void DCISwitchNode::UpdateStaticCost(uint32_t port)
+{
+	uint16_t delay_ms = static_cast<uint16_t>(m_linkDelay[port] / 1e6);
+	uint8_t delay_score = CalcDelayCost(delay_ms); // 计算时延成本
+	uint8_t bw_score = CalcBwCost(m_linkBw[port]); // 计算链路容量成本
+	uint32_t staticScore = m_w_dl * delay_score + m_w_bw * bw_score;
+	m_staticCost[port] = std::min(staticScore >> m_S_static, 255u);
+}
+
+void DCISwitchNode::UpdateAllStaticCost()
+{
+	for (uint32_t port = 0; port < m_staticCost.size(); port++)
+		UpdateStaticCost(port);
+}
+
+void DCISwitchNode::SetWdl(uint32_t w){
+	m_w_dl = w;
+	UpdateAllStaticCost();
+}
+void DCISwitchNode::SetWbw(uint32_t w){
+	m_w_bw = w;
+	UpdateAllStaticCost();
+}
+void DCISwitchNode::SetSstatic(uint32_t s){
+	m_S_static = s;
+	UpdateAllStaticCost();
+}
+uint32_t DCISwitchNode::GetWdl() const{
+	return m_w_dl;
+}
+uint32_t DCISwitchNode::GetWbw() const{
+	return m_w_bw;
+}
+uint32_t DCISwitchNode::GetSstatic() const{
+	return m_S_static;
+}
+
 // 计算队列级别，输入为端口号
 uint8_t DCISwitchNode::CalcQLevel(uint32_t port) {
     uint32_t bytes = m_congState[port].queueBytes_cur;
@@ -681,10 +714,10 @@ void DCISwitchNode::UpdateTrend(uint32_t port)
 // 计算TrendLevel分数（队列增长趋势）
 uint8_t DCISwitchNode::CalcTrendLevel(uint32_t port, uint64_t link_rate_bps)
 {
-	// 获取上次采样时间
+	// 获取上次采样时间，阈值按实际采样间隔缩放
     Time lastSample = m_congState[port].lastTrendSampleTime;
-	double interval_ms = (Simulator::Now() - lastSample).GetMilliSeconds();
-	if (interval_ms < 1.0) interval_ms = 1.0; // 防止除零
+	double interval_ms = (Simulator::Now() - lastSample).GetSeconds() * 1e3;
+	if (interval_ms <= 0) interval_ms = m_congSampleInterval.GetSeconds() * 1e3; // 防止阈值为0
 
     // 查找速率组对应的标准化阈值表（单位bytes/ms）
 	uint32_t rate_gbps = static_cast<uint32_t>(link_rate_bps / 1000000000ULL);
@@ -713,40 +746,62 @@ uint8_t DCISwitchNode::CalcTrendLevel(uint32_t port, uint64_t link_rate_bps)
 }
 
 
-// 单次采样端口队列长度的调度函数
+// 单次采样端口队列长度，并计算各端口的拥塞等级
 void DCISwitchNode::MonitorCongestionState()
 {
-    for (int port = 1; port < GetNDevices(); port++) {
-        Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(GetDevice(port));
+	if (m_congState.size() < GetNDevices()) {
+		m_congState.resize(GetNDevices());
+		m_congLevel.resize(GetNDevices());
+	}
+    for (uint32_t port = 1; port < GetNDevices(); port++) {
+        Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[port]);
         if (!dev) continue;
         // 获取当前端口所有队列的总字节数
         uint32_t qlen = dev->GetQueue()->GetNBytesTotal();
         m_congState[port].queueBytes_cur = qlen;
-		// 更新采样时间
-		m_congState[port].lastTrendSampleTime = Simulator::Now();
 		// 更新队列增长趋势
         UpdateTrend(port);
+
+		PortCongLevel &lv = m_congLevel[port];
+		lv.QLevel = CalcQLevel(port);
+		UpdateDurationPenalty(port, lv.QLevel); // 更新拥塞持续性计数器
+		lv.DurationPenalty = CalcDurationPenalty(port);
+		lv.TrendLevel = CalcTrendLevel(port, port < m_linkBw.size() ? m_linkBw[port] : 0);
+
+		// 更新采样时间
+		m_congState[port].lastTrendSampleTime = Simulator::Now();
         // 可选：输出调试信息
 		// if (qlen > 0)
 	        // std::cout << "[TEST] MonitorCongestionState: [DCI " << GetId() << "] port " << port << " queueBytes_cur=" << qlen << std::endl;
     }
 }
 
+void DCISwitchNode::PeriodicMonitorCongestionState()
+{
+	MonitorCongestionState();
+
+	// 没有新包且所有队列已排空时停止采样，避免空闲时空转
+	bool idle = !m_rxSinceSample;
+	for (uint32_t port = 1; idle && port < m_congState.size(); port++)
+		if (m_congState[port].queueBytes_cur > 0)
+			idle = false;
+	m_rxSinceSample = false;
+	if (!idle)
+		m_congSampleEvent = Simulator::Schedule(m_congSampleInterval, &DCISwitchNode::PeriodicMonitorCongestionState, this);
+}
+
 // 计算拥塞成本（总合成）
 uint8_t DCISwitchNode::CalcCongCost(uint32_t port, uint64_t link_rate_bps)
 {
-	// 1. 先更新当前队列拥塞状态
-    MonitorCongestionState();
+	// 读取周期采样的拥塞等级
+	if (port >= m_congLevel.size())
+		return 0;
 	
 	// 权重求和
     const int w_q = 4, w_t = 2, w_d = 2, S = 3;
-    uint8_t QLevel = CalcQLevel(port);
-	// 更新拥塞持续性计数器
-	UpdateDurationPenalty(port, QLevel);
-    uint8_t DurationPenalty = CalcDurationPenalty(port);
-
-
-    uint8_t TrendLevel = CalcTrendLevel(port, link_rate_bps);
+    uint8_t QLevel = m_congLevel[port].QLevel;
+    uint8_t DurationPenalty = m_congLevel[port].DurationPenalty;
+    uint8_t TrendLevel = m_congLevel[port].TrendLevel;
 
     uint32_t cong_score = w_q * QLevel + w_t * TrendLevel + w_d * DurationPenalty;
     uint8_t cong_cost = std::min(cong_score >> S, 255u);
@@ -776,26 +831,94 @@ void DCISwitchNode::UpdateDurationPenalty(uint32_t port, uint8_t QLevel)
         m_congState[port].durCounter = m_congState[port].durCounter > 0 ? m_congState[port].durCounter - 1 : 0;
 }
 
-// 定期清理超时流项
+// 增量清理超时流项：时钟指针每次只前进GC_SLOTS_PER_PKT个槽位，均摊O(1)
+// 超时语义由GetOutDev中的惰性判断保证，这里只负责回收表项
 void DCISwitchNode::CleanIdleFlows()
 {
-	Time shortTimeout = MilliSeconds(5 * m_maxRtt / 1000000); // 5×RTT
-
-    for (auto it = flow2outdev.begin(); it != flow2outdev.end(); ) {
-        if (Simulator::Now() - it->second.lastSeen > IDLE_TIMEOUT) {
-        // if (Simulator::Now() - it->second.lastSeen > shortTimeout) {
-			uint64_t flowId = it->first;
-            uint32_t outDevIdx = it->second.outDevIdx;
-
-            std::cout << "[GC] [DCI " << GetId() << "] Remove idle flow " << it->first << std::endl;
-            it = flow2outdev.erase(it);
-        } else {
-            it++;
-        }
-    }
+	Time now = Simulator::Now();
+	for (uint32_t n = 0; n < GC_SLOTS_PER_PKT; n++) {
+		m_gcHand &= flow2outdev.Capacity() - 1; // 扩容后指针回绕
+		FlowEntry &e = flow2outdev.At(m_gcHand);
+		if (e.used && now - e.lastSeen > IDLE_TIMEOUT) {
+			NS_LOG_DEBUG("[GC] [DCI " << GetId() << "] Remove idle flow " << e.flowId);
+			flow2outdev.EraseAt(m_gcHand); // backward-shift后该槽位可能被后继项填充，下次重新检查
+		} else {
+			m_gcHand++;
+		}
+	}
+}
+
+/******************************
+ * FlowTable
+ *****************************/
+DCISwitchNode::FlowTable::FlowTable() : m_slots(1024), m_mask(1023), m_size(0) {
+	for (auto &e : m_slots)
+		e.used = false;
+}
+
+uint32_t DCISwitchNode::FlowTable::Home(uint64_t flowId) const {
+	// Fibonacci hashing
+	return (uint32_t)((flowId * 0x9E3779B97F4A7C15ULL) >> 32) & m_mask;
+}
+
+DCISwitchNode::FlowEntry* DCISwitchNode::FlowTable::Find(uint64_t flowId) {
+	for (uint32_t i = Home(flowId); m_slots[i].used; i = (i + 1) & m_mask)
+		if (m_slots[i].flowId == flowId)
+			return &m_slots[i];
+	return NULL;
+}
+
+DCISwitchNode::FlowEntry* DCISwitchNode::FlowTable::Insert(uint64_t flowId) {
+	FlowEntry *e = Find(flowId);
+	if (e != NULL)
+		return e;
+	if ((m_size + 1) * 2 > m_slots.size()) // 负载因子不超过0.5
+		Grow();
+	uint32_t i = Home(flowId);
+	while (m_slots[i].used)
+		i = (i + 1) & m_mask;
+	m_slots[i].used = true;
+	m_slots[i].flowId = flowId;
+	m_size++;
+	return &m_slots[i];
+}
+
+void DCISwitchNode::FlowTable::EraseAt(uint32_t idx) {
+	// backward-shift删除：把探测链上可以前移的表项搬到空洞处
+	uint32_t i = idx, j = idx;
+	while (true) {
+		j = (j + 1) & m_mask;
+		if (!m_slots[j].used)
+			break;
+		uint32_t k = Home(m_slots[j].flowId);
+		// k不在循环区间(i, j]内时，j处的表项可以搬到i
+		if (((j - k) & m_mask) >= ((j - i) & m_mask)) {
+			m_slots[i] = m_slots[j];
+			i = j;
+		}
+	}
+	m_slots[i].used = false;
+	m_size--;
+}
+
+void DCISwitchNode::FlowTable::Grow() {
+	std::vector<FlowEntry> old;
+	old.swap(m_slots);
+	m_slots.resize(old.size() * 2);
+	for (auto &e : m_slots)
+		e.used = false;
+	m_mask = m_slots.size() - 1;
+	m_size = 0;
+	for (auto &e : old) {
+		if (!e.used)
+			continue;
+		FlowEntry *n = Insert(e.flowId);
+		n->outDevIdx = e.outDevIdx;
+		n->lastSeen = e.lastSeen;
+	}
 }
 uint64_t DCISwitchNode::GetTxBytesOutDev(uint32_t outdev) {
-    NS_ASSERT_MSG(outdev < pCnt, "Invalid output device index");
+    NS_ASSERT_MSG(outdev < m_txBytes.size(), "Invalid output device index");
     return m_txBytes[outdev];
 }
 
@@ -8,6 +8,7 @@
 #include "rdma-queue-pair.h"
 #include "rdma-hw.h"
 #include "pint.h"
+#include "node-rng.h"
 
 namespace ns3 {
 
@@ -17,19 +18,22 @@ class DCISwitchNode : public Node{
 protected:
 	bool saveRoutingChoice = false; // 是否将选择结果输出到本地
 
-	static const uint32_t pCnt = 257;	// Number of ports used
 	static const uint32_t qCnt = 8;	// Number of queues/priorities used
 	uint32_t m_ecmpSeed;
+	NodeRng m_rng; // random rounding of PINT and log2apprx
 	std::unordered_map<uint32_t, std::vector<int> > m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)
 
 	// monitor of PFC
-	uint32_t m_bytes[pCnt][pCnt][qCnt]; // m_bytes[inDev][outDev][qidx] is the bytes from inDev enqueued for outDev at qidx
+	// per-port state is sized to the real device count in InitPorts()
+	uint32_t m_nDev;
+	std::vector<SwitchMmu::QueueCounter> m_bytes; // m_bytes[inDev*m_nDev+outDev][qidx] is the bytes from inDev enqueued for outDev at qidx
 	
-	uint64_t m_txBytes[pCnt]; // counter of tx bytes
+	std::vector<uint64_t> m_txBytes; // counter of tx bytes
 
-	uint32_t m_lastPktSize[pCnt];
-	uint64_t m_lastPktTs[pCnt]; // ns
-	double m_u[pCnt];
+	std::vector<uint32_t> m_lastPktSize;
+	std::vector<uint64_t> m_lastPktTs; // ns
+	std::vector<double> m_u;
+	std::vector<PintPortCalc> m_pintCalc; // approximate calc of m_u
 
 	uint32_t m_mtu; // Maximum Transmission Unit
 
@@ -57,10 +61,35 @@ protected:
 
 	// 流信息的结构
 	struct FlowEntry {
+		uint64_t flowId;    // 流ID (key)
 		uint32_t outDevIdx; // 输出端口索引
+		bool used;          // 槽位是否被占用
 		Time lastSeen;      // 最近一次包到达时间
 	};
-	std::map<uint64_t, FlowEntry> flow2outdev; // flowId -> FlowEntry
+
+	// 开放寻址(线性探测)流表，删除采用backward-shift，无墓碑
+	// 查找/插入/删除均摊O(1)，与流的数量无关
+	class FlowTable {
+	public:
+		FlowTable();
+		FlowEntry* Find(uint64_t flowId);
+		FlowEntry* Insert(uint64_t flowId); // 返回已存在或新建的表项
+		void EraseAt(uint32_t idx);
+		uint32_t Capacity() const { return m_slots.size(); }
+		uint32_t Size() const { return m_size; }
+		FlowEntry& At(uint32_t idx) { return m_slots[idx]; }
+	private:
+		uint32_t Home(uint64_t flowId) const;
+		void Grow();
+		std::vector<FlowEntry> m_slots;
+		uint32_t m_mask;
+		uint32_t m_size;
+	};
+	FlowTable flow2outdev; // flowId -> FlowEntry
+
+	// 惰性老化：查找时判断是否超时；另用时钟指针每包只检查少量槽位回收内存
+	static const uint32_t GC_SLOTS_PER_PKT = 4;
+	uint32_t m_gcHand = 0;
 
 // protected:
 
@@ -76,6 +105,7 @@ private:
 	static uint32_t EcmpHash(const uint8_t* key, size_t len, uint32_t seed);
 	void CheckAndSendPfc(uint32_t inDev, uint32_t qIndex);
 	void CheckAndSendResume(uint32_t inDev, uint32_t qIndex);
+	void InitSwitch(); // shared by the constructors
 
 	// Calculate delay cost based on one-way delay
 	uint8_t CalcDelayCost(uint16_t one_way_delay_ms);
@@ -92,6 +122,16 @@ private:
 	// Update trend information
 	void UpdateTrend(uint32_t port);
 
+	// 重新计算端口的静态成本（链路参数或W_dl/W_bw/S_static变化时调用）
+	void UpdateStaticCost(uint32_t port);
+	void UpdateAllStaticCost();
+	void SetWdl(uint32_t w);
+	void SetWbw(uint32_t w);
+	void SetSstatic(uint32_t s);
+	uint32_t GetWdl() const;
+	uint32_t GetWbw() const;
+	uint32_t GetSstatic() const;
+
 	// 计算持续时间惩罚
 	uint8_t CalcDurationPenalty(uint32_t port);
 	// 更新持续时间惩罚
@@ -114,21 +154,28 @@ public:
 
 	static TypeId GetTypeId (void);
 	DCISwitchNode();
+	DCISwitchNode(uint32_t systemId); // [new] for distributed runs, systemId is the MPI rank owning the switch
+	void InitPorts(); // call after all links are installed, before configuring m_mmu
 	void SetEcmpSeed(uint32_t seed);
 	void AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx);
+	void SetTableEntry(Ipv4Address &dstAddr, const std::vector<int> &intf_idx); // replace the entries of dstAddr, remove them if intf_idx is empty
 	void ClearTable();
 	bool SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> packet, CustomHeader &ch);
 	void SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p);
 
-	// for approximate calc in PINT
+	// for approximate calc in PINT (the reference form of PintPortCalc)
 	int logres_shift(int b, int l);
 	int log2apprx(int x, int b, int m, int l); // given x of at most b bits, use most significant m bits of x, calc the result in l bits
 
 	
 
-	// [NEW] Link characteristics
-	std::map<uint32_t, uint64_t> m_linkDelay;   // key: interface idx, value: delay (ns)
-	std::map<uint32_t, uint64_t> m_linkBw;      // key: interface idx, value: bandwidth (bps)
+	// [NEW] Link characteristics (下标: interface idx)，通过SetLinkInfo设置
+	std::vector<uint64_t> m_linkDelay;   // delay (ns)
+	std::vector<uint64_t> m_linkBw;      // bandwidth (bps)
+	std::vector<uint8_t> m_staticCost;   // 预计算的每端口静态成本C_static
+
+	// 设置端口的链路参数，并重新计算该端口的C_static
+	void SetLinkInfo(uint32_t port, uint64_t delay_ns, uint64_t bw_bps);
 
 	
 
@@ -141,13 +188,26 @@ public:
 		Time lastTrendSampleTime = Seconds(0); // 最近一次趋势采样时间
 	};
 
-	std::map<uint32_t, CongestionState> m_congState; // key: 端口号
+	std::vector<CongestionState> m_congState; // 下标: 端口号
+
+	// 采样器输出的每端口拥塞等级，路径选择时O(1)读取
+	struct PortCongLevel {
+		uint8_t QLevel = 0;
+		uint8_t TrendLevel = 0;
+		uint8_t DurationPenalty = 0;
+	};
+	std::vector<PortCongLevel> m_congLevel; // 下标: 端口号
 
+	Time m_congSampleInterval; // 拥塞采样周期
+	EventId m_congSampleEvent;
+	bool m_rxSinceSample = false; // 上次采样后是否有新包到达
 
-	// 单次采样调度函数
+	// 单次采样：更新所有端口的队列/趋势/持续惩罚，并写入m_congLevel
 	void MonitorCongestionState();
+	// 周期采样调度函数；空闲时（无新包且所有队列为空）停止，收到新包时重新启动
+	void PeriodicMonitorCongestionState();
 
-	// 定期清理超时流项
+	// 增量清理超时流项（每次只扫描GC_SLOTS_PER_PKT个槽位）
 	void CleanIdleFlows();
 
 	// 获取指定输出端口的发送字节数
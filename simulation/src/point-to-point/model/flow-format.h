@@ -0,0 +1,135 @@
+#ifndef FLOW_FORMAT_H
+#define FLOW_FORMAT_H
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ns3{
+
+/*
+ * Binary flow file: a FlowFileHeader followed by flowCount FlowFormat records,
+ * sorted by start time. The records are fixed size and in host byte order, so
+ * a simulation maps the file and reads the flows in place.
+ * utils/flow-convert writes it from the text flow file of traffic_gen:
+ *   <flow count>
+ *   <src> <dst> <pg> <dport> <size> <start time (s)>
+ */
+struct FlowFileHeader{
+	char magic[8]; // FLOW_FILE_MAGIC
+	uint32_t version;
+	uint32_t recordSize; // sizeof(FlowFormat)
+	uint64_t flowCount;
+	uint32_t hostCount; // src and dst are below hostCount
+	uint32_t reserved;
+};
+
+struct FlowFormat{
+	double startTime; // seconds, as in the text file
+	uint64_t size; // bytes
+	uint32_t src, dst; // node ids
+	uint16_t pg, dport;
+	uint32_t reserved;
+};
+
+static const char FLOW_FILE_MAGIC[8] = {'L', 'C', 'M', 'P', 'F', 'L', 'O', 'W'};
+static const uint32_t FLOW_FILE_VERSION = 1;
+
+static inline void InitFlowFileHeader(FlowFileHeader &h, uint64_t flowCount, uint32_t hostCount){
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, FLOW_FILE_MAGIC, sizeof(h.magic));
+	h.version = FLOW_FILE_VERSION;
+	h.recordSize = sizeof(FlowFormat);
+	h.flowCount = flowCount;
+	h.hostCount = hostCount;
+}
+
+// check the header read from a file of fileSize bytes, returns NULL if valid
+static inline const char* CheckFlowFileHeader(const FlowFileHeader &h, uint64_t fileSize){
+	if (fileSize < sizeof(FlowFileHeader) || memcmp(h.magic, FLOW_FILE_MAGIC, sizeof(h.magic)) != 0)
+		return "not a binary flow file";
+	if (h.version != FLOW_FILE_VERSION)
+		return "unsupported binary flow file version";
+	if (h.recordSize != sizeof(FlowFormat))
+		return "unexpected flow record size";
+	if ((fileSize - sizeof(FlowFileHeader)) / sizeof(FlowFormat) < h.flowCount)
+		return "binary flow file is truncated";
+	return NULL;
+}
+
+// true if the file starts with the binary flow file magic
+static inline bool IsFlowFile(const char *name){
+	char magic[sizeof(FLOW_FILE_MAGIC)];
+	FILE *f = fopen(name, "rb");
+	if (f == NULL)
+		return false;
+	bool ret = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, FLOW_FILE_MAGIC, sizeof(magic)) == 0;
+	fclose(f);
+	return ret;
+}
+
+/*
+ * Read-only mapping of a binary flow file.
+ * The records are read in order, so the kernel is told to read ahead.
+ */
+class FlowFileReader{
+public:
+	FlowFileReader() : m_base(NULL), m_len(0), m_header(NULL), m_flows(NULL) {}
+	~FlowFileReader(){ Close(); }
+
+	// returns NULL on success, or the reason of the failure
+	const char* Open(const char *name){
+		Close();
+		int fd = open(name, O_RDONLY);
+		if (fd < 0)
+			return "can not open the file";
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(FlowFileHeader)){
+			close(fd);
+			return "not a binary flow file";
+		}
+		void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED)
+			return "can not map the file";
+		m_base = base;
+		m_len = st.st_size;
+		m_header = (const FlowFileHeader*)base;
+		const char *err = CheckFlowFileHeader(*m_header, m_len);
+		if (err != NULL){
+			Close();
+			return err;
+		}
+		m_flows = (const FlowFormat*)((const char*)base + sizeof(FlowFileHeader));
+		madvise(base, m_len, MADV_SEQUENTIAL);
+		return NULL;
+	}
+	void Close(){
+		if (m_base != NULL)
+			munmap(m_base, m_len);
+		m_base = NULL;
+		m_len = 0;
+		m_header = NULL;
+		m_flows = NULL;
+	}
+	bool IsOpen() const { return m_base != NULL; }
+	const FlowFileHeader& GetHeader() const { return *m_header; }
+	uint64_t GetN() const { return m_header->flowCount; }
+	const FlowFormat& Get(uint64_t i) const { return m_flows[i]; }
+
+private:
+	FlowFileReader(const FlowFileReader &);
+	FlowFileReader& operator=(const FlowFileReader &);
+
+	void *m_base;
+	size_t m_len;
+	const FlowFileHeader *m_header;
+	const FlowFormat *m_flows;
+};
+
+}
+#endif
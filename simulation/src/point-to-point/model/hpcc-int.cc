@@ -0,0 +1,116 @@
+#include <algorithm>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "hpcc-int.h"
+
+namespace ns3{
+
+// bit offsets of the IntHop fields in its 64-bit word
+static const int timeShift = 64 - IntHop::timeWidth - IntHop::bytesWidth - IntHop::qlenWidth;
+static const int bytesShift = timeShift + IntHop::timeWidth;
+static const int qlenShift = bytesShift + IntHop::bytesWidth;
+
+static const double lineRateValuesD[8] = {
+	(double)IntHop::lineRateValues[0], (double)IntHop::lineRateValues[1], (double)IntHop::lineRateValues[2], (double)IntHop::lineRateValues[3],
+	(double)IntHop::lineRateValues[4], (double)IntHop::lineRateValues[5], (double)IntHop::lineRateValues[6], (double)IntHop::lineRateValues[7]
+};
+
+void HpccIntCalc::ComputeUScalar(IntHop *hop, IntHop *last, uint32_t n, uint64_t maxRate, uint32_t win, double *u, uint64_t *tau){
+	for (uint32_t i = 0; i < n; i++){
+		tau[i] = hop[i].GetTimeDelta(last[i]);
+		double duration = tau[i] * 1e-9;
+		double txRate = (hop[i].GetBytesDelta(last[i])) * 8 / duration;
+		u[i] = txRate / hop[i].GetLineRate() + (double)std::min(hop[i].GetQlen(), last[i].GetQlen()) * maxRate / hop[i].GetLineRate() / win;
+	}
+}
+
+#if defined(__SSE4_1__)
+// x < 2^52
+static inline __m128d ToDouble(__m128i x){
+	const __m128d magic = _mm_set1_pd(4503599627370496.0); // 2^52
+	return _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(x, _mm_castpd_si128(magic))), magic);
+}
+
+// hops [0, 2)
+static inline void ComputeU2(IntHop *hop, IntHop *last, __m128d rate, __m128d w, double *u, uint64_t *tau){
+	const __m128i timeMask = _mm_set1_epi64x((1ull << IntHop::timeWidth) - 1);
+	const __m128i bytesMask = _mm_set1_epi64x((1ull << IntHop::bytesWidth) - 1);
+	const __m128i lowMask = _mm_set1_epi64x(0xffffffffull);
+	const __m128i bytesScale = _mm_set1_epi64x((uint32_t)(IntHop::byteUnit * IntHop::multi)); // GetBytesDelta() wraps at 32 bits
+	const __m128i qlenScale = _mm_set1_epi64x((uint32_t)(IntHop::qlenUnit * IntHop::multi)); // so does GetQlen()
+	__m128i h = _mm_loadu_si128((const __m128i*)hop);
+	__m128i l = _mm_loadu_si128((const __m128i*)last);
+	// GetTimeDelta and GetBytesDelta: the difference modulo the field width
+	__m128i t = _mm_and_si128(_mm_sub_epi64(_mm_srli_epi64(h, timeShift), _mm_srli_epi64(l, timeShift)), timeMask);
+	__m128i b = _mm_and_si128(_mm_sub_epi64(_mm_srli_epi64(h, bytesShift), _mm_srli_epi64(l, bytesShift)), bytesMask);
+	b = _mm_and_si128(_mm_mul_epu32(b, bytesScale), lowMask);
+	__m128i qh = _mm_and_si128(_mm_mul_epu32(_mm_srli_epi64(h, qlenShift), qlenScale), lowMask);
+	__m128i ql = _mm_and_si128(_mm_mul_epu32(_mm_srli_epi64(l, qlenShift), qlenScale), lowMask);
+	__m128d q = ToDouble(_mm_min_epu32(qh, ql));
+	__m128i r = _mm_and_si128(h, _mm_set1_epi64x(7));
+	__m128d lineRate = _mm_set_pd(lineRateValuesD[_mm_extract_epi64(r, 1)], lineRateValuesD[_mm_cvtsi128_si64(r)]);
+	__m128d duration = _mm_mul_pd(ToDouble(t), _mm_set1_pd(1e-9));
+	__m128d txRate = _mm_div_pd(_mm_mul_pd(ToDouble(b), _mm_set1_pd(8)), duration);
+	__m128d qTerm = _mm_div_pd(_mm_div_pd(_mm_mul_pd(q, rate), lineRate), w);
+	_mm_storeu_pd(u, _mm_add_pd(_mm_div_pd(txRate, lineRate), qTerm));
+	_mm_storeu_si128((__m128i*)tau, t);
+}
+#endif
+
+#if defined(__AVX2__)
+// x < 2^52
+static inline __m256d ToDouble(__m256i x){
+	const __m256d magic = _mm256_set1_pd(4503599627370496.0); // 2^52
+	return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(x, _mm256_castpd_si256(magic))), magic);
+}
+
+// hops [0, 4), as ComputeU2
+static inline void ComputeU4(IntHop *hop, IntHop *last, __m256d rate, __m256d w, double *u, uint64_t *tau){
+	const __m256i timeMask = _mm256_set1_epi64x((1ull << IntHop::timeWidth) - 1);
+	const __m256i bytesMask = _mm256_set1_epi64x((1ull << IntHop::bytesWidth) - 1);
+	const __m256i lowMask = _mm256_set1_epi64x(0xffffffffull);
+	const __m256i bytesScale = _mm256_set1_epi64x((uint32_t)(IntHop::byteUnit * IntHop::multi));
+	const __m256i qlenScale = _mm256_set1_epi64x((uint32_t)(IntHop::qlenUnit * IntHop::multi));
+	__m256i h = _mm256_loadu_si256((const __m256i*)hop);
+	__m256i l = _mm256_loadu_si256((const __m256i*)last);
+	__m256i t = _mm256_and_si256(_mm256_sub_epi64(_mm256_srli_epi64(h, timeShift), _mm256_srli_epi64(l, timeShift)), timeMask);
+	__m256i b = _mm256_and_si256(_mm256_sub_epi64(_mm256_srli_epi64(h, bytesShift), _mm256_srli_epi64(l, bytesShift)), bytesMask);
+	b = _mm256_and_si256(_mm256_mul_epu32(b, bytesScale), lowMask);
+	__m256i qh = _mm256_and_si256(_mm256_mul_epu32(_mm256_srli_epi64(h, qlenShift), qlenScale), lowMask);
+	__m256i ql = _mm256_and_si256(_mm256_mul_epu32(_mm256_srli_epi64(l, qlenShift), qlenScale), lowMask);
+	__m256d q = ToDouble(_mm256_min_epu32(qh, ql));
+	__m256d lineRate = _mm256_i64gather_pd(lineRateValuesD, _mm256_and_si256(h, _mm256_set1_epi64x(7)), 8);
+	__m256d duration = _mm256_mul_pd(ToDouble(t), _mm256_set1_pd(1e-9));
+	__m256d txRate = _mm256_div_pd(_mm256_mul_pd(ToDouble(b), _mm256_set1_pd(8)), duration);
+	__m256d qTerm = _mm256_div_pd(_mm256_div_pd(_mm256_mul_pd(q, rate), lineRate), w);
+	_mm256_storeu_pd(u, _mm256_add_pd(_mm256_div_pd(txRate, lineRate), qTerm));
+	_mm256_storeu_si256((__m256i*)tau, t);
+}
+#endif
+
+void HpccIntCalc::ComputeU(IntHop *hop, IntHop *last, uint32_t n, uint64_t maxRate, uint32_t win, double *u, uint64_t *tau){
+	uint32_t i = 0;
+	#if defined(__AVX2__)
+	for (; i + 4 <= n; i += 4)
+		ComputeU4(hop + i, last + i, _mm256_set1_pd((double)maxRate), _mm256_set1_pd((double)win), u + i, tau + i);
+	#endif
+	#if defined(__SSE4_1__)
+	for (; i + 2 <= n; i += 2)
+		ComputeU2(hop + i, last + i, _mm_set1_pd((double)maxRate), _mm_set1_pd((double)win), u + i, tau + i);
+	#endif
+	ComputeUScalar(hop + i, last + i, n - i, maxRate, win, u + i, tau + i);
+}
+
+const char* HpccIntCalc::GetKernelName(){
+	#if defined(__AVX2__)
+	return "avx2";
+	#elif defined(__SSE4_1__)
+	return "sse4.1";
+	#else
+	return "scalar";
+	#endif
+}
+
+} /* namespace ns3 */
@@ -0,0 +1,26 @@
+#ifndef HPCC_INT_H
+#define HPCC_INT_H
+
+#include <stdint.h>
+#include "ns3/int-header.h"
+
+namespace ns3{
+
+/*
+ * The per-hop utilization HPCC computes from the INT of an ACK (RdmaHw::UpdateRateHp):
+ *   u[i] = txRate / lineRate + min(qlen, last qlen) * maxRate / lineRate / win
+ * where txRate is the bytes sent by hop i since the INT kept in last[i] over tau[i] ns.
+ * ComputeU decodes the packed IntHop words of 4 hops at once with AVX2 and of 2 with SSE4.1,
+ * when the build enables them (-march=native in the optimized profile), and gives the same
+ * u and tau, bit for bit, as ComputeUScalar.
+ */
+class HpccIntCalc{
+public:
+	static void ComputeU(IntHop *hop, IntHop *last, uint32_t n, uint64_t maxRate, uint32_t win, double *u, uint64_t *tau);
+	static void ComputeUScalar(IntHop *hop, IntHop *last, uint32_t n, uint64_t maxRate, uint32_t win, double *u, uint64_t *tau);
+	static const char* GetKernelName(); // "avx2", "sse4.1" or "scalar"
+};
+
+} /* namespace ns3 */
+
+#endif /* HPCC_INT_H */
@@ -0,0 +1,64 @@
+#ifndef NODE_RNG_H
+#define NODE_RNG_H
+
+#include <stdint.h>
+#include "ns3/rng-seed-manager.h"
+
+namespace ns3{
+
+/*
+ * Counter-based random numbers for the packet path.
+ * The n-th number of a stream is a hash (SplitMix64) of the stream key and n, and the key
+ * is derived from the global seed/run, the node id and the owner of the stream on the node.
+ * So a switch, an MMU, a NIC or a port draws the same numbers whatever the other nodes do
+ * and whatever order the partitions of a parallel run execute in.
+ * Drawing is a multiply-xorshift on two integers: no lock, no object construction.
+ */
+class NodeRng{
+public:
+	// owners of the streams on a node; port i of a node uses DEVICE + i
+	enum Stream{
+		SWITCH = 0,
+		MMU = 1,
+		RDMA_HW = 2,
+		DEVICE = 16
+	};
+
+	NodeRng() : m_key(0), m_ctr(0) {}
+
+	void SetStream(uint32_t node, uint32_t stream){
+		uint64_t seed = ((uint64_t)RngSeedManager::GetSeed() << 32) ^ RngSeedManager::GetRun();
+		m_key = Mix(Mix(seed) ^ (((uint64_t)node << 32) | stream));
+		m_ctr = 0;
+	}
+	uint64_t GetNext64(){
+		return Mix(m_key + ++m_ctr * GOLDEN);
+	}
+	// uniform in [0, 2^32)
+	uint32_t GetNext32(){
+		return GetNext64() >> 32;
+	}
+	// uniform in [0, 65536), as used by PINT
+	uint32_t GetNext16(){
+		return GetNext64() >> 48;
+	}
+	// uniform in [0, 1)
+	double GetDouble(){
+		return (GetNext64() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+private:
+	static const uint64_t GOLDEN = 0x9e3779b97f4a7c15ull;
+	static uint64_t Mix(uint64_t z){
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t m_key;
+	uint64_t m_ctr; // numbers drawn so far
+};
+
+} /* namespace ns3 */
+
+#endif /* NODE_RNG_H */
@@ -1,5 +1,4 @@
 #include <cmath>
-#include <cstdlib>
 #include <cstdio>
 
 #include "pint.h"
@@ -8,10 +7,27 @@ namespace ns3{
 
 double Pint::log_base = 1.05;
 double Pint::log_factor = 1 / log(log_base);
+std::vector<Pint::EncodeEntry> Pint::encode_table = Pint::build_encode_table(); // after log_base and log_factor
 
 void Pint::set_log_base(double base){
 	log_base = base;
 	log_factor = 1 / log(log_base);
+	encode_table = build_encode_table();
+}
+
+std::vector<Pint::EncodeEntry> Pint::build_encode_table(){
+	std::vector<EncodeEntry> t(encode_table_size);
+	for (uint32_t u_toInt = 1; u_toInt < encode_table_size; u_toInt++){
+		double power = log(u_toInt) * log_factor;
+		uint16_t p_upper = ceil(power), p_lower = floor(power);
+		double upper = pow(log_base, p_upper), lower = pow(log_base, p_lower);
+		if (p_upper == p_lower)
+			upper *= log_base;
+		t[u_toInt].thresh = (u_toInt - lower) / (upper - lower) * 65536;
+		t[u_toInt].p_lower = p_lower;
+		t[u_toInt].p_upper = p_upper;
+	}
+	return t;
 }
 
 int Pint::get_n_bits(){
@@ -25,15 +41,19 @@ int Pint::get_n_bytes(){
 	return (n_bits - 1) / 8 + 1;
 }
 
-uint16_t Pint::encode_u(double u){
+uint16_t Pint::encode_u(double u, uint32_t rnd){
 	uint32_t u_toInt = ceil(u * max_concurrent); // convert u to int so that the minimum possible u value is mapped to 1
 	if (u_toInt == 0) u_toInt = 1;
+	if (u_toInt < encode_table_size){
+		const EncodeEntry &e = encode_table[u_toInt];
+		return rnd < e.thresh ? e.p_upper : e.p_lower;
+	}
 	double power = log(u_toInt) * log_factor;
 	uint16_t p_upper = ceil(power), p_lower = floor(power);
 	double upper = pow(log_base, p_upper), lower = pow(log_base, p_lower);
 	if (p_upper == p_lower)
 		upper *= log_base;
-	uint16_t p = (rand() % 65536 < (u_toInt - lower) / (upper - lower) * 65536) ? p_upper : p_lower;
+	uint16_t p = (rnd < (u_toInt - lower) / (upper - lower) * 65536) ? p_upper : p_lower;
 	return p;
 }
 
@@ -41,4 +61,57 @@ double Pint::decode_u(uint16_t p){
 	return pow(log_base, p) / max_concurrent;
 }
 
+static std::vector<int> BuildLogTable(int m, double fct){
+	std::vector<int> t((1 << m) + 1);
+	t[0] = int(log2(0.5) * fct); // unused: log2apprx(0) takes the slow path
+	for (int x = 1; x <= (1 << m); x++)
+		t[x] = int(log2(x) * fct);
+	return t;
+}
+
+const double PintPortCalc::fct = 1 << sft;
+const double PintPortCalc::log_1e9 = log2(1e9) * fct;
+const std::vector<int> PintPortCalc::log_table = BuildLogTable(m, fct);
+
+int PintPortCalc::log2apprx(int x, NodeRng &rng){
+	if (x <= 0)
+		return int(log2(x) * fct); // as the log2() form does
+	if (x < (1 << m))
+		return log_table[x];
+	// keep the most significant m bits of x and round up at random, as SwitchNode::log2apprx.
+	// int(log2(mant << s)*fct) == log_table[mant] + s*fct for every mantissa and shift (checked exhaustively)
+	int s = 32 - __builtin_clz((uint32_t)x) - m;
+	int mask = (1 << s) - 1;
+	int mant = x >> s;
+	if ((x & mask) > (int)(rng.GetNext32() & mask))
+		mant++;
+	return log_table[mant] + (s << sft);
+}
+
+double PintPortCalc::Update(uint64_t maxRtt, uint64_t B, uint64_t dt, uint64_t qlen, uint32_t lastPktSize, double u, NodeRng &rng){
+	if (maxRtt != m_maxRtt || B != m_B){
+		m_maxRtt = maxRtt;
+		m_B = B;
+		m_logT = log2(maxRtt)*fct;
+		m_logB = log2(B)*fct;
+	}
+	// the terms are evaluated in the same order and types as the log2()/pow() form, so the sum is the same
+	double qterm = 0, byteTerm = 0, uTerm = 0;
+	if ((qlen >> 8) > 0){
+		int log_dt = log2apprx(dt, rng); // ~log2(dt)*fct
+		int log_qlen = log2apprx(qlen >> 8, rng); // ~log2(qlen / 256)*fct
+		qterm = pow(2, (log_dt + log_qlen + log_1e9 - m_logB - 2*m_logT)/fct) * 256; // ~= dt*qlen*1e9/(B*T^2)
+	}
+	if (lastPktSize > 0){
+		int log_byte = log2apprx(lastPktSize, rng);
+		byteTerm = pow(2, (log_byte + log_1e9 - m_logB - m_logT)/fct); // ~= byte*1e9 / (B*T)
+	}
+	if (maxRtt > dt && u > 0){
+		int log_T_dt = log2apprx(maxRtt - dt, rng); // ~log2(T-dt)*fct
+		int log_u = log2apprx(int(round(u * 8192)), rng); // ~log2(u*512)*fct
+		uTerm = pow(2, (log_T_dt + log_u - m_logT)/fct) / 8192; // = (T-dt)*u/T
+	}
+	return qterm+byteTerm+uTerm;
+}
+
 } /* namespace ns3 */
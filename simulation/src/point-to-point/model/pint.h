@@ -2,6 +2,8 @@
 #define PINT_H
 
 #include <stdint.h>
+#include <vector>
+#include "node-rng.h"
 
 namespace ns3{
 class Pint{
@@ -11,8 +13,41 @@ public:
 	static void set_log_base(double base);
 	static int get_n_bits();
 	static int get_n_bytes();
-	static uint16_t encode_u(double u);
+	static uint16_t encode_u(double u, uint32_t rnd); // rnd: uniform in [0, 65536), rounds up or down at random
 	static double decode_u(uint16_t p);
+
+private:
+	// encode_u of u_toInt < encode_table.size(), rebuilt by set_log_base
+	struct EncodeEntry{
+		double thresh; // round up if rnd < thresh
+		uint16_t p_lower, p_upper;
+	};
+	static const uint32_t encode_table_size = 8 * max_concurrent; // u up to 8
+	static std::vector<EncodeEntry> encode_table;
+	static std::vector<EncodeEntry> build_encode_table();
+};
+
+/*
+ * The approximate utilization update of HPCC-PINT at a switch egress port.
+ * Gives the same newU, bit for bit, as the log2()/pow() form in SwitchNode::log2apprx and
+ * SwitchNotifyDequeue: log2apprx reads the log of the 16-bit mantissa from a table, and the
+ * logs of T and B are kept until MaxRtt or the link rate change.
+ */
+class PintPortCalc{
+public:
+	PintPortCalc() : m_maxRtt(0), m_B(0), m_logT(0), m_logB(0) {}
+	// dt: ns since the last packet (at most maxRtt), B: link rate in Bps, u: utilization at the last packet
+	double Update(uint64_t maxRtt, uint64_t B, uint64_t dt, uint64_t qlen, uint32_t lastPktSize, double u, NodeRng &rng);
+	static int log2apprx(int x, NodeRng &rng); // same as log2apprx(x, 20, 16, 20)
+
+private:
+	static const int sft = 15; // logres_shift(20, 20)
+	static const int m = 16;
+	static const double fct, log_1e9;
+	static const std::vector<int> log_table; // log_table[x] = int(log2(x)*fct), x <= 2^m
+
+	uint64_t m_maxRtt, m_B; // the link the logs below are for
+	double m_logT, m_logB; // log2(T)*fct, log2(B)*fct
 };
 } /* namespace ns3 */
 
@@ -26,7 +26,8 @@
 #include "ns3/nstime.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
-#include <map>
+#include <set>
+#include <deque>
 
 namespace ns3 {
 
@@ -102,13 +103,8 @@ public:
 
 
   
-  // [NEW] 添加文件流映射
-  static std::map<uint32_t, std::ofstream*> m_flowTraceFiles;
-
-  // [NEW] 添加/删除追踪流的接口
-  static void AddTraceFlow(uint32_t flowId, std::string output_dir);
-  // [NEW] 资源清理函数,防止内存泄漏
-  static void CleanupTraceFiles();
+  // [NEW] 注册需要追踪路径的流（trace flow id），被注册流的包经过信道时触发 "FlowPath" trace source
+  static void AddTraceFlow(uint32_t flowId);
 
   
 protected:
@@ -134,12 +130,44 @@ protected:
    */
   Ptr<QbbNetDevice> GetDestination (uint32_t i) const;
 
+  /*
+   * \brief Get the link a device transmits on, without taking a reference
+   * to the devices
+   * \param src the transmitting device
+   * \returns the index of the link
+   */
+  uint32_t GetWire (Ptr<QbbNetDevice> src) const;
+
+  /*
+   * \brief Get the net-device destination without taking a reference:
+   * with MultithreadedSimulatorImpl, the destination of a channel between
+   * two partitions belongs to another thread
+   * \param i the link requested
+   * \returns the QbbNetDevice destination for the specified link
+   */
+  QbbNetDevice *PeekDestination (uint32_t i) const;
+
+  /*
+   * \brief Get the id of the destination node, cached by Attach
+   * \param i the link requested
+   * \returns the node id of the destination of the specified link
+   */
+  uint32_t GetDestinationNode (uint32_t i) const;
+
 private:
+  /*
+   * \brief Deliver the first packet in flight on a wire (PacketTrain mode)
+   * and schedule the delivery of the next one
+   * \param wire the link
+   */
+  void DeliverInFlight (uint32_t wire);
+
   // Each point to point link has exactly two net devices
   static const int N_DEVICES = 2;
 
   Time          m_delay;
   int32_t       m_nDevices;
+  bool          m_packetTrain;
 
   static std::set<uint32_t> m_traceFlowIds;  // [new]追踪的流ID集合
 
@@ -161,6 +189,15 @@ private:
                  Time               // Last bit receive time (relative to now)
                  > m_txrxQbb;
 
+  /**
+   * [NEW] Fired only for packets whose trace flow id was registered with AddTraceFlow.
+   * When no flow is registered TransmitStart does not touch the packet headers at all.
+   */
+  TracedCallback<Ptr<const Packet>, // Packet being transmitted
+                 Ptr<QbbNetDevice>, // Transmitting device
+                 Ptr<QbbNetDevice>  // Receiving device
+                 > m_flowPathTrace;
+
   enum WireState
   {
     INITIALIZING,
@@ -172,10 +209,15 @@ private:
   class Link
   {
 public:
-    Link() : m_state (INITIALIZING), m_src (0), m_dst (0) {}
+    Link() : m_state (INITIALIZING), m_src (0), m_dst (0), m_dstNode (0) {}
     WireState                  m_state;
     Ptr<QbbNetDevice> m_src;
     Ptr<QbbNetDevice> m_dst;
+    uint32_t          m_dstNode;
+    // PacketTrain mode: the packets in flight and their arrival times, in
+    // order; only the first one has a receive event scheduled
+    std::deque<std::pair<Time, Ptr<Packet> > > m_inFlight;
+    Time              m_inFlightScheduled; // when the receive event of the first one was scheduled
   };
 
   Link    m_link[N_DEVICES];
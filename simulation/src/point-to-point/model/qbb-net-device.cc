@@ -36,7 +36,6 @@
 #include "ns3/simulator.h"
 #include "ns3/point-to-point-channel.h"
 #include "ns3/qbb-channel.h"
-#include "ns3/random-variable.h"
 #include "ns3/flow-id-tag.h"
 #include "ns3/qbb-header.h"
 #include "ns3/error-model.h"
@@ -72,6 +71,9 @@ namespace ns3 {
 		m_qlast = 0;
 		m_ackQ = CreateObject<DropTailQueue>();
 		m_ackQ->SetAttribute("MaxBytes", UintegerValue(0xffffffff)); // queue limit is on a higher level, not here
+		m_schedGrp = 0;
+		m_schedVersion = 0;
+		m_nFinished = 0;
 	}
 
 	Ptr<Packet> RdmaEgressQueue::DequeueQindex(int qIndex){
@@ -91,41 +93,145 @@ namespace ns3 {
 		return 0;
 	}
 	int RdmaEgressQueue::GetNextQindex(bool paused[]){
-		bool found = false;
-		uint32_t qIndex;
 		if (!paused[ack_q_idx] && m_ackQ->GetNPackets() > 0)
 			return -1;
 
 		// no pkt in highest priority queue, do rr for each qp
-		int res = -1024;
+		SyncSched();
+		if (m_nFinished > 0 && m_nFinished * 2 >= m_qpGrp->GetN())
+			CompactSched();
 		uint32_t fcount = m_qpGrp->GetN();
-		uint32_t min_finish_id = 0xffffffff;
-		for (qIndex = 1; qIndex <= fcount; qIndex++){
-			uint32_t idx = (qIndex + m_rrlast) % fcount;
-			Ptr<RdmaQueuePair> qp = m_qpGrp->Get(idx);
-			if (!paused[qp->m_pg] && qp->GetBytesLeft() > 0 && !qp->IsWinBound()){
-				if (m_qpGrp->Get(idx)->m_nextAvail.GetTimeStep() > Simulator::Now().GetTimeStep()) //not available now
+		if (fcount == 0)
+			return -1024;
+		int64_t now = Simulator::Now().GetTimeStep();
+		PopExpiredTimer(now);
+
+		// 从m_rrlast之后开始, 在未暂停的pg中找RR顺序上的第一个候选qp
+		uint32_t start = (m_rrlast + 1) % fcount;
+		while (true){
+			int res = -1;
+			uint32_t best = fcount;
+			for (uint32_t pg = 0; pg < qCnt; pg++){
+				if (paused[pg] || m_schedCand[pg].empty())
 					continue;
-				res = idx;
-				break;
-			}else if (qp->IsFinished()){
-				min_finish_id = idx < min_finish_id ? idx : min_finish_id;
+				std::set<uint32_t>::iterator it = m_schedCand[pg].lower_bound(start);
+				if (it == m_schedCand[pg].end())
+					it = m_schedCand[pg].begin();
+				uint32_t dist = (*it + fcount - start) % fcount;
+				if (dist < best){
+					best = dist;
+					res = *it;
+				}
 			}
+			if (res < 0)
+				return -1024;
+			Ptr<RdmaQueuePair> qp = m_qpGrp->Get(res);
+			if (qp->GetBytesLeft() > 0 && !qp->IsWinBound() && qp->m_nextAvail.GetTimeStep() <= now)
+				return res;
+			ParkQp(res); // not sendable now, park it until its wake condition
 		}
+	}
 
-		// clear the finished qp
-		if (min_finish_id < 0xffffffff){
-			int nxt = min_finish_id;
-			auto &qps = m_qpGrp->m_qps;
-			for (int i = min_finish_id + 1; i < fcount; i++) if (!qps[i]->IsFinished()){
-				if (i == res) // update res to the idx after removing finished qp
-					res = nxt;
-				qps[nxt] = qps[i];
-				nxt++;
-			}
-			qps.resize(nxt);
+	void RdmaEgressQueue::SyncSched(void){
+		// qpGrp rebuilt (RedistributeQp) or replaced: start over
+		if (m_schedGrp != PeekPointer(m_qpGrp) || m_schedVersion != m_qpGrp->m_version){
+			m_schedGrp = PeekPointer(m_qpGrp);
+			m_schedVersion = m_qpGrp->m_version;
+			for (uint32_t pg = 0; pg < qCnt; pg++)
+				m_schedCand[pg].clear();
+			m_schedTimer = std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry> >();
+			m_schedState.clear();
+			m_schedWakeTs.clear();
+			m_nFinished = 0;
+		}
+		// qps appended by AddQp start as candidates
+		for (uint32_t i = m_schedState.size(); i < m_qpGrp->GetN(); i++){
+			NS_ASSERT_MSG(m_qpGrp->Get(i)->m_pg < qCnt, "RdmaEgressQueue: qp pg >= qCnt");
+			m_schedState.push_back(SCHED_BLOCKED);
+			m_schedWakeTs.push_back(0);
+			SetCand(i);
+		}
+	}
+
+	void RdmaEgressQueue::CompactSched(void){
+		// clear the finished qp, keep the RR position on the last served qp
+		std::vector<Ptr<RdmaQueuePair> > &qps = m_qpGrp->m_qps;
+		uint32_t n = qps.size(), nxt = 0;
+		int rr = -1;
+		for (uint32_t pg = 0; pg < qCnt; pg++)
+			m_schedCand[pg].clear();
+		m_schedTimer = std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry> >();
+		for (uint32_t i = 0; i < n; i++){
+			if (m_schedState[i] == SCHED_FINISHED)
+				continue;
+			if (i <= m_rrlast)
+				rr = nxt;
+			qps[nxt] = qps[i];
+			qps[nxt]->m_grpIdx = nxt;
+			m_schedState[nxt] = m_schedState[i];
+			m_schedWakeTs[nxt] = m_schedWakeTs[i];
+			if (m_schedState[nxt] == SCHED_CAND)
+				m_schedCand[qps[nxt]->m_pg].insert(nxt);
+			else if (m_schedState[nxt] == SCHED_TIMER)
+				m_schedTimer.push(TimerEntry(m_schedWakeTs[nxt], nxt));
+			nxt++;
+		}
+		qps.resize(nxt);
+		m_schedState.resize(nxt);
+		m_schedWakeTs.resize(nxt);
+		m_rrlast = rr >= 0 ? rr : (nxt > 0 ? nxt - 1 : 0);
+		m_nFinished = 0;
+	}
+
+	void RdmaEgressQueue::SetCand(uint32_t idx){
+		m_schedState[idx] = SCHED_CAND;
+		m_schedCand[m_qpGrp->Get(idx)->m_pg].insert(idx);
+	}
+
+	void RdmaEgressQueue::ParkQp(uint32_t idx){
+		Ptr<RdmaQueuePair> qp = m_qpGrp->Get(idx);
+		m_schedCand[qp->m_pg].erase(idx);
+		if (qp->GetBytesLeft() == 0 || qp->IsWinBound()){
+			if (qp->IsFinished()){
+				m_schedState[idx] = SCHED_FINISHED;
+				m_nFinished++;
+			}else
+				m_schedState[idx] = SCHED_BLOCKED;
+		}else{ // only rate limited
+			m_schedState[idx] = SCHED_TIMER;
+			m_schedWakeTs[idx] = qp->m_nextAvail.GetTimeStep();
+			m_schedTimer.push(TimerEntry(m_schedWakeTs[idx], idx));
+		}
+	}
+
+	void RdmaEgressQueue::PopExpiredTimer(int64_t now){
+		while (!m_schedTimer.empty() && m_schedTimer.top().first <= now){
+			TimerEntry e = m_schedTimer.top();
+			m_schedTimer.pop();
+			// skip stale entries: qp was woken or re-parked since this push
+			if (m_schedState[e.second] == SCHED_TIMER && m_schedWakeTs[e.second] == e.first)
+				SetCand(e.second);
+		}
+	}
+
+	void RdmaEgressQueue::WakeQp(Ptr<RdmaQueuePair> qp){
+		SyncSched();
+		uint32_t idx = qp->m_grpIdx;
+		if (idx >= m_qpGrp->GetN() || m_qpGrp->Get(idx) != qp)
+			return; // already removed from this group
+		if (m_schedState[idx] == SCHED_TIMER || m_schedState[idx] == SCHED_BLOCKED)
+			SetCand(idx);
+	}
+
+	Time RdmaEgressQueue::GetNextAvailTime(void){
+		SyncSched();
+		while (!m_schedTimer.empty()){
+			TimerEntry e = m_schedTimer.top();
+			if (m_schedState[e.second] == SCHED_TIMER && m_schedWakeTs[e.second] == e.first)
+				return TimeStep(e.first);
+			m_schedTimer.pop();
 		}
-		return res;
+		return Simulator::GetMaximumSimulationTime();
 	}
 
 	int RdmaEgressQueue::GetLastQueue(){
@@ -148,6 +254,7 @@ namespace ns3 {
 	void RdmaEgressQueue::RecoverQueue(uint32_t i){
 		NS_ASSERT_MSG(i < m_qpGrp->GetN(), "RdmaEgressQueue::RecoverQueue: qIndex >= m_qpGrp->GetN()");
 		m_qpGrp->Get(i)->snd_nxt = m_qpGrp->Get(i)->snd_una;
+		WakeQp(m_qpGrp->Get(i));
 	}
 
 	void RdmaEgressQueue::EnqueueHighPrioQ(Ptr<Packet> p){
@@ -227,6 +334,7 @@ namespace ns3 {
 		}
 
 		m_rdmaEQ = CreateObject<RdmaEgressQueue>();
+		m_rxScheduled = Seconds(-1);
 	}
 
 	QbbNetDevice::~QbbNetDevice()
@@ -284,13 +392,7 @@ namespace ns3 {
 				m_rdmaPktSent(lastQp, p, m_tInterframeGap);
 			}else { // no packet to send
 				NS_LOG_INFO("PAUSE prohibits send at node " << m_node->GetId());
-				Time t = Simulator::GetMaximumSimulationTime();
-				for (uint32_t i = 0; i < m_rdmaEQ->GetFlowCount(); i++){
-					Ptr<RdmaQueuePair> qp = m_rdmaEQ->GetQp(i);
-					if (qp->GetBytesLeft() == 0)
-						continue;
-					t = Min(qp->m_nextAvail, t);
-				}
+				Time t = m_rdmaEQ->GetNextAvailTime();
 				if (m_nextSend.IsExpired() && t < Simulator::GetMaximumSimulationTime() && t > Simulator::Now()){
 					m_nextSend = Simulator::Schedule(t - Simulator::Now(), &QbbNetDevice::DequeueAndTransmit, this);
 				}
@@ -302,11 +404,6 @@ namespace ns3 {
 			if (p != 0){
 				m_snifferTrace(p);
 				m_promiscSnifferTrace(p);
-				Ipv4Header h;
-				Ptr<Packet> packet = p->Copy();
-				uint16_t protocol = 0;
-				ProcessHeader(packet, protocol);
-				packet->RemoveHeader(h);
 				FlowIdTag t;
 				uint32_t qIndex = m_queue->GetLastQueue();
 				if (qIndex == 0){//this is a pause or cnp, send it immediately!
@@ -322,13 +419,7 @@ namespace ns3 {
 			}else{ //No queue can deliver any packet
 				NS_LOG_INFO("PAUSE prohibits send at node " << m_node->GetId());
 				if (m_node->GetNodeType() == 0 && m_qcnEnabled){ //nothing to send, possibly due to qcn flow control, if so reschedule sending
-					Time t = Simulator::GetMaximumSimulationTime();
-					for (uint32_t i = 0; i < m_rdmaEQ->GetFlowCount(); i++){
-						Ptr<RdmaQueuePair> qp = m_rdmaEQ->GetQp(i);
-						if (qp->GetBytesLeft() == 0)
-							continue;
-						t = Min(qp->m_nextAvail, t);
-					}
+					Time t = m_rdmaEQ->GetNextAvailTime();
 					if (m_nextSend.IsExpired() && t < Simulator::GetMaximumSimulationTime() && t > Simulator::Now()){
 						m_nextSend = Simulator::Schedule(t - Simulator::Now(), &QbbNetDevice::DequeueAndTransmit, this);
 					}
@@ -371,8 +462,13 @@ namespace ns3 {
 
 		m_macRxTrace(packet);
 		CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
-		ch.getInt = 1; // parse INT header
-		packet->PeekHeader(ch);
+		const PacketHeaderDesc *desc = packet->GetHeaderDesc();
+		if (desc != 0 && m_node->GetNodeType() > 0){
+			ch.FromHeaderDesc(*desc); // switch only needs 5-tuple/pg/seq, reuse the descriptor
+		}else{
+			ch.getInt = 1; // parse INT header
+			packet->PeekHeader(ch);
+		}
 		if (ch.l3Prot == 0xFE){ // PFC
 			if (!m_qbbEnabled) return;
 			unsigned qIndex = ch.pfc.qIndex;
@@ -396,6 +492,20 @@ namespace ns3 {
 		return;
 	}
 
+	void
+		QbbNetDevice::ReceiveScheduled(Ptr<Packet> packet, Time scheduled)
+	{
+		m_rxScheduled = scheduled;
+		Receive(packet);
+		m_rxScheduled = Seconds(-1);
+	}
+
+	Time
+		QbbNetDevice::GetRxScheduled(void) const
+	{
+		return m_rxScheduled.IsNegative() ? Simulator::Now() : m_rxScheduled;
+	}
+
 	bool QbbNetDevice::Send(Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber)
 	{
 		NS_ASSERT_MSG(false, "QbbNetDevice::Send not implemented yet\n");
@@ -411,6 +521,11 @@ namespace ns3 {
 		return true;
 	}
 
+	void QbbNetDevice::SetIfIndex (const uint32_t index){
+		PointToPointNetDevice::SetIfIndex(index);
+		m_rng.SetStream(m_node->GetId(), NodeRng::DEVICE + index);
+	}
+
 	void QbbNetDevice::SendPfc(uint32_t qIndex, uint32_t type){
 		Ptr<Packet> p = Create<Packet>(0);
 		PauseHeader pauseh((type == 0 ? m_pausetime : 0), m_queue->GetNBytes(qIndex), qIndex);
@@ -421,7 +536,7 @@ namespace ns3 {
 		ipv4h.SetDestination(Ipv4Address("255.255.255.255"));
 		ipv4h.SetPayloadSize(p->GetSize());
 		ipv4h.SetTtl(1);
-		ipv4h.SetIdentification(UniformVariable(0, 65536).GetValue());
+		ipv4h.SetIdentification(m_rng.GetNext16());
 		p->AddHeader(ipv4h);
 		AddHeader(p, 0x800);
 		CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
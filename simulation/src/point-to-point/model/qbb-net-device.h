@@ -31,7 +31,10 @@
 #include "ns3/rdma-queue-pair.h"
 #include <vector>
 #include<map>
+#include <set>
+#include <queue>
 #include <ns3/rdma.h>
+#include "node-rng.h"
 
 namespace ns3 {
 
@@ -59,9 +62,35 @@ public:
 	void RecoverQueue(uint32_t i);
 	void EnqueueHighPrioQ(Ptr<Packet> p);
 	void CleanHighPrio(TracedCallback<Ptr<const Packet>, uint32_t> dropCb);
+	void WakeQp(Ptr<RdmaQueuePair> qp); // qp state changed outside the queue (ack, rate change)
+	Time GetNextAvailTime(void); // earliest m_nextAvail among rate-limited qps
 
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceRdmaEnqueue;
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceRdmaDequeue;
+
+private:
+	/**
+	 * QP scheduler state. Every qp in m_qpGrp is in exactly one state:
+	 *  - CAND: may be sendable, kept in m_schedCand[pg] ordered by index (RR order)
+	 *  - TIMER: only waiting for m_nextAvail, parked in m_schedTimer
+	 *  - BLOCKED: window bound or no bytes left, waits for WakeQp()
+	 *  - FINISHED: all acked, removed by CompactSched()
+	 */
+	enum { SCHED_CAND = 0, SCHED_TIMER, SCHED_BLOCKED, SCHED_FINISHED };
+	typedef std::pair<int64_t, uint32_t> TimerEntry; // <m_nextAvail, qp index>
+	std::set<uint32_t> m_schedCand[qCnt];
+	std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry> > m_schedTimer;
+	std::vector<uint8_t> m_schedState;
+	std::vector<int64_t> m_schedWakeTs; // ts of the valid m_schedTimer entry of each qp
+	RdmaQueuePairGroup *m_schedGrp;
+	uint32_t m_schedVersion;
+	uint32_t m_nFinished;
+
+	void SyncSched(void);
+	void CompactSched(void);
+	void SetCand(uint32_t idx);
+	void ParkQp(uint32_t idx);
+	void PopExpiredTimer(int64_t now);
 };
 
 /**
@@ -90,6 +119,23 @@ public:
    */
   virtual void Receive (Ptr<Packet> p);
 
+  /**
+   * Receive a packet whose receive event was scheduled at the given time.
+   *
+   * RdmaHw orders a CNP against its DCQCN timers due at the same time by
+   * when its receive event was scheduled (see RdmaHw::cnp_received_mlx).
+   *
+   * @param p Ptr to the received packet.
+   * @param scheduled the time the receive event was scheduled at.
+   */
+  void ReceiveScheduled (Ptr<Packet> p, Time scheduled);
+
+  /**
+   * @returns when the event receiving the current packet was scheduled;
+   * Now if the channel did not tell (Receive called directly, e.g. by MPI).
+   */
+  Time GetRxScheduled (void) const;
+
   /**
    * Send a packet to the channel by putting it to the queue
    * of the corresponding priority class
@@ -101,6 +147,12 @@ public:
   virtual bool Send(Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber);
   virtual bool SwitchSend (uint32_t qIndex, Ptr<Packet> packet, CustomHeader &ch);
 
+  /**
+   * Also selects the random stream of this port, so it is called after SetNode
+   * (see Node::AddDevice)
+   */
+  virtual void SetIfIndex (const uint32_t index);
+
   /**
    * Get the size of Tx buffer available in the device
    *
@@ -163,6 +215,7 @@ protected:
   bool m_dynamicth;
   uint32_t m_pausetime;	//< Time for each Pause
   bool m_paused[qCnt];	//< Whether a queue paused
+  NodeRng m_rng;	//< IP id of the PFC frames
 
   //qcn
 
@@ -202,6 +255,9 @@ public:
 	void UpdateNextAvail(Time t);
 
 	TracedCallback<Ptr<const Packet>, Ptr<RdmaQueuePair> > m_traceQpDequeue; // the trace for printing dequeue
+
+private:
+	Time m_rxScheduled; // set by ReceiveScheduled during the receive, negative otherwise
 };
 
 } // namespace ns3
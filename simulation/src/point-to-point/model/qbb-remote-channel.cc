@@ -19,6 +19,7 @@
  */
 
 #include <iostream>
+#include <vector>
 
 #include "qbb-remote-channel.h"
 #include "qbb-net-device.h"
@@ -64,16 +65,40 @@ QbbRemoteChannel::TransmitStart (
 
   IsInitialized ();
 
-  uint32_t wire = src == GetSource (0) ? 0 : 1;
-  Ptr<QbbNetDevice> dst = GetDestination (wire);
+  uint32_t wire = GetWire (src);
 
+  if (MpiInterface::IsEnabled ())
+    {
 #ifdef NS3_MPI
-  // Calculate the rxTime (absolute)
-  Time rxTime = Simulator::Now () + txTime + GetDelay ();
-  MpiInterface::SendPacket (p, rxTime, dst->GetNode ()->GetId (), dst->GetIfIndex ());
+      Ptr<QbbNetDevice> dst = GetDestination (wire);
+      // Calculate the rxTime (absolute)
+      Time rxTime = Simulator::Now () + txTime + GetDelay ();
+      MpiInterface::SendPacket (p, rxTime, dst->GetNode ()->GetId (), dst->GetIfIndex ());
 #else
-  NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+      NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
 #endif
+      return true;
+    }
+
+  // The other end is run by another thread (MultithreadedSimulatorImpl).
+  // Reference counts are not atomic: the receiver gets a deep copy of the
+  // packet and a raw pointer to its device, so that no reference count is
+  // shared by the two partitions. The traces of QbbChannel are not fired,
+  // their sinks would take references to the remote device: do not connect
+  // them in this mode (third refuses flow path tracing with threads).
+  static thread_local std::vector<uint8_t> buffer;
+  uint32_t size = p->GetSerializedSize ();
+  buffer.resize (size);
+  p->Serialize (&buffer[0], size);
+  Ptr<Packet> copy = Create<Packet> (&buffer[0], size, true);
+  copy->AddTraceFlowId (p->GetTraceFlowId ());
+  if (p->GetHeaderDesc () != 0)
+    {
+      copy->SetHeaderDesc (*p->GetHeaderDesc ());
+    }
+  Simulator::ScheduleWithContext (GetDestinationNode (wire), txTime + GetDelay (),
+                                  &QbbNetDevice::ReceiveScheduled, PeekDestination (wire), copy,
+                                  Simulator::Now ());
   return true;
 }
 
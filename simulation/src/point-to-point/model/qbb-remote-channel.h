@@ -20,7 +20,9 @@
 
 // This object connects two point-to-point net devices where at least one
 // is not local to this simulator object.  It simply over-rides the transmit
-// method and uses an MPI Send operation instead.
+// method and uses an MPI Send operation instead, or with the shared-memory
+// MultithreadedSimulatorImpl hands a copy of the packet to the thread of
+// the other partition.
 
 #ifndef QBB_REMOTE_CHANNEL_H
 #define QBB_REMOTE_CHANNEL_H
@@ -0,0 +1,113 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdint.h>
+#include <iostream>
+#include "raw-header.h"
+#include "ns3/buffer.h"
+#include "ns3/log.h"
+
+NS_LOG_COMPONENT_DEFINE ("RawHeader");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (RawHeader);
+
+RawHeader::RawHeader ()
+{
+}
+
+RawHeader::~RawHeader ()
+{
+}
+
+void RawHeader::SetData (const uint8_t *data, uint32_t size)
+{
+  m_data.assign (data, data + size);
+}
+
+uint8_t* RawHeader::GetData (void)
+{
+  return m_data.empty () ? 0 : &m_data[0];
+}
+
+void RawHeader::WriteHtonU16 (uint32_t offset, uint16_t v)
+{
+  NS_ASSERT (offset + 2 <= m_data.size ());
+  m_data[offset] = v >> 8;
+  m_data[offset + 1] = v & 0xff;
+}
+
+void RawHeader::WriteHtonU32 (uint32_t offset, uint32_t v)
+{
+  NS_ASSERT (offset + 4 <= m_data.size ());
+  m_data[offset] = v >> 24;
+  m_data[offset + 1] = (v >> 16) & 0xff;
+  m_data[offset + 2] = (v >> 8) & 0xff;
+  m_data[offset + 3] = v & 0xff;
+}
+
+void RawHeader::WriteU64 (uint32_t offset, uint64_t v)
+{
+  NS_ASSERT (offset + 8 <= m_data.size ());
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      m_data[offset + i] = v & 0xff;
+      v >>= 8;
+    }
+}
+
+TypeId
+RawHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RawHeader")
+    .SetParent<Header> ()
+    .AddConstructor<RawHeader> ()
+    ;
+  return tid;
+}
+
+TypeId
+RawHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void RawHeader::Print (std::ostream &os) const
+{
+  os << "raw=" << m_data.size ();
+}
+
+uint32_t RawHeader::GetSerializedSize (void) const
+{
+  return m_data.size ();
+}
+
+void RawHeader::Serialize (Buffer::Iterator start) const
+{
+  if (!m_data.empty ())
+    start.Write (&m_data[0], m_data.size ());
+}
+
+// the size must be set (SetData) before, a raw run has no length field
+uint32_t RawHeader::Deserialize (Buffer::Iterator start)
+{
+  if (!m_data.empty ())
+    start.Read (&m_data[0], m_data.size ());
+  return m_data.size ();
+}
+
+}; // namespace ns3
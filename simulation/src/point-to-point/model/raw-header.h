@@ -0,0 +1,62 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RAW_HEADER_H
+#define RAW_HEADER_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/header.h"
+#include "ns3/buffer.h"
+
+namespace ns3 {
+
+/**
+ * \brief A run of already serialized header bytes
+ *
+ * Used as a per-QP template of the ppp/ip/udp/SeqTs/INT headers: the bytes
+ * are built once, then only seq/ipid/length (and the INT ts in TS mode)
+ * are patched before each AddHeader, instead of serializing four headers
+ * per packet.
+ */
+class RawHeader : public Header
+{
+public:
+  RawHeader ();
+  virtual ~RawHeader ();
+
+  void SetData (const uint8_t *data, uint32_t size);
+  uint8_t* GetData (void);
+  // patch a field in network byte order
+  void WriteHtonU16 (uint32_t offset, uint16_t v);
+  void WriteHtonU32 (uint32_t offset, uint32_t v);
+  // patch a field written by Buffer::Iterator::WriteU64 (least significant byte first)
+  void WriteU64 (uint32_t offset, uint64_t v);
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual void Print (std::ostream &os) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  std::vector<uint8_t> m_data;
+};
+
+}; // namespace ns3
+
+#endif /* RAW_HEADER_H */
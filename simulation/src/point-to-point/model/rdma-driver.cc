@@ -1,4 +1,5 @@
 #include "rdma-driver.h"
+#include <ns3/simulator.h>
 
 namespace ns3 {
 
@@ -64,6 +65,21 @@ void RdmaDriver::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4A
 	m_rdma->AddQueuePair(size, pg, sip, dip, sport, dport, win, baseRtt, notifyAppFinish);
 }
 
+void RdmaDriver::AddFlow(const Flow &flow){
+	if (m_pendingFlows.empty())
+		Simulator::ScheduleWithContext(m_node->GetId(), Seconds(0), &RdmaDriver::StartPendingFlows, this);
+	m_pendingFlows.push_back(flow);
+}
+
+void RdmaDriver::StartPendingFlows(void){
+	std::vector<Flow> flows;
+	flows.swap(m_pendingFlows);
+	for (uint32_t i = 0; i < flows.size(); i++){
+		Flow &f = flows[i];
+		m_rdma->AddQueuePair(f.size, f.pg, f.sip, f.dip, f.sport, f.dport, f.win, f.baseRtt, Callback<void>());
+	}
+}
+
 void RdmaDriver::QpComplete(Ptr<RdmaQueuePair> q){
 	m_traceQpComplete(q);
 }
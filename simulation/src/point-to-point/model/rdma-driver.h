@@ -13,8 +13,19 @@ namespace ns3 {
 
 class RdmaDriver : public Object {
 public:
+	// a flow started by AddFlow, without an RdmaClient application
+	struct Flow {
+		uint64_t size;
+		uint16_t pg;
+		Ipv4Address sip, dip;
+		uint16_t sport, dport;
+		uint32_t win;
+		uint64_t baseRtt;
+	};
+
 	Ptr<Node> m_node;
 	Ptr<RdmaHw> m_rdma;
+	std::vector<Flow> m_pendingFlows; // added at the current time, started by StartPendingFlows
 
 	// trace
 	TracedCallback<Ptr<RdmaQueuePair> > m_traceQpComplete;
@@ -35,6 +46,11 @@ public:
 	// add a queue pair
 	void AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish);
 
+	// start a flow now, in the node's context. All the flows added at the same
+	// time are started by one event; nothing is left on the node when they complete
+	void AddFlow(const Flow &flow);
+	void StartPendingFlows(void);
+
 	// callback when qp completes
 	void QpComplete(Ptr<RdmaQueuePair> q);
 };
@@ -12,6 +12,7 @@
 #include "ppp-header.h"
 #include "qbb-header.h"
 #include "cn-header.h"
+#include "hpcc-int.h"
 
 namespace ns3{
 
@@ -170,7 +171,7 @@ TypeId RdmaHw::GetTypeId (void)
 				MakeDataRateAccessor(&RdmaHw::m_dctcp_rai),
 				MakeDataRateChecker())
 		.AddAttribute("PintSmplThresh",
-				"PINT's sampling threshold in rand()%65536",
+				"PINT's sampling threshold out of 65536",
 				UintegerValue(65536),
 				MakeUintegerAccessor(&RdmaHw::pint_smpl_thresh),
 				MakeUintegerChecker<uint32_t>())
@@ -178,11 +179,12 @@ TypeId RdmaHw::GetTypeId (void)
 	return tid;
 }
 
-RdmaHw::RdmaHw(){
+RdmaHw::RdmaHw() : m_mlxTimerSeq(0){
 }
 
 void RdmaHw::SetNode(Ptr<Node> node){
 	m_node = node;
+	m_rng.SetStream(node->GetId(), NodeRng::RDMA_HW);
 }
 void RdmaHw::Setup(QpCompleteCallback cb){
 	for (uint32_t i = 0; i < m_nic.size(); i++){
@@ -259,7 +261,7 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
 		qp->hp.m_curRate = m_bps;
 		if (m_multipleRate){
 			for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-				qp->hp.hopState[i].Rc = m_bps;
+				qp->hp.hopRc[i] = m_bps;
 		}
 	}else if (m_cc_mode == 7){ // TIMELY mode
 		qp->tmly.m_curRate = m_bps;
@@ -348,6 +350,17 @@ int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch){
 
 		newp->AddHeader(head);
 		AddHeader(newp, 0x800);	// Attach PPP header
+		// [new] 包头描述, 交换机直接复用
+		PacketHeaderDesc desc;
+		desc.sip = ch.dip;
+		desc.dip = ch.sip;
+		desc.sport = ch.udp.dport;
+		desc.dport = ch.udp.sport;
+		desc.pg = ch.udp.pg;
+		desc.seq = rxQp->ReceiverNextExpectedSeq;
+		desc.intOffset = 0;
+		desc.l3Prot = x == 1 ? 0xFC : 0xFD;
+		newp->SetHeaderDesc(desc);
 		// send
 		uint32_t nic_idx = GetNicIdxOfRxQp(rxQp);
 		m_nic[nic_idx].dev->RdmaEnqueueHighPrioQ(newp);
@@ -389,7 +402,7 @@ int RdmaHw::ReceiveCnp(Ptr<Packet> p, CustomHeader &ch){
 			qp->hp.m_curRate = dev->GetDataRate();
 			if (m_multipleRate){
 				for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-					qp->hp.hopState[i].Rc = dev->GetDataRate();
+					qp->hp.hopRc[i] = dev->GetDataRate();
 			}
 		}else if (m_cc_mode == 7){
 			qp->tmly.m_curRate = dev->GetDataRate();
@@ -441,7 +454,7 @@ int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch){
 	// handle cnp
 	if (cnp){
 		if (m_cc_mode == 1){ // mlx version
-			cnp_received_mlx(qp);
+			cnp_received_mlx(qp, Simulator::Now() - dev->GetRxScheduled());
 		} 
 	}
 
@@ -455,6 +468,7 @@ int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch){
 		HandleAckHpPint(qp, p, ch);
 	}
 	// ACK may advance the on-the-fly window, allowing more packets to send
+	dev->m_rdmaEQ->WakeQp(qp);
 	dev->TriggerTransmit();
 	return 0;
 }
@@ -521,22 +535,15 @@ void RdmaHw::RecoverQueue(Ptr<RdmaQueuePair> qp){
 
 void RdmaHw::QpComplete(Ptr<RdmaQueuePair> qp){
 	NS_ASSERT(!m_qpCompleteCallback.IsNull());
-	if (m_cc_mode == 1){
-        // printf("%lu [Debug] QpComplete cancel timers: node:%u sip:%08x dip:%08x sport:%u dport:%u alphaEvt:%s decEvt:%s rpTimer:%s\n",
-        //     Simulator::Now().GetTimeStep(), m_node->GetId(), qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport,
-        //     Simulator::IsExpired(qp->mlx.m_eventUpdateAlpha) ? "expired" : "active",
-        //     Simulator::IsExpired(qp->mlx.m_eventDecreaseRate) ? "expired" : "active",
-        //     Simulator::IsExpired(qp->mlx.m_rpTimer) ? "expired" : "active");
-		Simulator::Cancel(qp->mlx.m_eventUpdateAlpha);
-		Simulator::Cancel(qp->mlx.m_eventDecreaseRate);
-		Simulator::Cancel(qp->mlx.m_rpTimer);
-	}
+	if (m_cc_mode == 1)
+		FreeMlxSlot(qp);
 
 	// This callback will log info
 	// It may also delete the rxQp on the receiver
 	m_qpCompleteCallback(qp);
 
-	qp->m_notifyAppFinish();
+	if (!qp->m_notifyAppFinish.IsNull()) // no app for flows started by RdmaDriver::AddFlow
+		qp->m_notifyAppFinish();
 
 	// delete the qp
 	DeleteQueuePair(qp);
@@ -552,6 +559,14 @@ void RdmaHw::AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx){
 	m_rtTable[dip].push_back(intf_idx);
 }
 
+void RdmaHw::SetTableEntry(Ipv4Address &dstAddr, const std::vector<int> &intf_idx){
+	uint32_t dip = dstAddr.Get();
+	if (intf_idx.empty())
+		m_rtTable.erase(dip);
+	else
+		m_rtTable[dip] = intf_idx;
+}
+
 void RdmaHw::ClearTable(){
 	m_rtTable.clear();
 }
@@ -572,17 +587,16 @@ void RdmaHw::RedistributeQp(){
 		// Notify Nic
 		m_nic[nic_idx].dev->ReassignedQp(qp);
 	}
+	if (m_cc_mode == 1)
+		RestartMlxIncrease();
 }
 
-// 数据包从QP创建中进行分解
-Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
-	uint32_t payload_size = qp->GetBytesLeft();
-	if (m_mtu < payload_size)
-		payload_size = m_mtu;
-	Ptr<Packet> p = Create<Packet> (payload_size);
+// [new] 构建qp的包头模板: 按原方式序列化一次 ppp/ip/udp/SeqTs/INT, 之后每个包只修改 seq/ipid/长度
+void RdmaHw::BuildHeaderTemplate(Ptr<RdmaQueuePair> qp){
+	Ptr<Packet> p = Create<Packet> (0);
 	// add SeqTsHeader
 	SeqTsHeader seqTs;
-	seqTs.SetSeq (qp->snd_nxt);
+	seqTs.SetSeq (0);
 	seqTs.SetPG (qp->m_pg);
 	p->AddHeader (seqTs);
 	// add udp header
@@ -598,13 +612,49 @@ Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
 	ipHeader.SetPayloadSize (p->GetSize());
 	ipHeader.SetTtl (64);
 	ipHeader.SetTos (0);
-	ipHeader.SetIdentification (qp->m_ipid);
+	ipHeader.SetIdentification (0);
 	p->AddHeader(ipHeader);
 	// add ppp header
 	PppHeader ppp;
 	ppp.SetProtocol (0x0021); // EtherToPpp(0x800), see point-to-point-net-device.cc
 	p->AddHeader (ppp);
 
+	std::vector<uint8_t> buf(p->GetSize());
+	p->CopyData(&buf[0], buf.size());
+	qp->m_hdrTemplate.SetData(&buf[0], buf.size());
+}
+
+// 数据包从QP创建中进行分解
+Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
+	uint32_t payload_size = qp->GetBytesLeft();
+	if (m_mtu < payload_size)
+		payload_size = m_mtu;
+	Ptr<Packet> p = Create<Packet> (payload_size);
+	// patch the per-qp header template and add it as a whole
+	if (qp->m_hdrTemplate.GetSerializedSize() == 0)
+		BuildHeaderTemplate(qp);
+	const uint32_t ipOff = PppHeader::GetStaticSize(), udpOff = ipOff + 20;
+	uint16_t udpLen = 8 + SeqTsHeader::GetHeaderSize() + payload_size;
+	qp->m_hdrTemplate.WriteHtonU16(ipOff + 2, udpLen + 20); // ip total length
+	qp->m_hdrTemplate.WriteHtonU16(ipOff + 4, qp->m_ipid); // ip identification
+	qp->m_hdrTemplate.WriteHtonU16(udpOff + 4, udpLen); // udp length
+	qp->m_hdrTemplate.WriteHtonU32(udpOff + 8, qp->snd_nxt); // SeqTs seq
+	if (IntHeader::mode == IntHeader::TS)
+		qp->m_hdrTemplate.WriteU64(udpOff + 8 + 6, Simulator::Now().GetTimeStep()); // INT ts, the send time TIMELY measures the rtt from
+	p->AddHeader(qp->m_hdrTemplate);
+
+	// [new] 包头描述, 交换机直接复用, 不再逐跳解析
+	PacketHeaderDesc desc;
+	desc.sip = qp->sip.Get();
+	desc.dip = qp->dip.Get();
+	desc.sport = qp->sport;
+	desc.dport = qp->dport;
+	desc.pg = qp->m_pg;
+	desc.seq = qp->snd_nxt;
+	desc.intOffset = PppHeader::GetStaticSize() + 20 + 8 + 6; // ppp, ip, udp, SeqTs, INT
+	desc.l3Prot = 0x11;
+	p->SetHeaderDesc(desc);
+
 	// update state
 	qp->snd_nxt += payload_size; //关键点:序号增加按字节数
 
@@ -639,6 +689,7 @@ void RdmaHw::ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate){
 	qp->m_nextAvail = qp->m_nextAvail + new_sendintTime - sendingTime;
 	// update nic's next avail event
 	uint32_t nic_idx = GetNicIdxOfQp(qp);
+	m_nic[nic_idx].dev->m_rdmaEQ->WakeQp(qp);
 	m_nic[nic_idx].dev->UpdateNextAvail(qp->m_nextAvail);
 	#endif
 
@@ -646,87 +697,234 @@ void RdmaHw::ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate){
 	qp->m_rate = new_rate;
 }
 
+uint32_t RdmaHw::AllocMlxSlot(Ptr<RdmaQueuePair> q){
+	uint32_t s;
+	if (!m_mlx.freeSlot.empty()){
+		s = m_mlx.freeSlot.back();
+		m_mlx.freeSlot.pop_back();
+	}else{
+		s = m_mlx.qp.size();
+		m_mlx.qp.push_back(NULL);
+		m_mlx.alpha.push_back(1);
+		m_mlx.alphaCnp.push_back(false);
+		m_mlx.decreaseCnp.push_back(false);
+		m_mlx.incState.push_back(MLX_INC_OFF);
+		m_mlx.rpTimeStage.push_back(0);
+		m_mlx.alphaTs.push_back(0);
+		m_mlx.decreaseTs.push_back(0);
+		m_mlx.incTs.push_back(0);
+	}
+	m_mlx.qp[s] = q;
+	m_mlx.incState[s] = MLX_INC_OFF;
+	m_mlx.rpTimeStage[s] = 0;
+	q->mlx.m_slot = s;
+	return s;
+}
+void RdmaHw::FreeMlxSlot(Ptr<RdmaQueuePair> q){
+	if (q->mlx.m_first_cnp)
+		return; // never had a slot
+	m_mlx.qp[q->mlx.m_slot] = NULL; // its m_mlxTimer entries go stale
+	m_mlx.freeSlot.push_back(q->mlx.m_slot);
+}
+
+int64_t RdmaHw::GetMlxNextTs(uint32_t s){
+	int64_t t = INT64_MAX;
+	if (m_mlx.decreaseCnp[s]) // without a CNP the check does nothing
+		t = m_mlx.decreaseTs[s];
+	if (m_mlx.incState[s] == MLX_INC_ON)
+		t = std::min(t, m_mlx.incTs[s]);
+	return t;
+}
+void RdmaHw::ScheduleMlx(uint32_t s){
+	int64_t t = GetMlxNextTs(s);
+	if (t == INT64_MAX)
+		return;
+	m_mlxTimer.push(MlxTimer(t, std::make_pair(m_mlxTimerSeq++, s)));
+	if (m_mlxEvent.IsExpired() || (int64_t)m_mlxEvent.GetTs() > t){
+		Simulator::Cancel(m_mlxEvent);
+		m_mlxEvent = Simulator::Schedule(TimeStep(t) - Simulator::Now(), &RdmaHw::MlxTimerEvent, this);
+	}
+}
+void RdmaHw::MlxTimerEvent(){
+	int64_t now = Simulator::Now().GetTimeStep();
+	while (!m_mlxTimer.empty() && m_mlxTimer.top().first <= now){
+		MlxTimer e = m_mlxTimer.top();
+		m_mlxTimer.pop();
+		uint32_t s = e.second.second;
+		if (m_mlx.qp[s] == NULL || GetMlxNextTs(s) != e.first)
+			continue; // stale: the slot was freed or has run since this push
+		AdvanceMlx(s, now);
+		ScheduleMlx(s);
+	}
+	// wait for the next valid entry
+	while (!m_mlxTimer.empty()){
+		uint32_t s = m_mlxTimer.top().second.second;
+		if (m_mlx.qp[s] != NULL && GetMlxNextTs(s) == m_mlxTimer.top().first)
+			break;
+		m_mlxTimer.pop();
+	}
+	if (!m_mlxTimer.empty() && (m_mlxEvent.IsExpired() || (int64_t)m_mlxEvent.GetTs() > m_mlxTimer.top().first)){
+		Simulator::Cancel(m_mlxEvent);
+		m_mlxEvent = Simulator::Schedule(TimeStep(m_mlxTimer.top().first) - Simulator::Now(), &RdmaHw::MlxTimerEvent, this);
+	}
+}
+void RdmaHw::AdvanceMlx(uint32_t s, int64_t now, int64_t lead){
+	int64_t d = MicroSeconds(m_rateDecreaseInterval).GetTimeStep();
+	int64_t r = MicroSeconds(m_rpgTimeReset).GetTimeStep();
+	// the per-qp timers due at the same time ran in the order they were scheduled:
+	// the one with the longer interval first
+	bool incFirst = r > d;
+	while (true){
+		int64_t tDec = m_mlx.decreaseCnp[s] ? m_mlx.decreaseTs[s] : INT64_MAX;
+		int64_t tInc = m_mlx.incState[s] == MLX_INC_ON ? m_mlx.incTs[s] : INT64_MAX;
+		bool inc = tInc < tDec || (tInc == tDec && incFirst);
+		int64_t t = inc ? tInc : tDec;
+		if (t > now || (t == now && lead >= 0 && (inc ? r : d) <= lead))
+			break;
+		UpdateAlphaMlx(s, t); // the rate decrease is 1 ns after the alpha update
+		if (inc)
+			RateIncEventTimerMlx(s);
+		else
+			CheckRateDecreaseMlx(s);
+	}
+}
+void RdmaHw::RestartMlxIncrease(){
+	int64_t now = Simulator::Now().GetTimeStep();
+	int64_t r = MicroSeconds(m_rpgTimeReset).GetTimeStep();
+	for (uint32_t s = 0; s < m_mlx.qp.size(); s++){
+		if (m_mlx.qp[s] == NULL || m_mlx.incState[s] != MLX_INC_IDLE)
+			continue;
+		// the increases due by now would not have changed the rates, only counted the stage
+		if (m_mlx.incTs[s] <= now){
+			int64_t n = (now - m_mlx.incTs[s]) / r + 1;
+			m_mlx.incTs[s] += n * r;
+			m_mlx.rpTimeStage[s] += n;
+		}
+		m_mlx.incState[s] = MLX_INC_ON;
+		ScheduleMlx(s);
+	}
+}
+
 #define PRINT_LOG 0
 /******************************
  * Mellanox's version of DCQCN
  *****************************/
-void RdmaHw::UpdateAlphaMlx(Ptr<RdmaQueuePair> q){
-	#if PRINT_LOG
-	//std::cout << Simulator::Now() << " alpha update:" << m_node->GetId() << ' ' << q->mlx.m_alpha << ' ' << (int)q->mlx.m_alpha_cnp_arrived << '\n';
-	//printf("%lu alpha update: %08x %08x %u %u %.6lf->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_alpha);
-	#endif
-	if (q->mlx.m_alpha_cnp_arrived){
-		q->mlx.m_alpha = (1 - m_g)*q->mlx.m_alpha + m_g; 	//binary feedback
-	}else {
-		q->mlx.m_alpha = (1 - m_g)*q->mlx.m_alpha; 	//binary feedback
+void RdmaHw::UpdateAlphaMlx(uint32_t s, int64_t now){
+	while (m_mlx.alphaTs[s] <= now){
+		#if PRINT_LOG
+		//printf("%lu alpha update: %08x %08x %u %u %.6lf->", m_mlx.alphaTs[s], m_mlx.qp[s]->sip.Get(), m_mlx.qp[s]->dip.Get(), m_mlx.qp[s]->sport, m_mlx.qp[s]->dport, m_mlx.alpha[s]);
+		#endif
+		if (m_mlx.alphaCnp[s]){
+			m_mlx.alpha[s] = (1 - m_g)*m_mlx.alpha[s] + m_g; 	//binary feedback
+		}else {
+			m_mlx.alpha[s] = (1 - m_g)*m_mlx.alpha[s]; 	//binary feedback
+		}
+		#if PRINT_LOG
+		//printf("%.6lf\n", m_mlx.alpha[s]);
+		#endif
+		m_mlx.alphaCnp[s] = false; // clear the CNP_arrived bit
+		int64_t a = MicroSeconds(m_alpha_resume_interval).GetTimeStep();
+		if (m_mlx.alpha[s] == 0){ // stays 0 until the next CNP
+			m_mlx.alphaTs[s] += (now - m_mlx.alphaTs[s]) / a * a;
+		}
+		m_mlx.alphaTs[s] += a;
 	}
-	#if PRINT_LOG
-	//printf("%.6lf\n", q->mlx.m_alpha);
-	#endif
-	q->mlx.m_alpha_cnp_arrived = false; // clear the CNP_arrived bit
-	ScheduleUpdateAlphaMlx(q);
-}
-void RdmaHw::ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q){
-	q->mlx.m_eventUpdateAlpha = Simulator::Schedule(MicroSeconds(m_alpha_resume_interval), &RdmaHw::UpdateAlphaMlx, this, q);
 }
 
-void RdmaHw::cnp_received_mlx(Ptr<RdmaQueuePair> q){
-	q->mlx.m_alpha_cnp_arrived = true; // set CNP_arrived bit for alpha update
-	q->mlx.m_decrease_cnp_arrived = true; // set CNP_arrived bit for rate decrease
+void RdmaHw::cnp_received_mlx(Ptr<RdmaQueuePair> q, Time lead){
+	if (q->IsFinished())
+		return; // completed by this ACK, its timers are gone
+	int64_t now = Simulator::Now().GetTimeStep();
 	if (q->mlx.m_first_cnp){
+		uint32_t s = AllocMlxSlot(q);
 		// init alpha
-		q->mlx.m_alpha = 1;
-		q->mlx.m_alpha_cnp_arrived = false;
+		m_mlx.alpha[s] = 1;
+		m_mlx.alphaCnp[s] = false;
 		// schedule alpha update
-		ScheduleUpdateAlphaMlx(q);
+		m_mlx.alphaTs[s] = now + MicroSeconds(m_alpha_resume_interval).GetTimeStep();
 		// schedule rate decrease
-		ScheduleDecreaseRateMlx(q, 1); // add 1 ns to make sure rate decrease is after alpha update
+		m_mlx.decreaseCnp[s] = true; // set CNP_arrived bit for rate decrease
+		m_mlx.decreaseTs[s] = now + (MicroSeconds(m_rateDecreaseInterval) + NanoSeconds(1)).GetTimeStep(); // add 1 ns to make sure rate decrease is after alpha update
+		ScheduleMlx(s);
 		// set rate on first CNP
 		q->mlx.m_targetRate = q->m_rate = m_rateOnFirstCNP * q->m_rate;
 		q->mlx.m_first_cnp = false;
+		return;
+	}
+	uint32_t s = q->mlx.m_slot;
+	int64_t l = lead.GetTimeStep();
+	int64_t a = MicroSeconds(m_alpha_resume_interval).GetTimeStep();
+	int64_t d = MicroSeconds(m_rateDecreaseInterval).GetTimeStep();
+	int64_t next = GetMlxNextTs(s); // m_mlxTimer has an entry for it
+	// the timers due now that were scheduled before the arrival of the CNP run first
+	AdvanceMlx(s, now, l);
+	UpdateAlphaMlx(s, a > l ? now : now - 1);
+	m_mlx.alphaCnp[s] = true; // set CNP_arrived bit for alpha update
+	if (!m_mlx.decreaseCnp[s] && !(m_mlx.decreaseTs[s] == now + d && d <= l)){
+		// (otherwise a rate decrease ran now that came after the CNP with the per-qp timer, and took it)
+		// the checks without a CNP pending were skipped, find the next one
+		int64_t from = d > l ? now + 1 : now;
+		if (m_mlx.decreaseTs[s] < from)
+			m_mlx.decreaseTs[s] += (from - m_mlx.decreaseTs[s] + d - 1) / d * d;
+		m_mlx.decreaseCnp[s] = true; // set CNP_arrived bit for rate decrease
 	}
+	if (GetMlxNextTs(s) != next)
+		ScheduleMlx(s);
 }
 
-void RdmaHw::CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q){
-	ScheduleDecreaseRateMlx(q, 0);
-	if (q->mlx.m_decrease_cnp_arrived){
-		#if PRINT_LOG
-		printf("%lu rate dec: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-		#endif
-		bool clamp = true;
-		if (!m_EcnClampTgtRate){
-			if (q->mlx.m_rpTimeStage == 0)
-				clamp = false;
-		}
-		if (clamp)
-			q->mlx.m_targetRate = q->m_rate;
-		q->m_rate = std::max(m_minRate, q->m_rate * (1 - q->mlx.m_alpha / 2));
-		// reset rate increase related things
-		q->mlx.m_rpTimeStage = 0;
-		q->mlx.m_decrease_cnp_arrived = false;
-		// printf("%lu [Debug] Cancel rpTimer before reschedule: node:%u sip:%08x dip:%08x sport:%u dport:%u rpTimeStage:%u\n",
-		// 	Simulator::Now().GetTimeStep(), m_node->GetId(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_rpTimeStage);
-		Simulator::Cancel(q->mlx.m_rpTimer);
-		q->mlx.m_rpTimer = Simulator::Schedule(MicroSeconds(m_rpgTimeReset), &RdmaHw::RateIncEventTimerMlx, this, q);
-		#if PRINT_LOG
-		printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
-		#endif
+void RdmaHw::CheckRateDecreaseMlx(uint32_t s){
+	Ptr<RdmaQueuePair> q = m_mlx.qp[s];
+	m_mlx.decreaseTs[s] += MicroSeconds(m_rateDecreaseInterval).GetTimeStep();
+	#if PRINT_LOG
+	printf("%lu rate dec: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
+	bool clamp = true;
+	if (!m_EcnClampTgtRate){
+		if (m_mlx.rpTimeStage[s] == 0)
+			clamp = false;
 	}
-}
-void RdmaHw::ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta){
-	q->mlx.m_eventDecreaseRate = Simulator::Schedule(MicroSeconds(m_rateDecreaseInterval) + NanoSeconds(delta), &RdmaHw::CheckRateDecreaseMlx, this, q);
+	if (clamp)
+		q->mlx.m_targetRate = q->m_rate;
+	q->m_rate = std::max(m_minRate, q->m_rate * (1 - m_mlx.alpha[s] / 2));
+	// reset rate increase related things
+	m_mlx.rpTimeStage[s] = 0;
+	m_mlx.decreaseCnp[s] = false;
+	m_mlx.incState[s] = MLX_INC_ON;
+	m_mlx.incTs[s] = Simulator::Now().GetTimeStep() + MicroSeconds(m_rpgTimeReset).GetTimeStep();
+	#if PRINT_LOG
+	printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+	#endif
 }
 
-void RdmaHw::RateIncEventTimerMlx(Ptr<RdmaQueuePair> q){
-	q->mlx.m_rpTimer = Simulator::Schedule(MicroSeconds(m_rpgTimeReset), &RdmaHw::RateIncEventTimerMlx, this, q);
+void RdmaHw::RateIncEventTimerMlx(uint32_t s){
+	Ptr<RdmaQueuePair> q = m_mlx.qp[s];
+	m_mlx.incTs[s] += MicroSeconds(m_rpgTimeReset).GetTimeStep();
 	RateIncEventMlx(q);
-	q->mlx.m_rpTimeStage++;
+	m_mlx.rpTimeStage[s]++;
+	// a higher rate may open a variable window
+	if (m_var_win)
+		m_nic[GetNicIdxOfQp(q)].dev->m_rdmaEQ->WakeQp(q);
+	if (IsMlxIncreaseNoop(s))
+		m_mlx.incState[s] = MLX_INC_IDLE; // until the next rate decrease or RedistributeQp
+}
+bool RdmaHw::IsMlxIncreaseNoop(uint32_t s){
+	Ptr<RdmaQueuePair> q = m_mlx.qp[s];
+	if (m_mlx.rpTimeStage[s] <= m_rpgThreshold)
+		return false; // fast recovery or active increase to come
+	// all the coming increases are hyper increases, the same step as the next one
+	DataRate lineRate = m_nic[GetNicIdxOfQp(q)].dev->GetDataRate();
+	DataRate target = q->mlx.m_targetRate;
+	target += m_rhai;
+	if (target > lineRate)
+		target = lineRate;
+	return target == q->mlx.m_targetRate && (q->m_rate / 2) + (target / 2) == q->m_rate;
 }
 void RdmaHw::RateIncEventMlx(Ptr<RdmaQueuePair> q){
 	// check which increase phase: fast recovery, active increase, hyper increase
-	if (q->mlx.m_rpTimeStage < m_rpgThreshold){ // fast recovery
+	uint32_t stage = m_mlx.rpTimeStage[q->mlx.m_slot];
+	if (stage < m_rpgThreshold){ // fast recovery
 		FastRecoveryMlx(q);
-	}else if (q->mlx.m_rpTimeStage == m_rpgThreshold){ // active increase
+	}else if (stage == m_rpgThreshold){ // active increase
 		ActiveIncreaseMlx(q);
 	}else { // hyper increase
 		HyperIncreaseMlx(q);
@@ -819,8 +1017,12 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 			// check each hop
 			double U = 0;
 			uint64_t dt = 0;
-			bool updated[IntHeader::maxHop] = {false}, updated_any = false;
+			bool updated[IntHeader::maxHopLimit] = {false}, updated_any = false;
 			NS_ASSERT(ih.nhop <= IntHeader::maxHop);
+			// u and tau of all hops in one pass, the skipped hops are ignored below
+			double hopU[IntHeader::maxHopLimit];
+			uint64_t hopTau[IntHeader::maxHopLimit];
+			HpccIntCalc::ComputeU(ih.hop, &qp->hp.hop[0], ih.nhop, qp->m_max_rate.GetBitRate(), qp->m_win, hopU, hopTau);
 			for (uint32_t i = 0; i < ih.nhop; i++){
 				if (m_sampleFeedback){
 					if (ih.hop[i].GetQlen() == 0 && fast_react)
@@ -831,13 +1033,11 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 				if (print)
 					printf(" %u(%u) %lu(%lu) %lu(%lu)", ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen(), ih.hop[i].GetBytes(), qp->hp.hop[i].GetBytes(), ih.hop[i].GetTime(), qp->hp.hop[i].GetTime());
 				#endif
-				uint64_t tau = ih.hop[i].GetTimeDelta(qp->hp.hop[i]);;
-				double duration = tau * 1e-9;
-				double txRate = (ih.hop[i].GetBytesDelta(qp->hp.hop[i])) * 8 / duration;
-				double u = txRate / ih.hop[i].GetLineRate() + (double)std::min(ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen()) * qp->m_max_rate.GetBitRate() / ih.hop[i].GetLineRate() /qp->m_win;
+				uint64_t tau = hopTau[i];
+				double u = hopU[i];
 				#if PRINT_LOG
 				if (print)
-					printf(" %.3lf %.3lf", txRate, u);
+					printf(" %.3lf", u);
 				#endif
 				if (!m_multipleRate){
 					// for aggregate (single R)
@@ -849,15 +1049,15 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 					// for per hop (per hop R)
 					if (tau > qp->m_baseRtt)
 						tau = qp->m_baseRtt;
-					qp->hp.hopState[i].u = (qp->hp.hopState[i].u * (qp->m_baseRtt - tau) + u * tau) / double(qp->m_baseRtt);
+					qp->hp.hopU[i] = (qp->hp.hopU[i] * (qp->m_baseRtt - tau) + u * tau) / double(qp->m_baseRtt);
 				}
 				qp->hp.hop[i] = ih.hop[i];
 			}
 
 			DataRate new_rate;
 			int32_t new_incStage;
-			DataRate new_rate_per_hop[IntHeader::maxHop];
-			int32_t new_incStage_per_hop[IntHeader::maxHop];
+			DataRate new_rate_per_hop[IntHeader::maxHopLimit];
+			int32_t new_incStage_per_hop[IntHeader::maxHopLimit];
 			if (!m_multipleRate){
 				// for aggregate (single R)
 				if (updated_any){
@@ -891,13 +1091,13 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 				new_rate = qp->m_max_rate;
 				for (uint32_t i = 0; i < ih.nhop; i++){
 					if (updated[i]){
-						double c = qp->hp.hopState[i].u / m_targetUtil;
-						if (c >= 1 || qp->hp.hopState[i].incStage >= m_miThresh){
-							new_rate_per_hop[i] = qp->hp.hopState[i].Rc / c + m_rai;
+						double c = qp->hp.hopU[i] / m_targetUtil;
+						if (c >= 1 || qp->hp.hopIncStage[i] >= m_miThresh){
+							new_rate_per_hop[i] = qp->hp.hopRc[i] / c + m_rai;
 							new_incStage_per_hop[i] = 0;
 						}else{
-							new_rate_per_hop[i] = qp->hp.hopState[i].Rc + m_rai;
-							new_incStage_per_hop[i] = qp->hp.hopState[i].incStage+1;
+							new_rate_per_hop[i] = qp->hp.hopRc[i] + m_rai;
+							new_incStage_per_hop[i] = qp->hp.hopIncStage[i]+1;
 						}
 						// bound rate
 						if (new_rate_per_hop[i] < m_minRate)
@@ -909,15 +1109,15 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 							new_rate = new_rate_per_hop[i];
 						#if PRINT_LOG
 						if (print)
-							printf(" [%u]u=%.6lf c=%.3lf", i, qp->hp.hopState[i].u, c);
+							printf(" [%u]u=%.6lf c=%.3lf", i, qp->hp.hopU[i], c);
 						#endif
 						#if PRINT_LOG
 						if (print)
-							printf(" %.3lf->%.3lf", qp->hp.hopState[i].Rc.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
+							printf(" %.3lf->%.3lf", qp->hp.hopRc[i].GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
 						#endif
 					}else{
-						if (qp->hp.hopState[i].Rc < new_rate)
-							new_rate = qp->hp.hopState[i].Rc;
+						if (qp->hp.hopRc[i] < new_rate)
+							new_rate = qp->hp.hopRc[i];
 					}
 				}
 				#if PRINT_LOG
@@ -935,8 +1135,8 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 					// for per hop (per hop R)
 					for (uint32_t i = 0; i < ih.nhop; i++){
 						if (updated[i]){
-							qp->hp.hopState[i].Rc = new_rate_per_hop[i];
-							qp->hp.hopState[i].incStage = new_incStage_per_hop[i];
+							qp->hp.hopRc[i] = new_rate_per_hop[i];
+							qp->hp.hopIncStage[i] = new_incStage_per_hop[i];
 						}
 					}
 				}
@@ -1094,7 +1294,7 @@ void RdmaHw::SetPintSmplThresh(double p){
 }
 void RdmaHw::HandleAckHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
        uint32_t ack_seq = ch.ack.seq;
-       if (rand() % 65536 >= pint_smpl_thresh)
+       if (m_rng.GetNext16() >= pint_smpl_thresh)
                return;
        // update rate
        if (ack_seq > qp->hpccPint.m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
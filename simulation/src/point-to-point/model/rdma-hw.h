@@ -7,7 +7,9 @@
 #include <ns3/custom-header.h>
 #include "qbb-net-device.h"
 #include <unordered_map>
+#include <queue>
 #include "pint.h"
+#include "node-rng.h"
 #include "dci-switch-node.h"
 
 namespace ns3 {
@@ -75,10 +77,12 @@ public:
 
 	// call this function after the NIC is setup
 	void AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx);
+	void SetTableEntry(Ipv4Address &dstAddr, const std::vector<int> &intf_idx); // replace the entries of dstAddr, remove them if intf_idx is empty
 	void ClearTable();
 	void RedistributeQp();
 
 	Ptr<Packet> GetNxtPacket(Ptr<RdmaQueuePair> qp); // get next packet to send, inc snd_nxt
+	void BuildHeaderTemplate(Ptr<RdmaQueuePair> qp); // serialize the qp's data packet headers once
 	void PktSent(Ptr<RdmaQueuePair> qp, Ptr<Packet> pkt, Time interframeGap);
 	void UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t pkt_size);
 	void ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate);
@@ -95,26 +99,65 @@ public:
 	DataRate m_rai;		//< Rate of additive increase
 	DataRate m_rhai;		//< Rate of hyper-additive increase
 
+	// DCQCN state of the qps that have received a CNP, one slot per qp (qp->mlx.m_slot).
+	// Instead of three recurring timers per qp, one event serves whichever slot is due next:
+	// - alpha is updated lazily: the missed updates run when alpha is read or a CNP arrives
+	// - a rate decrease check only needs an event while a CNP is pending
+	// - the rate increase timer stops once increasing can no longer change the rates
+	// Each qp goes through the same steps at the same times as with its own timers; only
+	// the order against other events on the same nanosecond can differ. The state is per
+	// host, shared by the qps of all its NICs (m_nic), like the rest of RdmaHw.
+	// A CNP is ordered against the timers due at its arrival by when its receive event was
+	// scheduled (QbbNetDevice::GetRxScheduled), as the per-qp timer events were.
+	enum MlxIncState{
+		MLX_INC_OFF = 0, // not started: no rate decrease yet
+		MLX_INC_ON = 1,
+		MLX_INC_IDLE = 2 // stopped, the increases would not change the rates
+	};
+	struct MlxState{
+		std::vector<Ptr<RdmaQueuePair> > qp; // NULL for a free slot
+		std::vector<double> alpha;
+		std::vector<uint8_t> alphaCnp; // CNP arrived since the last alpha update
+		std::vector<uint8_t> decreaseCnp; // CNP arrived since the last rate decrease check
+		std::vector<uint8_t> incState; // MlxIncState
+		std::vector<uint32_t> rpTimeStage;
+		std::vector<int64_t> alphaTs, decreaseTs, incTs; // time of the next alpha update, rate decrease check and rate increase
+		std::vector<uint32_t> freeSlot;
+	} m_mlx;
+	typedef std::pair<int64_t, std::pair<uint64_t, uint32_t> > MlxTimer; // (time, (push order, slot))
+	std::priority_queue<MlxTimer, std::vector<MlxTimer>, std::greater<MlxTimer> > m_mlxTimer; // may hold stale entries
+	uint64_t m_mlxTimerSeq;
+	EventId m_mlxEvent; // at the time of the earliest m_mlxTimer entry
+	uint32_t AllocMlxSlot(Ptr<RdmaQueuePair> q);
+	void FreeMlxSlot(Ptr<RdmaQueuePair> q);
+	int64_t GetMlxNextTs(uint32_t s); // when slot s next needs the event, INT64_MAX if never
+	void ScheduleMlx(uint32_t s);
+	void MlxTimerEvent(); // run the due slots
+	// run the timers of slot s due by now, in the order the per-qp timers ran;
+	// with lead >= 0, those due now only if they were scheduled before an event scheduled lead ago
+	void AdvanceMlx(uint32_t s, int64_t now, int64_t lead = -1);
+	void RestartMlxIncrease(); // the line rate of the qps may have changed
+
 	// the Mellanox's version of alpha update:
-	// every fixed time slot, update alpha.
-	void UpdateAlphaMlx(Ptr<RdmaQueuePair> q);
-	void ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q);
+	// every fixed time slot, update alpha. Runs the updates of slot s due by now.
+	void UpdateAlphaMlx(uint32_t s, int64_t now);
 
 	// Mellanox's version of CNP receive
-	void cnp_received_mlx(Ptr<RdmaQueuePair> q);
+	// lead: how long ago the receive event of the CNP was scheduled, orders it against the timers due at the same time
+	void cnp_received_mlx(Ptr<RdmaQueuePair> q, Time lead);
 
 	// Mellanox's version of rate decrease
-	// It checks every m_rateDecreaseInterval if CNP arrived (m_decrease_cnp_arrived).
+	// It checks every m_rateDecreaseInterval if CNP arrived (decreaseCnp).
 	// If so, decrease rate, and reset all rate increase related things
-	void CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q);
-	void ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta);
+	void CheckRateDecreaseMlx(uint32_t s);
 
 	// Mellanox's version of rate increase
-	void RateIncEventTimerMlx(Ptr<RdmaQueuePair> q);
+	void RateIncEventTimerMlx(uint32_t s);
 	void RateIncEventMlx(Ptr<RdmaQueuePair> q);
 	void FastRecoveryMlx(Ptr<RdmaQueuePair> q);
 	void ActiveIncreaseMlx(Ptr<RdmaQueuePair> q);
 	void HyperIncreaseMlx(Ptr<RdmaQueuePair> q);
+	bool IsMlxIncreaseNoop(uint32_t s); // whether all the coming increases leave the rates unchanged
 
 	/***********************
 	 * High Precision CC
@@ -148,6 +191,7 @@ public:
 	 * HPCC-PINT
 	 ********************/
 	uint32_t pint_smpl_thresh;
+	NodeRng m_rng; // PINT sampling
 	void SetPintSmplThresh(double p);
 	void HandleAckHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
 	void UpdateRateHpPint(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react);
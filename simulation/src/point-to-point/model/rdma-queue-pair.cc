@@ -40,21 +40,18 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
 	m_var_win = false;
 	m_rate = 0;
 	m_nextAvail = Time(0);
-	mlx.m_alpha = 1;
-	mlx.m_alpha_cnp_arrived = false;
+	m_grpIdx = 0;
 	mlx.m_first_cnp = true;
-	mlx.m_decrease_cnp_arrived = false;
-	mlx.m_rpTimeStage = 0;
+	mlx.m_slot = 0;
 	hp.m_lastUpdateSeq = 0;
-	for (uint32_t i = 0; i < sizeof(hp.keep) / sizeof(hp.keep[0]); i++)
-		hp.keep[i] = 0;
+	hp.hop.resize(IntHeader::maxHop);
+	hp.keep.assign(IntHeader::maxHop, 0);
 	hp.m_incStage = 0;
 	hp.m_lastGap = 0;
 	hp.u = 1;
-	for (uint32_t i = 0; i < IntHeader::maxHop; i++){
-		hp.hopState[i].u = 1;
-		hp.hopState[i].incStage = 0;
-	}
+	hp.hopU.assign(IntHeader::maxHop, 1);
+	hp.hopRc.resize(IntHeader::maxHop);
+	hp.hopIncStage.assign(IntHeader::maxHop, 0);
 
 	tmly.m_lastUpdateSeq = 0;
 	tmly.m_incStage = 0;
@@ -226,6 +223,7 @@ TypeId RdmaQueuePairGroup::GetTypeId (void)
 }
 
 RdmaQueuePairGroup::RdmaQueuePairGroup(void){
+	m_version = 0;
 }
 
 uint32_t RdmaQueuePairGroup::GetN(void){
@@ -241,6 +239,7 @@ Ptr<RdmaQueuePair> RdmaQueuePairGroup::operator[](uint32_t idx){
 }
 
 void RdmaQueuePairGroup::AddQp(Ptr<RdmaQueuePair> qp){
+	qp->m_grpIdx = m_qps.size();
 	m_qps.push_back(qp);
 }
 
@@ -252,6 +251,7 @@ void RdmaQueuePairGroup::AddRxQp(Ptr<RdmaRxQueuePair> rxQp){
 
 void RdmaQueuePairGroup::Clear(void){
 	m_qps.clear();
+	m_version++;
 }
 
 }
@@ -8,6 +8,7 @@
 #include <ns3/event-id.h>
 #include <ns3/custom-header.h>
 #include <ns3/int-header.h>
+#include <ns3/raw-header.h>
 #include <vector>
 
 namespace ns3 {
@@ -26,12 +27,14 @@ public:
 	DataRate m_max_rate; // max rate
 	bool m_var_win; // variable window size
 	Time m_nextAvail;	//< Soonest time of next send
+	uint32_t m_grpIdx;	//< index in the RdmaQueuePairGroup, used by the egress scheduler
 	uint32_t wp; // current window of packets
 	uint32_t lastPktSize;
 	Callback<void> m_notifyAppFinish;
 
 	uint32_t flow_id; // [new]flow id, used for recording flow info
 	uint32_t trace_flow_id; // [new]trace flow id, used for debugging routing info
+	RawHeader m_hdrTemplate; // [new]pre-built ppp/ip/udp/SeqTs/INT headers of this qp's data packets
 
 	/******************************
 	 * runtime states
@@ -39,28 +42,21 @@ public:
 	DataRate m_rate;	//< Current rate
 	struct {
 		DataRate m_targetRate;	//< Target rate
-		EventId m_eventUpdateAlpha;
-		double m_alpha;
-		bool m_alpha_cnp_arrived; // indicate if CNP arrived in the last slot
 		bool m_first_cnp; // indicate if the current CNP is the first CNP
-		EventId m_eventDecreaseRate;
-		bool m_decrease_cnp_arrived; // indicate if CNP arrived in the last slot
-		uint32_t m_rpTimeStage;
-		EventId m_rpTimer;
+		uint32_t m_slot; // the rest of the DCQCN state is in RdmaHw::m_mlx[m_slot], set on the first CNP
 	} mlx;
 	struct {
 		uint32_t m_lastUpdateSeq;
 		DataRate m_curRate;
-		IntHop hop[IntHeader::maxHop];
-		uint32_t keep[IntHeader::maxHop];
+		std::vector<IntHop> hop; // sized to IntHeader::maxHop
+		std::vector<uint32_t> keep;
 		uint32_t m_incStage;
 		double m_lastGap;
 		double u;
-		struct {
-			double u;
-			DataRate Rc;
-			uint32_t incStage;
-		}hopState[IntHeader::maxHop];
+		// per hop state of the per hop R mode, sized to IntHeader::maxHop
+		std::vector<double> hopU;
+		std::vector<DataRate> hopRc;
+		std::vector<uint32_t> hopIncStage;
 	} hp;
 	struct{
 		uint32_t m_lastUpdateSeq;
@@ -135,6 +131,7 @@ public:
 class RdmaQueuePairGroup : public Object {
 public:
 	std::vector<Ptr<RdmaQueuePair> > m_qps;
+	uint32_t m_version; // bumped by Clear(), so the egress scheduler knows to rebuild
 	//std::vector<Ptr<RdmaRxQueuePair> > m_rxQps;
 
 	static TypeId GetTypeId (void);
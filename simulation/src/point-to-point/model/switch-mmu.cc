@@ -9,7 +9,6 @@
 #include "ns3/global-value.h"
 #include "ns3/boolean.h"
 #include "ns3/simulator.h"
-#include "ns3/random-variable.h"
 #include "switch-mmu.h"
 
 NS_LOG_COMPONENT_DEFINE("SwitchMmu");
@@ -28,16 +27,27 @@ namespace ns3 {
 
 		// headroom
 		shared_used_bytes = 0;
-		memset(hdrm_bytes, 0, sizeof(hdrm_bytes));
-		memset(ingress_bytes, 0, sizeof(ingress_bytes));
-		memset(paused, 0, sizeof(paused));
-		memset(egress_bytes, 0, sizeof(egress_bytes));
+		total_hdrm = 0;
+		total_rsrv = 0;
+	}
+
+	void SwitchMmu::InitPorts(uint32_t n_dev){
+		QueueCounter zero = {};
+		pfc_a_shift.assign(n_dev, 0);
+		headroom.assign(n_dev, 0);
+		kmin.assign(n_dev, 0);
+		kmax.assign(n_dev, 0);
+		pmax.assign(n_dev, 0);
+		hdrm_bytes.assign(n_dev, zero);
+		ingress_bytes.assign(n_dev, zero);
+		paused.assign(n_dev, zero);
+		egress_bytes.assign(n_dev, zero);
 	}
 	
 	bool SwitchMmu::CheckIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
 		if (psize + hdrm_bytes[port][qIndex] > headroom[port] && psize + GetSharedUsed(port, qIndex) > GetPfcThreshold(port)){
 			printf("%lu %u Drop: queue:%u,%u: Headroom full\n", Simulator::Now().GetTimeStep(), node_id, port, qIndex);
-			for (uint32_t i = 1; i < 64; i++)
+			for (uint32_t i = 1; i < 64 && i < hdrm_bytes.size(); i++)
 				printf("(%u,%u)", hdrm_bytes[i][3], ingress_bytes[i][3]);
 			printf("\n");
 			return false;
@@ -104,7 +114,7 @@ namespace ns3 {
 			return true;
 		if (egress_bytes[ifindex][qIndex] > kmin[ifindex]){
 			double p = pmax[ifindex] * double(egress_bytes[ifindex][qIndex] - kmin[ifindex]) / (kmax[ifindex] - kmin[ifindex]);
-			if (UniformVariable(0, 1).GetValue() < p)
+			if (m_rng.GetDouble() < p)
 				return true;
 		}
 		return false;
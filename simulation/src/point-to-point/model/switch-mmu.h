@@ -2,7 +2,10 @@
 #define SWITCH_MMU_H
 
 #include <unordered_map>
+#include <vector>
+#include <array>
 #include <ns3/node.h>
+#include "node-rng.h"
 
 namespace ns3 {
 
@@ -10,8 +13,8 @@ class Packet;
 
 class SwitchMmu: public Object{
 public:
-	static const uint32_t pCnt = 257;	// Number of ports used
 	static const uint32_t qCnt = 8;	// Number of queues/priorities used
+	typedef std::array<uint32_t, qCnt> QueueCounter;
 
 	static TypeId GetTypeId (void);
 
@@ -38,27 +41,29 @@ public:
 
 	void ConfigEcn(uint32_t port, uint32_t _kmin, uint32_t _kmax, double _pmax);
 	void ConfigHdrm(uint32_t port, uint32_t size);
+	void InitPorts(uint32_t n_dev); // size per-port state to the real device count (incl. dev 0), must be called before Config*
 	void ConfigNPort(uint32_t n_port);
 	void ConfigBufferSize(uint32_t size);
 
 	// config
 	uint32_t node_id;
+	NodeRng m_rng; // ECN marking
 	uint32_t buffer_size;
-	uint32_t pfc_a_shift[pCnt];
+	std::vector<uint32_t> pfc_a_shift;
 	uint32_t reserve;
-	uint32_t headroom[pCnt];
+	std::vector<uint32_t> headroom;
 	uint32_t resume_offset;
-	uint32_t kmin[pCnt], kmax[pCnt];
-	double pmax[pCnt];
+	std::vector<uint32_t> kmin, kmax;
+	std::vector<double> pmax;
 	uint32_t total_hdrm;
 	uint32_t total_rsrv;
 
 	// runtime
 	uint32_t shared_used_bytes;
-	uint32_t hdrm_bytes[pCnt][qCnt];
-	uint32_t ingress_bytes[pCnt][qCnt];
-	uint32_t paused[pCnt][qCnt];
-	uint32_t egress_bytes[pCnt][qCnt];
+	std::vector<QueueCounter> hdrm_bytes;
+	std::vector<QueueCounter> ingress_bytes;
+	std::vector<QueueCounter> paused;
+	std::vector<QueueCounter> egress_bytes;
 };
 
 } /* namespace ns3 */
@@ -44,19 +44,33 @@ TypeId SwitchNode::GetTypeId (void)
 }
 
 SwitchNode::SwitchNode(){
+	InitSwitch();
+}
+
+SwitchNode::SwitchNode(uint32_t systemId) : Node(systemId){
+	InitSwitch();
+}
+
+void SwitchNode::InitSwitch(){
 	m_ecmpSeed = m_id;
+	m_rng.SetStream(m_id, NodeRng::SWITCH);
 	m_node_type = 1;
 	m_mmu = CreateObject<SwitchMmu>(); // 创建交换机MMU
-	for (uint32_t i = 0; i < pCnt; i++)
-		for (uint32_t j = 0; j < pCnt; j++)
-			for (uint32_t k = 0; k < qCnt; k++)
-				m_bytes[i][j][k] = 0;
-	for (uint32_t i = 0; i < pCnt; i++)
-		m_txBytes[i] = 0;
-	for (uint32_t i = 0; i < pCnt; i++)
-		m_lastPktSize[i] = m_lastPktTs[i] = 0;
-	for (uint32_t i = 0; i < pCnt; i++)
-		m_u[i] = 0;
+	m_mmu->m_rng.SetStream(m_id, NodeRng::MMU);
+	m_nDev = 0;
+}
+
+void SwitchNode::InitPorts(){
+	uint32_t n = GetNDevices();
+	SwitchMmu::QueueCounter zero = {};
+	m_nDev = n;
+	m_bytes.assign(n * n, zero);
+	m_txBytes.assign(n, 0);
+	m_lastPktSize.assign(n, 0);
+	m_lastPktTs.assign(n, 0);
+	m_u.assign(n, 0);
+	m_pintCalc.assign(n, PintPortCalc());
+	m_mmu->InitPorts(n);
 }
 
 void SwitchNode::CheckAndSendPfc(uint32_t inDev, uint32_t qIndex){
@@ -135,7 +149,7 @@ void SwitchNode::SendToDev(Ptr<Packet>p, CustomHeader &ch){
 			}
 			CheckAndSendPfc(inDev, qIndex);
 		}
-		m_bytes[inDev][idx][qIndex] += p->GetSize();
+		m_bytes[inDev * m_nDev + idx][qIndex] += p->GetSize();
 		m_devices[idx]->SwitchSend(qIndex, p, ch);
 	}else
 		return; // Drop
@@ -188,6 +202,14 @@ void SwitchNode::AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx){
 	m_rtTable[dip].push_back(intf_idx);
 }
 
+void SwitchNode::SetTableEntry(Ipv4Address &dstAddr, const std::vector<int> &intf_idx){
+	uint32_t dip = dstAddr.Get();
+	if (intf_idx.empty())
+		m_rtTable.erase(dip);
+	else
+		m_rtTable[dip] = intf_idx;
+}
+
 void SwitchNode::ClearTable(){
 	m_rtTable.clear();
 }
@@ -207,32 +229,26 @@ void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Pack
 		uint32_t inDev = t.GetFlowId();
 		m_mmu->RemoveFromIngressAdmission(inDev, qIndex, p->GetSize());
 		m_mmu->RemoveFromEgressAdmission(ifIndex, qIndex, p->GetSize());
-		m_bytes[inDev][ifIndex][qIndex] -= p->GetSize();
+		m_bytes[inDev * m_nDev + ifIndex][qIndex] -= p->GetSize();
 		if (m_ecnEnabled){
 			bool egressCongested = m_mmu->ShouldSendCN(ifIndex, qIndex); // DCQCN的处理
-			if (egressCongested){
-				PppHeader ppp;
-				Ipv4Header h;
-				p->RemoveHeader(ppp);
-				p->RemoveHeader(h);
-				h.SetEcn((Ipv4Header::EcnType)0x03);
-				p->AddHeader(h);
-				p->AddHeader(ppp);
-			}
+			if (egressCongested) // 原地标记ECN CE
+				CustomHeader::SetIpv4EcnInBuffer(p->GetBuffer() + PppHeader::GetStaticSize(), 0x03);
 		}
 		//CheckAndSendPfc(inDev, qIndex);
 		CheckAndSendResume(inDev, qIndex);
 	}
 	if (1){
 		uint8_t* buf = p->GetBuffer();
-		if (buf[PppHeader::GetStaticSize() + 9] == 0x11){ // udp packet
+		const PacketHeaderDesc *desc = p->GetHeaderDesc();
+		if (desc != 0 ? desc->intOffset != 0 : buf[PppHeader::GetStaticSize() + 9] == 0x11){ // udp packet
 			// 修改已存在的INT header
 			// INT header的位置 = PPP header大小 + 20 (IPv4 header大小) + 8 (UDP header大小) + 6 (SeqTs header大小)
-			IntHeader *ih = (IntHeader*)&buf[PppHeader::GetStaticSize() + 20 + 8 + 6]; // ppp, ip, udp, SeqTs, INT // INT padding
+			IntHeader *ih = (IntHeader*)&buf[desc != 0 ? desc->intOffset : PppHeader::GetStaticSize() + 20 + 8 + 6]; // ppp, ip, udp, SeqTs, INT // INT padding
 			Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[ifIndex]);
 			// 修改INT header的内容
 			if (m_ccMode == 3){ // HPCC
-				ih->PushHop(Simulator::Now().GetTimeStep(), m_txBytes[ifIndex], dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
+				IntHeader::PushHopInBuffer((uint8_t*)ih, Simulator::Now().GetTimeStep(), m_txBytes[ifIndex], dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
 			}else if (m_ccMode == 10){ // HPCC-PINT
 				uint64_t t = Simulator::Now().GetTimeStep();
 				uint64_t dt = t - m_lastPktTs[ifIndex];
@@ -245,43 +261,8 @@ void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Pack
 				/**************************
 				 * approximate calc
 				 *************************/
-				int b = 20, m = 16, l = 20; // see log2apprx's paremeters
-				int sft = logres_shift(b,l);
-				double fct = 1<<sft; // (multiplication factor corresponding to sft)
-				double log_T = log2(m_maxRtt)*fct; // log2(T)*fct
-				double log_B = log2(B)*fct; // log2(B)*fct
-				double log_1e9 = log2(1e9)*fct; // log2(1e9)*fct
-				double qterm = 0;
-				double byteTerm = 0;
-				double uTerm = 0;
-				if ((qlen >> 8) > 0){
-					int log_dt = log2apprx(dt, b, m, l); // ~log2(dt)*fct
-					int log_qlen = log2apprx(qlen >> 8, b, m, l); // ~log2(qlen / 256)*fct
-					qterm = pow(2, (
-								log_dt + log_qlen + log_1e9 - log_B - 2*log_T
-								)/fct
-							) * 256;
-					// 2^((log2(dt)*fct+log2(qlen/256)*fct+log2(1e9)*fct-log2(B)*fct-2*log2(T)*fct)/fct)*256 ~= dt*qlen*1e9/(B*T^2)
-				}
-				if (m_lastPktSize[ifIndex] > 0){
-					int byte = m_lastPktSize[ifIndex];
-					int log_byte = log2apprx(byte, b, m, l);
-					byteTerm = pow(2, (
-								log_byte + log_1e9 - log_B - log_T
-								)/fct
-							);
-					// 2^((log2(byte)*fct+log2(1e9)*fct-log2(B)*fct-log2(T)*fct)/fct) ~= byte*1e9 / (B*T)
-				}
-				if (m_maxRtt > dt && m_u[ifIndex] > 0){
-					int log_T_dt = log2apprx(m_maxRtt - dt, b, m, l); // ~log2(T-dt)*fct
-					int log_u = log2apprx(int(round(m_u[ifIndex] * 8192)), b, m, l); // ~log2(u*512)*fct
-					uTerm = pow(2, (
-								log_T_dt + log_u - log_T
-								)/fct
-							) / 8192;
-					// 2^((log2(T-dt)*fct+log2(u*512)*fct-log2(T)*fct)/fct)/512 = (T-dt)*u/T
-				}
-				newU = qterm+byteTerm+uTerm;
+				// the log2apprx()/pow() form, with the logs of T and B cached per port
+				newU = m_pintCalc[ifIndex].Update(m_maxRtt, B, dt, qlen, m_lastPktSize[ifIndex], m_u[ifIndex], m_rng);
 
 				#if 0
 				/**************************
@@ -302,7 +283,7 @@ void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Pack
 				/************************
 				 * update PINT header
 				 ***********************/
-				uint16_t power = Pint::encode_u(newU);
+				uint16_t power = Pint::encode_u(newU, m_rng.GetNext16());
 				if (power > ih->GetPower())
 					ih->SetPower(power);
 
@@ -329,7 +310,7 @@ int SwitchNode::log2apprx(int x, int b, int m, int l){
 		x += + (1 << (msb - m - 1));
 		#else
 		int mask = (1 << (msb-m)) - 1;
-		if ((x0 & mask) > (rand() & mask))
+		if ((x0 & mask) > (int)(m_rng.GetNext32() & mask))
 			x += 1<<(msb-m);
 		#endif
 	}
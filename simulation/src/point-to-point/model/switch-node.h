@@ -6,25 +6,29 @@
 #include "qbb-net-device.h"
 #include "switch-mmu.h"
 #include "pint.h"
+#include "node-rng.h"
 
 namespace ns3 {
 
 class Packet;
 
 class SwitchNode : public Node{
-	static const uint32_t pCnt = 257;	// Number of ports used
 	static const uint32_t qCnt = 8;	// Number of queues/priorities used
 	uint32_t m_ecmpSeed;
+	NodeRng m_rng; // random rounding of PINT and log2apprx
 	std::unordered_map<uint32_t, std::vector<int> > m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)
 
 	// monitor of PFC
-	uint32_t m_bytes[pCnt][pCnt][qCnt]; // m_bytes[inDev][outDev][qidx] is the bytes from inDev enqueued for outDev at qidx
+	// per-port state is sized to the real device count in InitPorts()
+	uint32_t m_nDev;
+	std::vector<SwitchMmu::QueueCounter> m_bytes; // m_bytes[inDev*m_nDev+outDev][qidx] is the bytes from inDev enqueued for outDev at qidx
 	
-	uint64_t m_txBytes[pCnt]; // counter of tx bytes
+	std::vector<uint64_t> m_txBytes; // counter of tx bytes
 
-	uint32_t m_lastPktSize[pCnt];
-	uint64_t m_lastPktTs[pCnt]; // ns
-	double m_u[pCnt];
+	std::vector<uint32_t> m_lastPktSize;
+	std::vector<uint64_t> m_lastPktTs; // ns
+	std::vector<double> m_u;
+	std::vector<PintPortCalc> m_pintCalc; // approximate calc of m_u
 
 protected:
 	bool m_ecnEnabled;
@@ -39,18 +43,22 @@ private:
 	static uint32_t EcmpHash(const uint8_t* key, size_t len, uint32_t seed);
 	void CheckAndSendPfc(uint32_t inDev, uint32_t qIndex);
 	void CheckAndSendResume(uint32_t inDev, uint32_t qIndex);
+	void InitSwitch(); // shared by the constructors
 public:
 	Ptr<SwitchMmu> m_mmu;
 
 	static TypeId GetTypeId (void);
 	SwitchNode();
+	SwitchNode(uint32_t systemId); // [new] for distributed runs, systemId is the MPI rank owning the switch
+	void InitPorts(); // call after all links are installed, before configuring m_mmu
 	void SetEcmpSeed(uint32_t seed);
 	void AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx);
+	void SetTableEntry(Ipv4Address &dstAddr, const std::vector<int> &intf_idx); // replace the entries of dstAddr, remove them if intf_idx is empty
 	void ClearTable();
 	bool SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> packet, CustomHeader &ch);
 	void SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p);
 
-	// for approximate calc in PINT
+	// for approximate calc in PINT (the reference form of PintPortCalc)
 	int logres_shift(int b, int l);
 	int log2apprx(int x, int b, int m, int l); // given x of at most b bits, use most significant m bits of x, calc the result in l bits
 };
@@ -3,6 +3,16 @@
 #include "ns3/simulator.h"
 #include "ns3/point-to-point-net-device.h"
 #include "ns3/point-to-point-channel.h"
+#include "ns3/node-rng.h"
+#include "ns3/pint.h"
+#include "ns3/hpcc-int.h"
+#include "ns3/qbb-channel.h"
+#include "ns3/qbb-net-device.h"
+#include "ns3/custom-header.h"
+#include "ns3/boolean.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 namespace ns3 {
 
@@ -56,6 +66,336 @@ PointToPointTest::DoRun (void)
   Simulator::Destroy ();
 }
 //-----------------------------------------------------------------------------
+class NodeRngTest : public TestCase
+{
+public:
+  NodeRngTest ();
+
+  virtual void DoRun (void);
+};
+
+NodeRngTest::NodeRngTest ()
+  : TestCase ("Check that the per-node random streams are reproducible and independent")
+{
+}
+
+void
+NodeRngTest::DoRun (void)
+{
+  const uint32_t n = 10000;
+  NodeRng a, b, c;
+  a.SetStream (1, NodeRng::SWITCH);
+  b.SetStream (1, NodeRng::MMU);
+  c.SetStream (2, NodeRng::SWITCH);
+  std::vector<uint64_t> seq;
+  uint32_t same = 0;
+  double sum = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      // draws from other streams in between must not change the sequence of a
+      seq.push_back (a.GetNext64 ());
+      same += b.GetNext64 () == seq.back ();
+      same += c.GetNext64 () == seq.back ();
+      double d = b.GetDouble ();
+      NS_TEST_ASSERT_MSG_EQ ((d >= 0 && d < 1), true, "GetDouble out of [0, 1)");
+      NS_TEST_ASSERT_MSG_LT (c.GetNext16 (), 65536u, "GetNext16 out of range");
+      sum += d;
+    }
+  NS_TEST_ASSERT_MSG_EQ (same, 0, "streams of different owners or nodes overlap");
+  NS_TEST_ASSERT_MSG_EQ_TOL (sum / n, 0.5, 0.02, "GetDouble is not uniform");
+
+  a.SetStream (1, NodeRng::SWITCH);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (a.GetNext64 (), seq[i], "stream is not reproducible");
+    }
+}
+//-----------------------------------------------------------------------------
+class PintCalcTest : public TestCase
+{
+public:
+  PintCalcTest ();
+
+  virtual void DoRun (void);
+
+private:
+  // the log2()/pow() forms the tables replace
+  static int RefLog2apprx (int x, NodeRng &rng);
+  static double RefUpdate (uint64_t maxRtt, uint64_t B, uint64_t dt, uint64_t qlen, uint32_t byte, double u, NodeRng &rng);
+  static uint16_t RefEncodeU (double u, uint32_t rnd);
+};
+
+PintCalcTest::PintCalcTest ()
+  : TestCase ("Check that the table-driven PINT calc matches the log2() and pow() form bit for bit")
+{
+}
+
+int
+PintCalcTest::RefLog2apprx (int x, NodeRng &rng)
+{
+  int x0 = x, m = 16;
+  int msb = int (log2 (x)) + 1;
+  if (msb > m)
+    {
+      x = (x >> (msb - m) << (msb - m));
+      int mask = (1 << (msb - m)) - 1;
+      if ((x0 & mask) > (int)(rng.GetNext32 () & mask))
+        {
+          x += 1 << (msb - m);
+        }
+    }
+  return int (log2 (x) * (1 << 15));
+}
+
+double
+PintCalcTest::RefUpdate (uint64_t maxRtt, uint64_t B, uint64_t dt, uint64_t qlen, uint32_t byte, double u, NodeRng &rng)
+{
+  double fct = 1 << 15;
+  double log_T = log2 (maxRtt) * fct;
+  double log_B = log2 (B) * fct;
+  double log_1e9 = log2 (1e9) * fct;
+  double qterm = 0, byteTerm = 0, uTerm = 0;
+  if ((qlen >> 8) > 0)
+    {
+      int log_dt = RefLog2apprx (dt, rng);
+      int log_qlen = RefLog2apprx (qlen >> 8, rng);
+      qterm = pow (2, (log_dt + log_qlen + log_1e9 - log_B - 2 * log_T) / fct) * 256;
+    }
+  if (byte > 0)
+    {
+      int log_byte = RefLog2apprx (byte, rng);
+      byteTerm = pow (2, (log_byte + log_1e9 - log_B - log_T) / fct);
+    }
+  if (maxRtt > dt && u > 0)
+    {
+      int log_T_dt = RefLog2apprx (maxRtt - dt, rng);
+      int log_u = RefLog2apprx (int (round (u * 8192)), rng);
+      uTerm = pow (2, (log_T_dt + log_u - log_T) / fct) / 8192;
+    }
+  return qterm + byteTerm + uTerm;
+}
+
+uint16_t
+PintCalcTest::RefEncodeU (double u, uint32_t rnd)
+{
+  uint32_t u_toInt = ceil (u * Pint::max_concurrent);
+  if (u_toInt == 0)
+    {
+      u_toInt = 1;
+    }
+  double power = log (u_toInt) * Pint::log_factor;
+  uint16_t p_upper = ceil (power), p_lower = floor (power);
+  double upper = pow (Pint::log_base, p_upper), lower = pow (Pint::log_base, p_lower);
+  if (p_upper == p_lower)
+    {
+      upper *= Pint::log_base;
+    }
+  return (rnd < (u_toInt - lower) / (upper - lower) * 65536) ? p_upper : p_lower;
+}
+
+void
+PintCalcTest::DoRun (void)
+{
+  NodeRng in, a, b;
+  in.SetStream (0, NodeRng::SWITCH);
+  a.SetStream (1, NodeRng::SWITCH);
+  b.SetStream (1, NodeRng::SWITCH);
+  const uint64_t rates[] = { 1250000000ull, 3125000000ull, 12500000000ull, 50000000000ull };
+  const uint64_t rtts[] = { 9000, 100000, 5000000 };
+  PintPortCalc calc;
+  double u = 0;
+  for (uint32_t i = 0; i < 200000; i++)
+    {
+      // change the link now and then, so the cached logs must follow
+      uint64_t B = rates[(i / 1000) % 4];
+      uint64_t maxRtt = rtts[(i / 4000) % 3];
+      uint64_t dt = in.GetNext64 () % (maxRtt + 1);
+      uint64_t qlen = (in.GetNext32 () % 4 == 0) ? 0 : in.GetNext64 () >> (in.GetNext32 () % 64);
+      qlen %= 1ull << 38;
+      uint32_t byte = (i % 7 == 0) ? 0 : in.GetNext32 () % 9001;
+      double ref = RefUpdate (maxRtt, B, dt, qlen, byte, u, a);
+      double got = calc.Update (maxRtt, B, dt, qlen, byte, u, b);
+      NS_TEST_ASSERT_MSG_EQ (got, ref, "PintPortCalc::Update differs from the log2/pow form");
+      NS_TEST_ASSERT_MSG_EQ (a.GetNext64 (), b.GetNext64 (), "PintPortCalc::Update draws a different number of random numbers");
+      u = (i % 1000 == 0) ? 0 : ref;
+
+      double v = in.GetDouble () * 10;
+      uint32_t rnd = in.GetNext16 ();
+      NS_TEST_ASSERT_MSG_EQ (Pint::encode_u (v, rnd), RefEncodeU (v, rnd), "Pint::encode_u differs from the log/pow form");
+    }
+}
+//-----------------------------------------------------------------------------
+class HpccIntCalcTest : public TestCase
+{
+public:
+  HpccIntCalcTest ();
+
+  virtual void DoRun (void);
+};
+
+HpccIntCalcTest::HpccIntCalcTest ()
+  : TestCase ("Check that the HPCC per-hop utilization kernel matches RdmaHw::UpdateRateHp bit for bit")
+{
+}
+
+void
+HpccIntCalcTest::DoRun (void)
+{
+  NodeRng in;
+  in.SetStream (0, NodeRng::SWITCH);
+  const uint32_t multis[] = { 1, 64, 1000 }; // the larger ones wrap GetBytesDelta and GetQlen
+  uint32_t multi = IntHop::multi;
+  for (uint32_t m = 0; m < 3; m++)
+    {
+      IntHop::multi = multis[m];
+      for (uint32_t i = 0; i < 20000; i++)
+        {
+          IntHop hop[IntHeader::maxHopLimit], last[IntHeader::maxHopLimit];
+          for (uint32_t j = 0; j < IntHeader::maxHopLimit; j++)
+            {
+              uint64_t h = in.GetNext64 (), l = in.GetNext64 ();
+              std::memcpy (&hop[j], &h, sizeof (h));
+              std::memcpy (&last[j], &l, sizeof (l));
+            }
+          uint32_t n = in.GetNext32 () % (IntHeader::maxHopLimit + 1);
+          uint64_t maxRate = IntHop::lineRateValues[in.GetNext32 () % 8];
+          uint32_t win = in.GetNext32 () % 1000000 + 1;
+          double u[IntHeader::maxHopLimit];
+          uint64_t tau[IntHeader::maxHopLimit];
+          HpccIntCalc::ComputeU (hop, last, n, maxRate, win, u, tau);
+          for (uint32_t j = 0; j < n; j++)
+            {
+              // the form in UpdateRateHp before the kernel
+              uint64_t refTau = hop[j].GetTimeDelta (last[j]);
+              double duration = refTau * 1e-9;
+              double txRate = (hop[j].GetBytesDelta (last[j])) * 8 / duration;
+              double refU = txRate / hop[j].GetLineRate () + (double)std::min (hop[j].GetQlen (), last[j].GetQlen ()) * maxRate / hop[j].GetLineRate () / win;
+              NS_TEST_ASSERT_MSG_EQ (tau[j], refTau, "tau differs");
+              NS_TEST_ASSERT_MSG_EQ (std::memcmp (&u[j], &refU, sizeof (refU)), 0, "u differs"); // also NaN when tau is 0
+            }
+        }
+    }
+  IntHop::multi = multi;
+}
+//-----------------------------------------------------------------------------
+class QbbPacketTrainTest : public TestCase
+{
+public:
+  QbbPacketTrainTest ();
+
+  virtual void DoRun (void);
+
+private:
+  typedef std::vector<std::pair<int64_t, uint32_t> > RxTrace; // (time, packet size)
+
+  void Run (bool train, RxTrace &rxA, RxTrace &rxB, uint64_t &pending);
+  void Send (Ptr<QbbChannel> channel, Ptr<QbbNetDevice> src, uint32_t size, Time txTime);
+  void CountPending (void);
+  int ReceiveA (Ptr<Packet> p, CustomHeader &ch);
+  int ReceiveB (Ptr<Packet> p, CustomHeader &ch);
+
+  RxTrace *m_rxA;
+  RxTrace *m_rxB;
+  uint64_t m_pending;
+};
+
+QbbPacketTrainTest::QbbPacketTrainTest ()
+  : TestCase ("Check that a QbbChannel in PacketTrain mode delivers at the same times and in the same order")
+{
+}
+
+void
+QbbPacketTrainTest::Send (Ptr<QbbChannel> channel, Ptr<QbbNetDevice> src, uint32_t size, Time txTime)
+{
+  channel->TransmitStart (Create<Packet> (size), src, txTime);
+}
+
+void
+QbbPacketTrainTest::CountPending (void)
+{
+  m_pending = Simulator::GetPendingEventCount ();
+}
+
+int
+QbbPacketTrainTest::ReceiveA (Ptr<Packet> p, CustomHeader &ch)
+{
+  m_rxA->push_back (std::make_pair (Simulator::Now ().GetTimeStep (), p->GetSize ()));
+  return 0;
+}
+
+int
+QbbPacketTrainTest::ReceiveB (Ptr<Packet> p, CustomHeader &ch)
+{
+  m_rxB->push_back (std::make_pair (Simulator::Now ().GetTimeStep (), p->GetSize ()));
+  return 0;
+}
+
+void
+QbbPacketTrainTest::Run (bool train, RxTrace &rxA, RxTrace &rxB, uint64_t &pending)
+{
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<QbbNetDevice> devA = CreateObject<QbbNetDevice> ();
+  Ptr<QbbNetDevice> devB = CreateObject<QbbNetDevice> ();
+  Ptr<QbbChannel> channel = CreateObject<QbbChannel> ();
+  channel->SetAttribute ("Delay", TimeValue (MilliSeconds (1)));
+  channel->SetAttribute ("PacketTrain", BooleanValue (train));
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+  devA->Attach (channel);
+  devB->Attach (channel);
+  m_rxA = &rxA;
+  m_rxB = &rxB;
+  devA->m_rdmaReceiveCb = MakeCallback (&QbbPacketTrainTest::ReceiveA, this);
+  devB->m_rdmaReceiveCb = MakeCallback (&QbbPacketTrainTest::ReceiveB, this);
+
+  // back-to-back packets on both wires, the sizes tell them apart
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      Simulator::Schedule (MicroSeconds (i), &QbbPacketTrainTest::Send, this, channel, devA, 100 + i, MicroSeconds (1));
+    }
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Simulator::Schedule (MicroSeconds (i), &QbbPacketTrainTest::Send, this, channel, devB, 200 + i, MicroSeconds (1));
+    }
+  // arrives before the last packet of its wire: delivered on its own
+  Simulator::Schedule (NanoSeconds (9500), &QbbPacketTrainTest::Send, this, channel, devA, 300, Seconds (0));
+  Simulator::Schedule (MicroSeconds (20), &QbbPacketTrainTest::CountPending, this);
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+  pending = m_pending;
+}
+
+void
+QbbPacketTrainTest::DoRun (void)
+{
+  RxTrace rxA, rxB, trainA, trainB;
+  uint64_t pending, trainPending;
+  Run (false, rxA, rxB, pending);
+  Run (true, trainA, trainB, trainPending);
+
+  NS_TEST_ASSERT_MSG_EQ (rxB.size (), 11, "packets lost on the wire to b");
+  NS_TEST_ASSERT_MSG_EQ (rxA.size (), 3, "packets lost on the wire to a");
+  NS_TEST_ASSERT_MSG_EQ (rxB[9].second, 300, "the fallback packet does not overtake the last one");
+  NS_TEST_ASSERT_MSG_EQ (trainB.size (), rxB.size (), "PacketTrain lost packets on the wire to b");
+  NS_TEST_ASSERT_MSG_EQ (trainA.size (), rxA.size (), "PacketTrain lost packets on the wire to a");
+  for (uint32_t i = 0; i < rxB.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (trainB[i].first, rxB[i].first, "PacketTrain changes a receive time");
+      NS_TEST_ASSERT_MSG_EQ (trainB[i].second, rxB[i].second, "PacketTrain changes the receive order");
+    }
+  for (uint32_t i = 0; i < rxA.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (trainA[i].first, rxA[i].first, "PacketTrain changes a receive time");
+      NS_TEST_ASSERT_MSG_EQ (trainA[i].second, rxA[i].second, "PacketTrain changes the receive order");
+    }
+  // all sent, none received: one event per packet, or one per busy wire
+  // plus the fallback packet
+  NS_TEST_ASSERT_MSG_EQ (pending, 14, "one receive event per packet expected");
+  NS_TEST_ASSERT_MSG_EQ (trainPending, 3, "one receive event per busy wire expected");
+}
+//-----------------------------------------------------------------------------
 class PointToPointTestSuite : public TestSuite
 {
 public:
@@ -66,6 +406,10 @@ PointToPointTestSuite::PointToPointTestSuite ()
   : TestSuite ("devices-point-to-point", UNIT)
 {
   AddTestCase (new PointToPointTest);
+  AddTestCase (new NodeRngTest);
+  AddTestCase (new PintCalcTest);
+  AddTestCase (new HpccIntCalcTest);
+  AddTestCase (new QbbPacketTrainTest);
 }
 
 static PointToPointTestSuite g_pointToPointTestSuite;
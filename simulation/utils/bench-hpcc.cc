@@ -0,0 +1,95 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Microbenchmark of the per-hop utilization HPCC computes for every ACK
+ * (src/point-to-point/model/hpcc-int.h): the kernel the build selected
+ * (avx2, sse4.1 or scalar) against the scalar form, for --hops hops.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/node-rng.h"
+#include "ns3/hpcc-int.h"
+
+using namespace ns3;
+
+static const uint32_t nAcks = 1024; // INT sets cycled through, so they stay in cache like a qp's
+
+static double
+RunBench (bool scalar, std::vector<IntHop> &hop, std::vector<IntHop> &last, uint32_t hops, uint32_t n)
+{
+  double u[IntHeader::maxHopLimit];
+  uint64_t tau[IntHeader::maxHopLimit];
+  double sum = 0;
+  SystemWallClockMs time;
+  time.Start ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      uint32_t k = i % nAcks * IntHeader::maxHopLimit;
+      if (scalar)
+        {
+          HpccIntCalc::ComputeUScalar (&hop[k], &last[k], hops, 100000000000ull, 100000, u, tau);
+        }
+      else
+        {
+          HpccIntCalc::ComputeU (&hop[k], &last[k], hops, 100000000000ull, 100000, u, tau);
+        }
+      sum += u[0] + tau[hops - 1];
+    }
+  int64_t deltaMs = time.End ();
+  if (sum == 0.5)
+    {
+      std::cout << std::endl; // keep the results live
+    }
+  return deltaMs * 1e6 / n;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t n = 10000000;
+  uint32_t hops = 5;
+  CommandLine cmd;
+  cmd.AddValue ("n", "number of ACKs", n);
+  cmd.AddValue ("hops", "number of INT hops per ACK", hops);
+  cmd.Parse (argc, argv);
+  if (hops == 0 || hops > IntHeader::maxHopLimit)
+    {
+      std::cerr << "Error-- --hops must be in [1, " << IntHeader::maxHopLimit << "]" << std::endl;
+      return 1;
+    }
+
+  // random hop words: the time, bytes and qlen deltas cover their whole ranges
+  NodeRng rng;
+  rng.SetStream (0, NodeRng::SWITCH);
+  std::vector<IntHop> hop (nAcks * IntHeader::maxHopLimit), last (nAcks * IntHeader::maxHopLimit);
+  for (uint32_t i = 0; i < hop.size (); i++)
+    {
+      uint64_t h = rng.GetNext64 (), l = rng.GetNext64 ();
+      std::memcpy (&hop[i], &h, sizeof (h));
+      std::memcpy (&last[i], &l, sizeof (l));
+    }
+
+  std::cout << "Running bench-hpcc with n=" << n << " hops=" << hops << std::endl;
+  double vec = RunBench (false, hop, last, hops, n);
+  double sca = RunBench (true, hop, last, hops, n);
+  std::cout << vec << " ns/ack\t" << HpccIntCalc::GetKernelName () << std::endl;
+  std::cout << sca << " ns/ack\tscalar" << std::endl;
+  return 0;
+}
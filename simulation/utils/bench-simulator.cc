@@ -42,35 +42,72 @@ int g_fwidth = 6;
 class Bench 
 {
 public:
-  Bench (const uint32_t population, const uint32_t total)
-  : m_population (population),
+  Bench (const uint32_t population, const uint64_t total)
+  : m_farFraction (0),
+    m_population (population),
     m_total (total),
-    m_count (0)
+    m_count (0),
+    m_fifoStep (0),
+    m_scheduled (0),
+    m_lastTs (0),
+    m_lastSeq (0),
+    m_fifoErrors (0)
   { };
   
   void SetRandomStream (Ptr<RandomVariableStream> stream)
   {
     m_rand = stream;
   }
+
+  // a fraction of the events use the far stream instead (e.g. DCI link arrivals)
+  void SetFarStream (Ptr<RandomVariableStream> stream, double fraction)
+  {
+    m_far = stream;
+    m_farFraction = fraction;
+    m_coin = CreateObject<UniformRandomVariable> ();
+  }
     
   void SetPopulation (const uint32_t population)
   {
     m_population = population;
   }
     
-  void SetTotal (const uint32_t total)
+  void SetTotal (const uint64_t total)
   {
     m_total = total;
   }
+
+  // round the delays up to multiples of step ns, so that many events share
+  // a timestamp, and check that those run in scheduling order
+  void SetFifoCheck (uint32_t step)
+  {
+    m_fifoStep = step;
+  }
+
+  uint64_t GetFifoErrors (void) const
+  {
+    return m_fifoErrors;
+  }
     
   void RunBench (void);
 private:
   void Cb (void);
+  void FifoCb (uint64_t seq);
+  void ScheduleFifo (void);
+  Time NextDelay (void);
   
   Ptr<RandomVariableStream> m_rand;
+  Ptr<RandomVariableStream> m_far;
+  Ptr<UniformRandomVariable> m_coin;
+  double m_farFraction;
   uint32_t m_population;
-  uint32_t m_total;
-  uint32_t m_count;
+  uint64_t m_total;
+  uint64_t m_count;
+  uint32_t m_fifoStep;
+  uint64_t m_scheduled;
+  uint64_t m_lastTs;
+  uint64_t m_lastSeq;
+  uint64_t m_fifoErrors;
 };
 
 void
@@ -82,9 +119,18 @@ Bench::RunBench (void)
   DEB ("initializing");
 
   time.Start ();
+  m_count = 0;
+  m_scheduled = 0;
+  m_lastTs = 0;
+  m_lastSeq = 0;
   for (uint32_t i = 0; i < m_population; ++i)
     {
-      Time at = NanoSeconds (m_rand->GetValue ());
+      if (m_fifoStep > 0)
+        {
+          ScheduleFifo ();
+          continue;
+        }
+      Time at = NextDelay ();
       Simulator::Schedule (at, &Bench::Cb, this);
     }
   init = time.End ();
@@ -118,11 +164,53 @@ Bench::Cb (void)
     }
   DEB ("event at " << Simulator::Now ().GetSeconds () << "s");
 
-  Time after = NanoSeconds (m_rand->GetValue ());
+  Time after = NextDelay ();
   Simulator::Schedule (after, &Bench::Cb, this);
   ++m_count;
 }
 
+void
+Bench::ScheduleFifo (void)
+{
+  uint64_t ns = NanoSeconds (1).GetTimeStep ();
+  uint64_t delay = NextDelay ().GetTimeStep () / ns / m_fifoStep + 1;
+  Simulator::Schedule (NanoSeconds (delay * m_fifoStep), &Bench::FifoCb, this, m_scheduled++);
+}
+
+void
+Bench::FifoCb (uint64_t seq)
+{
+  // same timestamp: the event scheduled first must run first
+  uint64_t now = Simulator::Now ().GetTimeStep ();
+  if (now == m_lastTs && seq < m_lastSeq)
+    {
+      if (m_fifoErrors == 0)
+        {
+          LOGME ("FIFO order broken after " << m_count << " events: event #" << seq
+                 << " runs after event #" << m_lastSeq << " at " << now);
+        }
+      ++m_fifoErrors;
+    }
+  m_lastTs = now;
+  m_lastSeq = seq;
+  if (m_count > m_total)
+    {
+      return;
+    }
+  ScheduleFifo ();
+  ++m_count;
+}
+
+Time
+Bench::NextDelay (void)
+{
+  if (m_farFraction > 0 && m_coin->GetValue () < m_farFraction)
+    {
+      return NanoSeconds (m_far->GetValue ());
+    }
+  return NanoSeconds (m_rand->GetValue ());
+}
+
 
 Ptr<RandomVariableStream>
 GetRandomStream (std::string filename)
@@ -183,14 +271,19 @@ int main (int argc, char *argv[])
 {
 
   bool schedCal  = false;
+  bool schedCal2 = false;
   bool schedHeap = false;
   bool schedList = false;
   bool schedMap  = true;
 
   uint32_t pop   =  100000;
-  uint32_t total = 1000000;
+  uint64_t total = 1000000;
   uint32_t runs  =       1;
   std::string filename = "";
+  bool dciMix = false;
+  double dciFrac = 0.3;
+  double dciDelay = 10000000;
+  uint32_t fifo = 0;
   
   CommandLine cmd;
   cmd.Usage ("Benchmark the simulator scheduler.\n"
@@ -200,8 +293,22 @@ int main (int argc, char *argv[])
              "  an ascii file, given by the --file=\"<filename>\" argument,\n"
              "  or standard input, by the argument --file=\"-\"\n"
              "In the case of either --file form, the input is expected\n"
-             "to be ascii, giving the relative event times in ns.");
+             "to be ascii, giving the relative event times in ns.\n"
+             "\n"
+             "--dci replays the event mix of the multi-DC (e.g. 8DC) runs:\n"
+             "intra-DC events exponential with mean 1 us, and a fraction\n"
+             "--dcifrac of the events arriving after the DCI link delay\n"
+             "--dcidelay (default 10 ms) plus up to 1 us of jitter.\n"
+             "\n"
+             "--fifo=<ns> rounds the event times up to multiples of <ns>, so\n"
+             "that many events share a timestamp, and checks that those run in\n"
+             "scheduling order. With --total above 2^32 this is the regression\n"
+             "test for event uid wrap-around, e.g.\n"
+             "  --fifo=1000 --total=4300000000 --runs=0\n"
+             "(--runs=0 only does the priming run). The exit code is non-zero\n"
+             "if the order is broken.");
   cmd.AddValue ("cal",   "use CalendarSheduler",          schedCal);
+  cmd.AddValue ("cal2",  "use TwoLevelCalendarScheduler", schedCal2);
   cmd.AddValue ("heap",  "use HeapScheduler",             schedHeap);
   cmd.AddValue ("list",  "use ListSheduler",              schedList);
   cmd.AddValue ("map",   "use MapScheduler (default)",    schedMap);
@@ -211,12 +318,17 @@ int main (int argc, char *argv[])
   cmd.AddValue ("runs",  "number of runs (default 1)",    runs);
   cmd.AddValue ("file",  "file of relative event times",  filename);
   cmd.AddValue ("prec",  "printed output precision",      g_fwidth);
+  cmd.AddValue ("dci",   "replay the multi-DC event mix", dciMix);
+  cmd.AddValue ("dcifrac",  "fraction of DCI events with --dci (default 0.3)",   dciFrac);
+  cmd.AddValue ("dcidelay", "DCI link delay in ns with --dci (default 1E7)",     dciDelay);
+  cmd.AddValue ("fifo",  "check the order of simultaneous events, times rounded to this many ns", fifo);
   cmd.Parse (argc, argv);
   g_me = cmd.GetName () + ": ";
   g_fwidth += 6;  // 5 extra chars in '2.000002e+07 ': . e+0 _
 
   ObjectFactory factory ("ns3::MapScheduler");
   if (schedCal)  { factory.SetTypeId ("ns3::CalendarScheduler"); }
+  if (schedCal2) { factory.SetTypeId ("ns3::TwoLevelCalendarScheduler"); }
   if (schedHeap) { factory.SetTypeId ("ns3::HeapScheduler");     }
   if (schedList) { factory.SetTypeId ("ns3::ListScheduler");     }  
   Simulator::SetScheduler (factory);
@@ -230,7 +342,26 @@ int main (int argc, char *argv[])
   LOGME ("runs: " << runs);
   
   Bench *bench = new Bench (pop, total);
-  bench->SetRandomStream (GetRandomStream (filename));
+  if (dciMix)
+    {
+      LOGME ("using multi-DC event mix, DCI fraction " << dciFrac << ", DCI delay " << dciDelay << " ns");
+      Ptr<ExponentialRandomVariable> erv = CreateObject<ExponentialRandomVariable> ();
+      erv->SetAttribute ("Mean", DoubleValue (1000));
+      bench->SetRandomStream (erv);
+      Ptr<UniformRandomVariable> urv = CreateObject<UniformRandomVariable> ();
+      urv->SetAttribute ("Min", DoubleValue (dciDelay));
+      urv->SetAttribute ("Max", DoubleValue (dciDelay + 1000));
+      bench->SetFarStream (urv, dciFrac);
+    }
+  else
+    {
+      bench->SetRandomStream (GetRandomStream (filename));
+    }
+  if (fifo > 0)
+    {
+      LOGME ("checking the order of simultaneous events, event times rounded to " << fifo << " ns");
+      bench->SetFifoCheck (fifo);
+    }
 
   // table header
   LOG ("");
@@ -270,5 +401,10 @@ int main (int argc, char *argv[])
     }
 
   LOG ("");
+  if (bench->GetFifoErrors () > 0)
+    {
+      LOGME ("FIFO order broken " << bench->GetFifoErrors () << " times");
+      return 1;
+    }
   return 0;
 }
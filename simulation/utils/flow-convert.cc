@@ -0,0 +1,247 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "ns3/core-module.h"
+#include "ns3/flow-format.h"
+
+using namespace ns3;
+
+
+std::string g_me;
+#define LOG(x)   std::cout << x << std::endl
+#define LOGME(x) LOG (g_me << x)
+#define ERR(x)   std::cerr << g_me << x << std::endl
+
+static bool
+FlowBefore (const FlowFormat &a, const FlowFormat &b)
+{
+  return a.startTime < b.startTime;
+}
+
+// next line that is not blank or a # comment, as in third's SkipComments
+static bool
+NextLine (std::istream &is, std::string &line, uint64_t &lineNo)
+{
+  while (std::getline (is, line))
+    {
+      ++lineNo;
+      size_t start = line.find_first_not_of (" \t\r\n");
+      if (start != std::string::npos && line[start] != '#')
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+// read a traffic_gen text flow file
+static bool
+ReadText (const std::string &name, std::vector<FlowFormat> &flows, uint32_t &maxId)
+{
+  std::ifstream in (name.c_str ());
+  if (!in.is_open ())
+    {
+      ERR ("can not open " << name);
+      return false;
+    }
+  std::string line;
+  uint64_t lineNo = 0;
+  uint64_t count;
+  if (!NextLine (in, line, lineNo) || sscanf (line.c_str (), "%" SCNu64, &count) != 1)
+    {
+      ERR (name << ": missing the flow count");
+      return false;
+    }
+  if (count > 0xffffffffu)
+    {
+      ERR (name << ": " << count << " flows, at most 2^32-1 are supported");
+      return false;
+    }
+  flows.clear ();
+  flows.reserve (count);
+  maxId = 0;
+  for (uint64_t i = 0; i < count; ++i)
+    {
+      FlowFormat f;
+      memset (&f, 0, sizeof (f));
+      unsigned pg, dport;
+      if (!NextLine (in, line, lineNo)
+          || sscanf (line.c_str (), "%u %u %u %u %" SCNu64 " %lf",
+                     &f.src, &f.dst, &pg, &dport, &f.size, &f.startTime) != 6)
+        {
+          ERR (name << ":" << lineNo << ": can not read flow #" << i << " of " << count);
+          return false;
+        }
+      if (pg > 0xffff || dport > 0xffff)
+        {
+          ERR (name << ":" << lineNo << ": pg or dport above 65535");
+          return false;
+        }
+      f.pg = pg;
+      f.dport = dport;
+      maxId = std::max (maxId, std::max (f.src, f.dst));
+      flows.push_back (f);
+    }
+  return true;
+}
+
+// check a binary flow file, returns the number of problems found
+static uint64_t
+Check (const std::string &name, bool print)
+{
+  FlowFileReader reader;
+  const char *err = reader.Open (name.c_str ());
+  if (err != NULL)
+    {
+      ERR (name << ": " << err);
+      return 1;
+    }
+  const FlowFileHeader &h = reader.GetHeader ();
+  uint64_t problems = 0;
+  if (h.flowCount > 0xffffffffu)
+    {
+      ERR (name << ": " << h.flowCount << " flows, at most 2^32-1 are supported");
+      ++problems;
+    }
+  if (print)
+    {
+      LOG (h.flowCount);
+    }
+  for (uint64_t i = 0; i < reader.GetN (); ++i)
+    {
+      const FlowFormat &f = reader.Get (i);
+      if (f.src >= h.hostCount || f.dst >= h.hostCount)
+        {
+          ERR ("flow #" << i << ": node id above the host count " << h.hostCount);
+          ++problems;
+        }
+      if (f.src == f.dst)
+        {
+          ERR ("flow #" << i << ": source and destination are both " << f.src);
+          ++problems;
+        }
+      if (f.size == 0)
+        {
+          ERR ("flow #" << i << ": empty flow");
+          ++problems;
+        }
+      if (!(f.startTime >= 0) || (i > 0 && f.startTime < reader.Get (i - 1).startTime))
+        {
+          ERR ("flow #" << i << ": start time " << f.startTime << " is not sorted");
+          ++problems;
+        }
+      if (print)
+        {
+          printf ("%u %u %u %u %" PRIu64 " %.9f\n", f.src, f.dst, f.pg, f.dport, f.size, f.startTime);
+        }
+    }
+  if (!print)
+    {
+      LOGME (name << ": " << h.flowCount << " flows, " << h.hostCount << " hosts, "
+             << problems << " problems");
+    }
+  return problems;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string in = "";
+  std::string out = "";
+  std::string check = "";
+  uint32_t hosts = 0;
+  bool print = false;
+
+  CommandLine cmd;
+  cmd.Usage ("Convert a text flow file of traffic_gen to the binary flow file\n"
+             "read by third (see src/point-to-point/model/flow-format.h),\n"
+             "or check a binary flow file.\n"
+             "\n"
+             "  --in=traffic.txt --out=traffic.bin [--hosts=N]\n"
+             "      converts, sorting the flows by start time, then checks the output.\n"
+             "      The host count defaults to the largest node id + 1.\n"
+             "  --check=traffic.bin [--print]\n"
+             "      checks the header and the records (node ids, sizes, order);\n"
+             "      --print writes the flows to stdout in the text format.\n"
+             "\n"
+             "The exit code is non-zero if a problem is found.");
+  cmd.AddValue ("in",    "text flow file to convert",                    in);
+  cmd.AddValue ("out",   "binary flow file to write",                    out);
+  cmd.AddValue ("hosts", "host count of the header (default max id + 1)", hosts);
+  cmd.AddValue ("check", "binary flow file to check",                    check);
+  cmd.AddValue ("print", "with --check, print the flows as text",        print);
+  cmd.Parse (argc, argv);
+  g_me = cmd.GetName () + ": ";
+
+  if (check != "")
+    {
+      return Check (check, print) > 0 ? 1 : 0;
+    }
+  if (in == "" || out == "")
+    {
+      ERR ("needs --in and --out, or --check; see --help");
+      return 1;
+    }
+
+  std::vector<FlowFormat> flows;
+  uint32_t maxId;
+  if (!ReadText (in, flows, maxId))
+    {
+      return 1;
+    }
+  if (hosts == 0)
+    {
+      hosts = flows.empty () ? 0 : maxId + 1;
+    }
+  else if (!flows.empty () && maxId >= hosts)
+    {
+      ERR (in << ": node id " << maxId << " is not below --hosts=" << hosts);
+      return 1;
+    }
+  if (!std::is_sorted (flows.begin (), flows.end (), FlowBefore))
+    {
+      LOGME (in << ": flows are not sorted by start time, sorting");
+      std::stable_sort (flows.begin (), flows.end (), FlowBefore);
+    }
+
+  FlowFileHeader h;
+  InitFlowFileHeader (h, flows.size (), hosts);
+  FILE *f = fopen (out.c_str (), "wb");
+  if (f == NULL)
+    {
+      ERR ("can not create " << out);
+      return 1;
+    }
+  bool ok = fwrite (&h, sizeof (h), 1, f) == 1;
+  if (!flows.empty ())
+    {
+      ok = ok && fwrite (&flows[0], sizeof (FlowFormat), flows.size (), f) == flows.size ();
+    }
+  ok = fclose (f) == 0 && ok;
+  if (!ok)
+    {
+      ERR ("can not write " << out);
+      return 1;
+    }
+  LOGME (in << " -> " << out << ": " << flows.size () << " flows, " << hosts << " hosts");
+  return Check (out, false) > 0 ? 1 : 0;
+}
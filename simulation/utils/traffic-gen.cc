@@ -0,0 +1,424 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Native version of traffic_gen/traffic_gen_only_for_interDC.py (and of
+ * traffic_gen.py, traffic_gen_only_for_interDC_specify2dc.py).
+ *
+ * Each source host sends flows with Poisson inter-arrival times and sizes
+ * drawn from a flow size CDF. A flow at t is kept if the next arrival of its
+ * host is still within --time, as in the python scripts. Every source host has
+ * its own RngStream (stream = host id, substream = --run), so the output only
+ * depends on --seed and --run, not on --threads. The hosts are split among
+ * the threads, each thread sorts its flows, and the sorted lists are merged
+ * by (start time, source host) into the text flow file or the binary one of
+ * src/point-to-point/model/flow-format.h.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <vector>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "ns3/core-module.h"
+#include "ns3/rng-stream.h"
+#include "ns3/system-thread.h"
+#include "ns3/flow-format.h"
+
+using namespace ns3;
+
+
+std::string g_me;
+#define LOG(x)   std::cout << x << std::endl
+#define LOGME(x) LOG (g_me << x)
+#define ERR(x)   std::cerr << g_me << x << std::endl
+
+// first flow at 2 s, as base_t of the python scripts
+static const uint64_t BASE_NS = 2000000000;
+
+struct GenFlow
+{
+  uint64_t t;                           // start time (ns)
+  uint64_t size;
+  uint32_t src, dst;
+};
+
+static bool
+FlowBefore (const GenFlow &a, const GenFlow &b)
+{
+  return a.t < b.t || (a.t == b.t && a.src < b.src);
+}
+
+// flow size CDF of traffic_gen/custom_rand.py: "<size> <percentile>" lines
+class FlowSizeCdf
+{
+public:
+  bool Load (const std::string &name)
+  {
+    std::ifstream in (name.c_str ());
+    double x, y;
+    while (in >> x >> y)
+      {
+        m_x.push_back (x);
+        m_y.push_back (y);
+      }
+    if (m_x.size () < 2 || m_y.front () != 0 || m_y.back () != 100)
+      {
+        return false;
+      }
+    for (uint32_t i = 1; i < m_x.size (); ++i)
+      {
+        if (m_y[i] <= m_y[i - 1] || m_x[i] <= m_x[i - 1])
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+  double GetAvg (void) const
+  {
+    double s = 0;
+    for (uint32_t i = 1; i < m_x.size (); ++i)
+      {
+        s += (m_x[i] + m_x[i - 1]) / 2.0 * (m_y[i] - m_y[i - 1]);
+      }
+    return s / 100;
+  }
+  double GetValueFromPercentile (double y) const
+  {
+    uint32_t i = std::lower_bound (m_y.begin () + 1, m_y.end (), y) - m_y.begin ();
+    return m_x[i - 1] + (m_x[i] - m_x[i - 1]) / (m_y[i] - m_y[i - 1]) * (y - m_y[i - 1]);
+  }
+private:
+  std::vector<double> m_x, m_y;
+};
+
+struct GenConfig
+{
+  const FlowSizeCdf *cdf;
+  double interArrival;                  // mean, ns
+  uint64_t endNs;
+  uint32_t nhost;
+  uint32_t dcCount;
+  uint32_t dcNodes;
+  int32_t srcDc;                        // -1: all
+  int32_t dstDc;                        // -1: any other DC
+  uint32_t seed;
+  uint64_t run;
+};
+
+class GenThread
+{
+public:
+  GenThread (const GenConfig *cfg, uint32_t first, uint32_t last)
+    : m_cfg (cfg), m_first (first), m_last (last)
+  {
+  }
+  void Run (void);
+  std::vector<GenFlow> m_flows;
+private:
+  uint64_t Poisson (RngStream &rng) const
+  {
+    return (uint64_t)(-std::log (1 - rng.RandU01 ()) * m_cfg->interArrival);
+  }
+  uint32_t RandInt (RngStream &rng, uint32_t n) const
+  {
+    return std::min ((uint32_t)(rng.RandU01 () * n), n - 1);
+  }
+  uint32_t GetDst (RngStream &rng, uint32_t src) const;
+
+  const GenConfig *m_cfg;
+  uint32_t m_first, m_last;             // source hosts [m_first, m_last)
+};
+
+uint32_t
+GenThread::GetDst (RngStream &rng, uint32_t src) const
+{
+  const GenConfig &c = *m_cfg;
+  if (c.dcCount <= 1)
+    {
+      // traffic_gen.py: any other host
+      uint32_t dst = RandInt (rng, c.nhost - 1);
+      return dst >= src ? dst + 1 : dst;
+    }
+  uint32_t dstDc;
+  if (c.dstDc >= 0)
+    {
+      dstDc = c.dstDc;
+    }
+  else
+    {
+      // a random other DC
+      uint32_t srcDc = src / c.dcNodes;
+      dstDc = RandInt (rng, c.dcCount - 1);
+      dstDc = dstDc >= srcDc ? dstDc + 1 : dstDc;
+    }
+  return dstDc * c.dcNodes + RandInt (rng, c.dcNodes);
+}
+
+void
+GenThread::Run (void)
+{
+  const GenConfig &c = *m_cfg;
+  for (uint32_t src = m_first; src < m_last; ++src)
+    {
+      RngStream rng (c.seed, src, c.run);
+      uint64_t t = BASE_NS + Poisson (rng);
+      while (true)
+        {
+          uint64_t next = t + Poisson (rng);
+          if (next > c.endNs)
+            {
+              break;
+            }
+          GenFlow f;
+          f.t = t;
+          f.src = src;
+          f.dst = GetDst (rng, src);
+          int64_t size = (int64_t)c.cdf->GetValueFromPercentile (rng.RandU01 () * 100);
+          f.size = size <= 0 ? 1 : size;
+          m_flows.push_back (f);
+          t = next;
+        }
+    }
+  std::stable_sort (m_flows.begin (), m_flows.end (), FlowBefore);
+}
+
+static double
+TranslateBandwidth (const std::string &b)
+{
+  if (b.empty ())
+    {
+      return -1;
+    }
+  double scale = 1;
+  switch (b[b.size () - 1])
+    {
+    case 'G': scale = 1e9; break;
+    case 'M': scale = 1e6; break;
+    case 'K': scale = 1e3; break;
+    }
+  char *end;
+  std::string num = scale == 1 ? b : b.substr (0, b.size () - 1);
+  double v = strtod (num.c_str (), &end);
+  return *end == 0 && v > 0 ? v * scale : -1;
+}
+
+// entry of the k-way merge: <flow, thread>
+typedef std::pair<const GenFlow *, uint32_t> MergeEntry;
+struct MergeAfter
+{
+  bool operator () (const MergeEntry &a, const MergeEntry &b) const
+  {
+    return FlowBefore (*b.first, *a.first);
+  }
+};
+
+int main (int argc, char *argv[])
+{
+  std::string cdfFile = "";
+  uint32_t nhost = 0;
+  double load = 0.3;
+  std::string bandwidth = "10G";
+  double time = 10;
+  std::string output = "tmp_traffic.txt";
+  uint32_t dcCount = 1;
+  uint32_t dcNodes = 0;
+  int32_t srcDc = -1;
+  int32_t dstDc = -1;
+  uint32_t threads = 1;
+  uint32_t seed = 1;
+  uint64_t run = 0;
+  bool binary = false;
+
+  CommandLine cmd;
+  cmd.Usage ("Generate a flow file, as traffic_gen/traffic_gen_only_for_interDC.py.\n"
+             "\n"
+             "  --cdf=flowCDF/WebSearch_distribution.txt --dc_count=8 --dc_nnodes=16\n"
+             "  --load=0.3 --bandwidth=100G --time=0.01 --output=traffic.txt\n"
+             "\n"
+             "With --dc_count=1 (default), --nhost hosts send to any other host\n"
+             "(traffic_gen.py). With --dc_count > 1, the hosts of a DC send to the\n"
+             "hosts of the other DCs; --src_dc and --dst_dc restrict the flows to one\n"
+             "pair of DCs (traffic_gen_only_for_interDC_specify2dc.py).\n"
+             "--output is written as given; --binary writes the binary flow file.\n"
+             "The flows only depend on --seed and --run, not on --threads.");
+  cmd.AddValue ("cdf",       "flow size CDF file",                                cdfFile);
+  cmd.AddValue ("nhost",     "number of hosts with --dc_count=1",                 nhost);
+  cmd.AddValue ("load",      "load of the host links (default 0.3)",              load);
+  cmd.AddValue ("bandwidth", "bandwidth of the host links (G/M/K, default 10G)",  bandwidth);
+  cmd.AddValue ("time",      "generated time (s, default 10)",                    time);
+  cmd.AddValue ("output",    "output file",                                       output);
+  cmd.AddValue ("dc_count",  "number of data centers",                            dcCount);
+  cmd.AddValue ("dc_nnodes", "hosts per data center",                             dcNodes);
+  cmd.AddValue ("src_dc",    "only flows from this DC (0-based)",                 srcDc);
+  cmd.AddValue ("dst_dc",    "only flows to this DC (0-based), with --src_dc",    dstDc);
+  cmd.AddValue ("threads",   "generation threads (default 1)",                    threads);
+  cmd.AddValue ("seed",      "RNG seed (default 1)",                              seed);
+  cmd.AddValue ("run",       "RNG run, i.e. substream (default 0)",               run);
+  cmd.AddValue ("binary",    "write the binary flow file",                        binary);
+  cmd.Parse (argc, argv);
+  g_me = cmd.GetName () + ": ";
+
+  FlowSizeCdf cdf;
+  if (cdfFile == "" || !cdf.Load (cdfFile))
+    {
+      ERR ("not a valid cdf: " << cdfFile);
+      return 1;
+    }
+  double bps = TranslateBandwidth (bandwidth);
+  if (bps <= 0 || load <= 0)
+    {
+      ERR ("bandwidth or load incorrect: " << bandwidth << ", " << load);
+      return 1;
+    }
+  if (dcCount > 1)
+    {
+      if (dcNodes == 0)
+        {
+          ERR ("please use --dc_nnodes to specify number of hosts per DC");
+          return 1;
+        }
+      nhost = dcCount * dcNodes;
+    }
+  if (nhost < 2)
+    {
+      ERR ("please use --nhost, or --dc_count and --dc_nnodes, for at least 2 hosts");
+      return 1;
+    }
+  if ((srcDc >= 0) != (dstDc >= 0) || (srcDc >= 0 && (dcCount <= 1 || srcDc == dstDc
+                                                      || (uint32_t)srcDc >= dcCount
+                                                      || (uint32_t)dstDc >= dcCount)))
+    {
+      ERR ("--src_dc and --dst_dc must be different DCs below --dc_count");
+      return 1;
+    }
+
+  GenConfig c;
+  c.cdf = &cdf;
+  c.interArrival = 1 / (bps * load / 8. / cdf.GetAvg ()) * 1e9;
+  c.endNs = BASE_NS + (uint64_t)(time * 1e9);
+  c.nhost = nhost;
+  c.dcCount = dcCount;
+  c.dcNodes = dcNodes;
+  c.srcDc = srcDc;
+  c.dstDc = dstDc;
+  c.seed = seed;
+  c.run = run;
+
+  uint32_t first = srcDc >= 0 ? srcDc * dcNodes : 0;
+  uint32_t last = srcDc >= 0 ? first + dcNodes : nhost;
+  threads = std::max (1u, std::min (threads, last - first));
+  LOGME ("avg flow size " << cdf.GetAvg () << " B, avg inter-arrival " << c.interArrival
+         << " ns, " << (last - first) << " sources, " << threads << " threads");
+
+  // split the sources among the threads
+  std::vector<GenThread *> gen;
+  std::vector<Ptr<SystemThread> > sys;
+  for (uint32_t i = 0; i < threads; ++i)
+    {
+      uint32_t a = first + (uint64_t)(last - first) * i / threads;
+      uint32_t b = first + (uint64_t)(last - first) * (i + 1) / threads;
+      gen.push_back (new GenThread (&c, a, b));
+      sys.push_back (Create<SystemThread> (MakeCallback (&GenThread::Run, gen.back ())));
+      sys.back ()->Start ();
+    }
+  uint64_t n = 0;
+  for (uint32_t i = 0; i < threads; ++i)
+    {
+      sys[i]->Join ();
+      n += gen[i]->m_flows.size ();
+    }
+  if (n > 0xffffffffu)
+    {
+      ERR (n << " flows, at most 2^32-1 are supported by third");
+      return 1;
+    }
+
+  FILE *f = fopen (output.c_str (), binary ? "wb" : "w");
+  if (f == NULL)
+    {
+      ERR ("can not create " << output);
+      return 1;
+    }
+  static char buf[1 << 20];
+  setvbuf (f, buf, _IOFBF, sizeof (buf));
+  if (binary)
+    {
+      FlowFileHeader h;
+      InitFlowFileHeader (h, n, nhost);
+      fwrite (&h, sizeof (h), 1, f);
+    }
+  else
+    {
+      fprintf (f, "# src dst pg dport size start_time\n%" PRIu64 "\n", n);
+    }
+
+  // merge the sorted lists of the threads
+  std::priority_queue<MergeEntry, std::vector<MergeEntry>, MergeAfter> heap;
+  std::vector<size_t> pos (threads, 0);
+  for (uint32_t i = 0; i < threads; ++i)
+    {
+      if (!gen[i]->m_flows.empty ())
+        {
+          heap.push (MergeEntry (&gen[i]->m_flows[0], i));
+        }
+    }
+  while (!heap.empty ())
+    {
+      MergeEntry e = heap.top ();
+      heap.pop ();
+      const GenFlow &g = *e.first;
+      if (binary)
+        {
+          FlowFormat r;
+          memset (&r, 0, sizeof (r));
+          r.startTime = g.t * 1e-9;
+          r.size = g.size;
+          r.src = g.src;
+          r.dst = g.dst;
+          r.pg = 3;
+          r.dport = 100;
+          fwrite (&r, sizeof (r), 1, f);
+        }
+      else
+        {
+          fprintf (f, "%u %u 3 100 %" PRIu64 " %.9f\n", g.src, g.dst, g.size, g.t * 1e-9);
+        }
+      std::vector<GenFlow> &v = gen[e.second]->m_flows;
+      if (++pos[e.second] < v.size ())
+        {
+          heap.push (MergeEntry (&v[pos[e.second]], e.second));
+        }
+    }
+  bool ok = !ferror (f);
+  ok = fclose (f) == 0 && ok;
+  for (uint32_t i = 0; i < threads; ++i)
+    {
+      delete gen[i];
+    }
+  if (!ok)
+    {
+      ERR ("can not write " << output);
+      return 1;
+    }
+  LOGME (output << ": " << n << " flows");
+  return 0;
+}